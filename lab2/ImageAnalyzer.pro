@@ -7,14 +7,22 @@ TEMPLATE = app
 
 DEFINES += QT_DEPRECATED_WARNINGS
 
+include(analyzer.pri)
+
 SOURCES += \
     main.cpp \
     mainwindow.cpp \
-    imageanalyzer.cpp
+    imageresultmodel.cpp \
+    searchindex.cpp \
+    filterquery.cpp \
+    thumbnailcache.cpp
 
 HEADERS += \
     mainwindow.h \
-    imageanalyzer.h
+    imageresultmodel.h \
+    searchindex.h \
+    filterquery.h \
+    thumbnailcache.h
 
 FORMS += \
     mainwindow.ui
@@ -0,0 +1,49 @@
+# Ядро анализа без графического интерфейса: общее для приложения и консольной версии
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/imageanalyzer.cpp \
+    $$PWD/imageprobe.cpp \
+    $$PWD/imagemetadata.cpp \
+    $$PWD/pathpool.cpp \
+    $$PWD/scanstatistics.cpp \
+    $$PWD/metadatacache.cpp \
+    $$PWD/imagefilereader.cpp \
+    $$PWD/resultwriter.cpp \
+    $$PWD/resultstore.cpp \
+    $$PWD/latencyhistogram.cpp \
+    $$PWD/scanprofiler.cpp \
+    $$PWD/scancontroller.cpp \
+    $$PWD/ioscheduler.cpp \
+    $$PWD/scancheckpoint.cpp \
+    $$PWD/metadatarecord.cpp \
+    $$PWD/folderwatcher.cpp \
+    $$PWD/pixelanalyzer.cpp \
+    $$PWD/perceptualhash.cpp \
+    $$PWD/duplicatefinder.cpp \
+    $$PWD/shardcoordinator.cpp
+
+HEADERS += \
+    $$PWD/imageanalyzer.h \
+    $$PWD/imageprobe.h \
+    $$PWD/imagemetadata.h \
+    $$PWD/pathpool.h \
+    $$PWD/scanstatistics.h \
+    $$PWD/metadatacache.h \
+    $$PWD/imagefilereader.h \
+    $$PWD/resultwriter.h \
+    $$PWD/resultstore.h \
+    $$PWD/latencyhistogram.h \
+    $$PWD/scanprofiler.h \
+    $$PWD/scancontroller.h \
+    $$PWD/ioscheduler.h \
+    $$PWD/scancheckpoint.h \
+    $$PWD/metadatarecord.h \
+    $$PWD/folderwatcher.h \
+    $$PWD/pixelanalyzer.h \
+    $$PWD/perceptualhash.h \
+    $$PWD/duplicatefinder.h \
+    $$PWD/shardcoordinator.h \
+    $$PWD/boundedqueue.h \
+    $$PWD/spscring.h
@@ -0,0 +1,528 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QImageWriter>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QSize>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QtEndian>
+#include <QtConcurrent>
+#include "imageanalyzer.h"
+#include "boundedqueue.h"
+#include "latencyhistogram.h"
+#include "metadatacache.h"
+#include "pathpool.h"
+#include "pixelanalyzer.h"
+#include "scancontroller.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+// Нагрузочный тест: imageanalyzer-bench --count 50 --sizes 640x480,1920x1080 --threads 1,4,0
+// Генерирует воспроизводимый набор изображений во временной папке и
+// прогоняет analyzeFolder во всех режимах. Одна строка JSON на прогон в stdout.
+// Режим deep сначала сверяет векторные ядры анализа пикселей со скалярным.
+
+namespace {
+
+struct CorpusFile {
+    QString name;
+    QString suffix;
+    QByteArray writerFormat; // пусто - пишем сами (PCX, многостраничный TIFF)
+};
+
+const CorpusFile kCorpusFormats[] = {
+    {"jpg", "jpg", "jpeg"},
+    {"png", "png", "png"},
+    {"gif", "gif", "gif"},
+    {"bmp", "bmp", "bmp"},
+    {"tif", "tif", "tiff"},
+    {"pcx", "pcx", QByteArray()},
+    {"pages", "tif", QByteArray()}
+};
+
+// Страниц в многостраничном TIFF набора
+const int kTiffPages = 4;
+
+// Градиент с шумом: детерминирован при одинаковом seed и
+// не сжимается до пары байт, как однотонная заливка
+QImage makeImage(const QSize &size, QRandomGenerator &random)
+{
+    QImage image(size, QImage::Format_RGB32);
+    const int phase = int(random.bounded(256));
+    for (int y = 0; y < size.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            int noise = int(random.bounded(32));
+            int r = (x * 255 / qMax(1, size.width() - 1) + noise) & 0xFF;
+            int g = (y * 255 / qMax(1, size.height() - 1) + noise) & 0xFF;
+            int b = (phase + (x ^ y)) & 0xFF;
+            line[x] = qRgb(r, g, b);
+        }
+    }
+    return image;
+}
+
+void appendPcxRun(QByteArray &out, uchar value, int count)
+{
+    while (count > 0) {
+        int run = qMin(count, 63);
+        if (run > 1 || (value & 0xC0) == 0xC0) {
+            out.append(char(0xC0 | run));
+        }
+        out.append(char(value));
+        count -= run;
+    }
+}
+
+// QImageWriter не умеет PCX, поэтому 24-битный PCX (3 плоскости, RLE) пишем вручную
+bool writePcx(const QString &path, const QImage &image)
+{
+    const int width = image.width();
+    const int height = image.height();
+    const int bytesPerLine = (width + 1) & ~1;
+
+    QByteArray data(128, '\0');
+    uchar *header = reinterpret_cast<uchar *>(data.data());
+    header[0] = 0x0A;  // производитель
+    header[1] = 5;     // версия 3.0
+    header[2] = 1;     // RLE
+    header[3] = 8;     // бит на плоскость
+    qToLittleEndian<quint16>(0, header + 4);
+    qToLittleEndian<quint16>(0, header + 6);
+    qToLittleEndian<quint16>(quint16(width - 1), header + 8);
+    qToLittleEndian<quint16>(quint16(height - 1), header + 10);
+    qToLittleEndian<quint16>(72, header + 12);
+    qToLittleEndian<quint16>(72, header + 14);
+    header[65] = 3;    // плоскостей
+    qToLittleEndian<quint16>(quint16(bytesPerLine), header + 66);
+    qToLittleEndian<quint16>(1, header + 68);
+
+    QByteArray plane(bytesPerLine, '\0');
+    for (int y = 0; y < height; ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int channel = 0; channel < 3; ++channel) {
+            for (int x = 0; x < width; ++x) {
+                QRgb pixel = line[x];
+                plane[x] = char(channel == 0 ? qRed(pixel) : channel == 1 ? qGreen(pixel) : qBlue(pixel));
+            }
+
+            int x = 0;
+            while (x < bytesPerLine) {
+                uchar value = uchar(plane[x]);
+                int run = 1;
+                while (x + run < bytesPerLine && uchar(plane[x + run]) == value) run++;
+                appendPcxRun(data, value, run);
+                x += run;
+            }
+        }
+    }
+
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+void appendTiffEntry(QByteArray &out, quint16 tag, quint16 type, quint32 count, quint32 value)
+{
+    uchar entry[12];
+    qToLittleEndian<quint16>(tag, entry);
+    qToLittleEndian<quint16>(type, entry + 2);
+    qToLittleEndian<quint32>(count, entry + 4);
+    if (type == 3 && count == 1) {
+        qToLittleEndian<quint16>(quint16(value), entry + 8);
+        qToLittleEndian<quint16>(0, entry + 10);
+    } else {
+        qToLittleEndian<quint32>(value, entry + 8);
+    }
+    out.append(reinterpret_cast<const char *>(entry), sizeof(entry));
+}
+
+// QImageWriter пишет только одну страницу TIFF, поэтому многостраничный
+// (несжатый RGB, по полосе на страницу) пишем вручную: данные страницы, затем ее IFD
+bool writeMultiPageTiff(const QString &path, const QList<QImage> &pages)
+{
+    QByteArray data("II*\0\0\0\0\0", 8);
+    int previousNext = 4;   // где записать смещение следующего IFD
+
+    for (const QImage &page : pages) {
+        const int width = page.width();
+        const int height = page.height();
+
+        const quint32 stripOffset = quint32(data.size());
+        for (int y = 0; y < height; ++y) {
+            const QRgb *line = reinterpret_cast<const QRgb *>(page.constScanLine(y));
+            for (int x = 0; x < width; ++x) {
+                data.append(char(qRed(line[x])));
+                data.append(char(qGreen(line[x])));
+                data.append(char(qBlue(line[x])));
+            }
+        }
+        const quint32 stripBytes = quint32(data.size()) - stripOffset;
+
+        if (data.size() & 1) data.append('\0');   // IFD и значения - по четным смещениям
+        const quint32 bitsOffset = quint32(data.size());
+        for (int c = 0; c < 3; ++c) {
+            data.append(char(8));
+            data.append('\0');
+        }
+
+        const quint32 ifdOffset = quint32(data.size());
+        qToLittleEndian<quint32>(ifdOffset, reinterpret_cast<uchar *>(data.data()) + previousNext);
+
+        const quint16 entryCount = 10;
+        uchar count[2];
+        qToLittleEndian<quint16>(entryCount, count);
+        data.append(reinterpret_cast<const char *>(count), 2);
+        appendTiffEntry(data, 256, 4, 1, quint32(width));
+        appendTiffEntry(data, 257, 4, 1, quint32(height));
+        appendTiffEntry(data, 258, 3, 3, bitsOffset);
+        appendTiffEntry(data, 259, 3, 1, 1);        // без сжатия
+        appendTiffEntry(data, 262, 3, 1, 2);        // RGB
+        appendTiffEntry(data, 273, 4, 1, stripOffset);
+        appendTiffEntry(data, 277, 3, 1, 3);
+        appendTiffEntry(data, 278, 4, 1, quint32(height));
+        appendTiffEntry(data, 279, 4, 1, stripBytes);
+        appendTiffEntry(data, 284, 3, 1, 1);        // каналы вперемешку
+        previousNext = data.size();
+        data.append(QByteArray(4, '\0'));
+    }
+
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+QList<QSize> parseSizes(const QString &text)
+{
+    QList<QSize> sizes;
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts)) {
+        const QStringList parts = item.split('x');
+        if (parts.size() != 2) continue;
+        QSize size(parts[0].toInt(), parts[1].toInt());
+        if (size.width() > 0 && size.height() > 0) sizes.append(size);
+    }
+    return sizes;
+}
+
+QList<int> parseThreads(const QString &text)
+{
+    QList<int> threads;
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        int value = item.toInt(&ok);
+        if (ok && value >= 0) threads.append(value);
+    }
+    return threads;
+}
+
+// Каждое доступное ядро (и с делением на полосы, и без) должно давать
+// ту же статистику, что скалярное. Кроме набора - изображения с
+// шириной не кратной вектору, оттенки серого и прозрачность.
+int verifyPixelKernels(const QString &folder, QRandomGenerator &random, QTextStream &out, QTextStream &err)
+{
+    QList<QImage> images;
+    QImage noisy(1001, 37, QImage::Format_ARGB32);
+    for (int y = 0; y < noisy.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(noisy.scanLine(y));
+        for (int x = 0; x < noisy.width(); ++x) {
+            line[x] = random.generate();
+        }
+    }
+    images.append(noisy);
+
+    QImage gray(517, 63, QImage::Format_RGB32);
+    for (int y = 0; y < gray.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(gray.scanLine(y));
+        for (int x = 0; x < gray.width(); ++x) {
+            int level = int(random.bounded(256));
+            line[x] = qRgb(level, level, level);
+        }
+    }
+    images.append(gray);
+    images.append(makeImage(QSize(2051, 1031), random));
+
+    QDirIterator it(folder, ImageAnalyzer::nameFilters(), QDir::Files);
+    while (it.hasNext()) {
+        QImage image(it.next());
+        if (!image.isNull()) images.append(image);
+    }
+
+    QStringList kernels;
+    const PixelAnalyzer::Kernel candidates[] = {PixelAnalyzer::Scalar, PixelAnalyzer::Sse2, PixelAnalyzer::Avx2};
+    for (PixelAnalyzer::Kernel kernel : candidates) {
+        if (PixelAnalyzer::isSupported(kernel)) kernels << PixelAnalyzer::kernelName(kernel);
+    }
+
+    int mismatches = 0;
+    for (const QImage &image : images) {
+        const PixelStatistics reference = PixelAnalyzer::analyze(image, PixelAnalyzer::Scalar, 1);
+
+        // Сумма по страницам из одной страницы - то же, что анализ изображения
+        PixelAccumulator accumulator;
+        accumulator.add(image);
+        if (accumulator.statistics() != reference) {
+            err << QString("Сумма по страницам расходится с анализом изображения %1x%2\n")
+                       .arg(image.width())
+                       .arg(image.height());
+            mismatches++;
+        }
+
+        for (PixelAnalyzer::Kernel kernel : candidates) {
+            if (!PixelAnalyzer::isSupported(kernel)) continue;
+            for (int threadCount : {1, 0}) {
+                if (PixelAnalyzer::analyze(image, kernel, threadCount) != reference) {
+                    err << QString("Ядро %1 (потоков: %2) расходится со скалярным на изображении %3x%4\n")
+                               .arg(PixelAnalyzer::kernelName(kernel))
+                               .arg(threadCount)
+                               .arg(image.width())
+                               .arg(image.height());
+                    mismatches++;
+                }
+            }
+        }
+    }
+
+    QJsonObject record;
+    record["mode"] = "verify_pixels";
+    record["kernels"] = kernels.join(',');
+    record["images"] = images.size();
+    record["mismatches"] = mismatches;
+    out << QJsonDocument(record).toJson(QJsonDocument::Compact) << "\n";
+    out.flush();
+    return mismatches;
+}
+
+// Сбрасывает пик памяти до текущего объема (Linux), чтобы пик относился
+// к одному прогону; false - пик считается с начала процесса
+bool resetPeakRss()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/clear_refs");
+    return file.open(QIODevice::WriteOnly | QIODevice::Unbuffered) && file.write("5", 1) == 1;
+#else
+    return false;
+#endif
+}
+
+// Пиковое потребление памяти с последнего resetPeakRss или с начала процесса, КБ
+qint64 peakRssKb()
+{
+#ifdef Q_OS_LINUX
+    // VmHWM сбрасывается через clear_refs, ru_maxrss - нет
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly)) {
+        for (const QByteArray &line : status.readAll().split('\n')) {
+            if (line.startsWith("VmHWM:")) return line.mid(6).trimmed().split(' ').first().toLongLong();
+        }
+    }
+#endif
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return qint64(counters.PeakWorkingSetSize / 1024);
+    }
+    return 0;
+#elif defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef Q_OS_DARWIN
+    return qint64(usage.ru_maxrss / 1024); // macOS отдает байты
+#else
+    return qint64(usage.ru_maxrss);
+#endif
+#else
+    return 0;
+#endif
+}
+
+struct RunResult {
+    int files = 0;
+    qint64 bytes = 0;
+    qint64 elapsedNs = 0;
+};
+
+RunResult runScan(const QString &folder, const ScanOptions &options,
+                  MetadataCache *cache, LatencyHistogram *latency)
+{
+    ScanController controller;
+    RunResult result;
+
+    PathPool::instance().clear();
+
+    ResultRing results(8192);
+    ImageAnalyzer analyzer;
+    analyzer.setCache(cache);
+    analyzer.setLatencyHistogram(latency);
+    analyzer.setResultRing(&results);
+
+    QElapsedTimer timer;
+    timer.start();
+    QFuture<void> scan = QtConcurrent::run([&]() {
+        analyzer.analyzeFolder(folder, &controller, options);
+    });
+
+    ImageMetadata metadata;
+    Backoff backoff;
+    while (!results.isFinished()) {
+        if (!results.tryPop(metadata)) {
+            backoff.wait();
+            continue;
+        }
+        backoff.reset();
+        result.files++;
+        result.bytes += metadata.bytes;
+    }
+    scan.waitForFinished();
+    result.elapsedNs = timer.nsecsElapsed();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("imageanalyzer-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Нагрузочный тест анализатора на синтетическом наборе изображений");
+    parser.addHelpOption();
+
+    QCommandLineOption countOption(QStringList{"n", "count"}, "Файлов каждого формата", "N", "20");
+    QCommandLineOption sizesOption("sizes", "Разрешения через запятую", "WxH,...", "640x480,1920x1080");
+    QCommandLineOption threadsOption(QStringList{"j", "threads"}, "Числа потоков через запятую (0 - по числу ядер)", "N,...", "1,2,4,0");
+    QCommandLineOption modesOption("modes", "Режимы: ordered, unordered, cached, deep", "list", "ordered,unordered,cached");
+    QCommandLineOption seedOption("seed", "Начальное значение генератора", "N", "1");
+    QCommandLineOption corpusOption("corpus", "Использовать готовую папку вместо генерации", "folder");
+    parser.addOptions({countOption, sizesOption, threadsOption, modesOption, seedOption, corpusOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    const QList<QSize> sizes = parseSizes(parser.value(sizesOption));
+    const QList<int> threads = parseThreads(parser.value(threadsOption));
+    const QStringList modes = parser.value(modesOption).split(',', Qt::SkipEmptyParts);
+    const int count = parser.value(countOption).toInt();
+    if (sizes.isEmpty() || threads.isEmpty() || modes.isEmpty() || count <= 0) {
+        parser.showHelp(1);
+    }
+    for (const QString &mode : modes) {
+        if (mode != "ordered" && mode != "unordered" && mode != "cached" && mode != "deep") {
+            err << "Неизвестный режим: " << mode << "\n";
+            return 1;
+        }
+    }
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        err << "Не удалось создать временную папку\n";
+        return 1;
+    }
+
+    QString folder = parser.value(corpusOption);
+    if (folder.isEmpty()) {
+        folder = tempDir.filePath("corpus");
+        QDir().mkpath(folder);
+
+        const QList<QByteArray> writable = QImageWriter::supportedImageFormats();
+        QRandomGenerator random(parser.value(seedOption).toUInt());
+        int written = 0;
+
+        for (const CorpusFile &corpusFile : kCorpusFormats) {
+            if (!corpusFile.writerFormat.isEmpty() && !writable.contains(corpusFile.writerFormat)) {
+                err << "Формат " << corpusFile.suffix << " не поддерживается QImageWriter, пропущен\n";
+                continue;
+            }
+
+            for (int i = 0; i < count; ++i) {
+                const QSize size = sizes[i % sizes.size()];
+                const QImage image = makeImage(size, random);
+                const QString path = QString("%1/%2_%3.%4")
+                                         .arg(folder, corpusFile.name)
+                                         .arg(i, 5, 10, QChar('0'))
+                                         .arg(corpusFile.suffix);
+
+                bool ok;
+                if (corpusFile.name == "pages") {
+                    QList<QImage> pages{image};
+                    while (pages.size() < kTiffPages) pages.append(makeImage(size, random));
+                    ok = writeMultiPageTiff(path, pages);
+                } else if (corpusFile.writerFormat.isEmpty()) {
+                    ok = writePcx(path, image);
+                } else {
+                    QImageWriter writer(path, corpusFile.writerFormat);
+                    ok = writer.write(corpusFile.writerFormat == "gif"
+                                          ? image.convertToFormat(QImage::Format_Indexed8)
+                                          : image);
+                }
+                if (!ok) {
+                    err << "Не удалось записать " << path << "\n";
+                    return 1;
+                }
+                written++;
+            }
+        }
+        err << QString("Сгенерировано файлов: %1 в %2\n").arg(written).arg(folder);
+    }
+
+    // Прогрев: файлы попадают в страничный кэш ОС, первый прогон не искажает замеры
+    runScan(folder, ScanOptions(), nullptr, nullptr);
+
+    // Расхождение ядер - ошибка: замеры неверного результата бессмысленны
+    if (modes.contains("deep")) {
+        QRandomGenerator random(parser.value(seedOption).toUInt());
+        if (verifyPixelKernels(folder, random, out, err) > 0) return 1;
+    }
+
+    for (const QString &mode : modes) {
+        MetadataCache cache(tempDir.filePath("metadata.cache"));
+        MetadataCache *activeCache = nullptr;
+        if (mode == "cached") {
+            activeCache = &cache;
+            runScan(folder, ScanOptions(), activeCache, nullptr);
+        }
+
+        for (int threadCount : threads) {
+            ScanOptions options;
+            options.threadCount = threadCount;
+            options.orderedResults = mode != "unordered";
+            options.deepAnalysis = mode == "deep";
+
+            LatencyHistogram latency;
+            const bool peakPerRun = resetPeakRss();
+            RunResult result = runScan(folder, options, activeCache, &latency);
+
+            double seconds = qMax<qint64>(result.elapsedNs, 1) / 1e9;
+            QJsonObject record;
+            record["mode"] = mode;
+            record["threads"] = threadCount;
+            record["files"] = result.files;
+            record["bytes"] = result.bytes;
+            record["seconds"] = seconds;
+            record["files_per_s"] = result.files / seconds;
+            record["mb_per_s"] = result.bytes / (1024.0 * 1024.0) / seconds;
+            record["p50_us"] = latency.percentile(50) / 1000.0;
+            record["p99_us"] = latency.percentile(99) / 1000.0;
+            record["max_us"] = latency.max() / 1000.0;
+            record["peak_rss_kb"] = peakRssKb();
+            // run - пик этого прогона, process - с начала процесса (включая генерацию и прогрев)
+            record["peak_rss_scope"] = peakPerRun ? "run" : "process";
+
+            out << QJsonDocument(record).toJson(QJsonDocument::Compact) << "\n";
+            out.flush();
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QThread>
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+
+// Ограниченная очередь без блокировок для нескольких производителей и
+// потребителей (кольцо с номерами поколений в ячейках, схема Вьюкова).
+// Емкость округляется вверх до степени двойки.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity)
+    {
+        size_t size = 2;
+        while (size < size_t(qMax(capacity, 2))) size <<= 1;
+
+        m_mask = size - 1;
+        m_cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    bool tryPush(T &&value)
+    {
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            qptrdiff diff = qptrdiff(sequence) - qptrdiff(pos);
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;   // очередь заполнена
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &value)
+    {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            qptrdiff diff = qptrdiff(sequence) - qptrdiff(pos + 1);
+            if (diff == 0) {
+                if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;   // очередь пуста
+            } else {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->data);
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Приблизительное число элементов (для метрик)
+    int size() const
+    {
+        size_t enqueued = m_enqueuePos.load(std::memory_order_relaxed);
+        size_t dequeued = m_dequeuePos.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? int(enqueued - dequeued) : 0;
+    }
+
+    int capacity() const { return int(m_mask + 1); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_enqueuePos{0};
+    alignas(64) std::atomic<size_t> m_dequeuePos{0};
+};
+
+// Ожидание при пустой или полной очереди: сначала уступаем процессор,
+// потом засыпаем ненадолго, чтобы не жечь ядро
+class Backoff
+{
+public:
+    void wait()
+    {
+        if (m_spins < 16) {
+            m_spins++;
+            QThread::yieldCurrentThread();
+        } else {
+            QThread::usleep(200);
+        }
+    }
+
+    void reset() { m_spins = 0; }
+
+private:
+    int m_spins = 0;
+};
+
+#endif // BOUNDEDQUEUE_H
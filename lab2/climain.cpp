@@ -0,0 +1,275 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QtConcurrent>
+#include <csignal>
+#include "imageanalyzer.h"
+#include "metadatacache.h"
+#include "pathpool.h"
+#include "resultwriter.h"
+#include "resultstore.h"
+#include "scanprofiler.h"
+#include "boundedqueue.h"
+#include "scancontroller.h"
+#include "scancheckpoint.h"
+#include "shardcoordinator.h"
+
+// Консольная версия: imageanalyzer-cli <папка> --jobs N --format jsonl|csv
+// Записи выводятся в stdout по мере готовности, итог - в stderr.
+// imageanalyzer-cli --export <файл> --format csv выгружает сохраненные результаты.
+// С --shards N файлы разбирают N процессов этой же программы (скрытый режим --worker).
+
+namespace {
+
+ScanController controller;
+
+void handleSignal(int)
+{
+    controller.cancel();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // Общее имя с графической версией, чтобы кэш метаданных был один
+    QCoreApplication::setApplicationName("ImageAnalyzer");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Анализ метаданных изображений без графического интерфейса");
+    parser.addHelpOption();
+    parser.addPositionalArgument("folder", "Папка с изображениями (не нужна с --export)");
+
+    QCommandLineOption jobsOption(QStringList{"j", "jobs"}, "Число потоков (0 - подбирается по задержке диска)", "N", "0");
+    QCommandLineOption formatOption(QStringList{"f", "format"}, "Формат вывода: jsonl или csv", "format", "jsonl");
+    QCommandLineOption recursiveOption(QStringList{"r", "recursive"}, "Обходить вложенные папки");
+    QCommandLineOption unorderedOption("unordered", "Выводить записи по мере готовности, без сохранения порядка");
+    QCommandLineOption noCacheOption("no-cache", "Не использовать кэш метаданных");
+    QCommandLineOption traceOption("trace", "Сохранить журнал этапов в формате Chrome Trace", "file");
+    QCommandLineOption queueOption("queue-capacity", "Емкость очереди найденных путей", "N", "4096");
+    QCommandLineOption bufferOption("result-capacity", "Емкость буфера готовых результатов", "N", "8192");
+    QCommandLineOption deepOption("deep", "Статистика пикселей: число цветов, каналы, гистограмма яркости (декодирует каждый файл)");
+    QCommandLineOption phashOption("phash", "Перцептивный хэш для поиска похожих изображений (поле phash)");
+    QCommandLineOption resumeOption("resume", "Продолжить прерванный анализ папки, не читая обработанные файлы заново");
+    QCommandLineOption saveResultsOption("save-results", "Сохранить результаты в файл по столбцам (для --export и графической версии)", "file");
+    QCommandLineOption ioOrderOption("io-order", "Порядок чтения файлов: listing, inode или physical (FIEMAP)", "order", "inode");
+    QCommandLineOption prefetchOption("prefetch", "Подкачивать файлы на N вперед (posix_fadvise), 0 - не подкачивать", "N", "32");
+    QCommandLineOption shardsOption("shards", "Разбирать файлы в N процессах: падение декодера не прерывает анализ", "N", "1");
+    QCommandLineOption workerOption("worker", "Процесс анализа для --shards: задания из stdin, записи в stdout");
+    workerOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    QCommandLineOption exportOption("export", "Выгрузить сохраненные результаты в stdout в формате --format и выйти", "file");
+    parser.addOptions({jobsOption, formatOption, recursiveOption, unorderedOption, noCacheOption, traceOption,
+                       queueOption, bufferOption, deepOption, phashOption, resumeOption, saveResultsOption, exportOption,
+                       ioOrderOption, prefetchOption, shardsOption, workerOption});
+    parser.process(app);
+
+    QTextStream err(stderr);
+
+    ResultWriter::Format format;
+    if (!ResultWriter::parseFormat(parser.value(formatOption), format)) {
+        err << "Неизвестный формат вывода: " << parser.value(formatOption) << "\n";
+        return 1;
+    }
+
+    if (parser.isSet(workerOption)) {
+        ScanOptions options;
+        options.threadCount = parser.value(jobsOption).toInt();
+        options.deepAnalysis = parser.isSet(deepOption);
+        options.perceptualHash = parser.isSet(phashOption);
+        return ShardWorker::run(options, !parser.isSet(noCacheOption));
+    }
+
+    const QStringList arguments = parser.positionalArguments();
+    if (parser.isSet(exportOption)) {
+        if (!arguments.isEmpty()) parser.showHelp(1);
+
+        // Файл отображается в память и выводится строка за строкой
+        ResultStoreReader store;
+        if (!store.open(parser.value(exportOption))) {
+            err << "Не удалось открыть результаты: " << store.errorString() << "\n";
+            return 1;
+        }
+        QFile out;
+        out.open(stdout, QIODevice::WriteOnly);
+        if (!store.exportTo(&out, format)) {
+            err << "Ошибка вывода: " << out.errorString() << "\n";
+            return 1;
+        }
+        out.flush();
+        err << QString("Записей: %1\n").arg(store.rowCount());
+        return 0;
+    }
+
+    if (arguments.size() != 1) {
+        parser.showHelp(1);
+    }
+
+    QString folder = arguments.first();
+    if (!QDir(folder).exists()) {
+        err << "Папка не существует: " << folder << "\n";
+        return 1;
+    }
+
+    ScanOptions options;
+    options.threadCount = parser.value(jobsOption).toInt();
+    options.recursive = parser.isSet(recursiveOption);
+    options.orderedResults = !parser.isSet(unorderedOption);
+    options.pathQueueCapacity = qMax(2, parser.value(queueOption).toInt());
+    options.deepAnalysis = parser.isSet(deepOption);
+    options.perceptualHash = parser.isSet(phashOption);
+    options.prefetchWindow = qMax(0, parser.value(prefetchOption).toInt());
+
+    const QString ioOrder = parser.value(ioOrderOption);
+    if (ioOrder == "listing") {
+        options.ioOrder = IoOrder::Listing;
+    } else if (ioOrder == "inode") {
+        options.ioOrder = IoOrder::Inode;
+    } else if (ioOrder == "physical") {
+        options.ioOrder = IoOrder::Physical;
+    } else {
+        err << "Неизвестный порядок чтения: " << ioOrder << "\n";
+        return 1;
+    }
+
+    const int shardCount = qMax(1, parser.value(shardsOption).toInt());
+    const bool sharded = shardCount > 1;
+    if (sharded && (parser.isSet(resumeOption) || parser.isSet(traceOption))) {
+        err << "С --shards журнал продолжения и трассировка не ведутся\n";
+        err.flush();
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    QFile out;
+    out.open(stdout, QIODevice::WriteOnly);
+    ResultWriter writer(&out, format);
+    writer.writeHeader();
+
+    MetadataCache cache;
+    ScanProfiler profiler;
+    ResultRing results(qMax(2, parser.value(bufferOption).toInt()));
+    // Результаты не хранятся: путь нужен только до записи в вывод
+    PathPool::instance().setStreaming(true);
+    ImageAnalyzer analyzer;
+    analyzer.setResultRing(&results);
+    if (parser.isSet(traceOption)) analyzer.setProfiler(&profiler);
+    // Процессы анализа читают кэш сами и не дополняют его
+    const bool useCache = !parser.isSet(noCacheOption) && !sharded;
+    if (useCache) {
+        cache.load();
+        analyzer.setCache(&cache);
+    }
+
+    ShardCoordinator shards;
+    shards.setWorkerProgram(QCoreApplication::applicationFilePath());
+    shards.setResultRing(&results);
+
+    // Журнал пишется всегда: прерванный по Ctrl+C анализ можно продолжить с --resume
+    ScanCheckpoint checkpoint(folder, options.recursive);
+    bool resume = parser.isSet(resumeOption) && !sharded;
+    if (resume) {
+        int restored = checkpoint.load();
+        err << QString("Из журнала прерванного анализа: %1 файлов\n").arg(restored);
+        err.flush();
+    }
+    // Записи процессов приходят без общего порядка: журнал ведется только без --shards
+    if (!sharded) {
+        if (checkpoint.begin(resume)) {
+            analyzer.setCheckpoint(&checkpoint);
+        } else {
+            err << "Не удалось создать журнал анализа, продолжение будет недоступно\n";
+        }
+    }
+
+    // Результаты дописываются блоками по мере анализа
+    ResultStoreWriter store;
+    if (parser.isSet(saveResultsOption) && !store.open(parser.value(saveResultsOption))) {
+        err << "Не удалось создать файл результатов: " << store.errorString() << "\n";
+        return 1;
+    }
+
+    int fileCount = 0;
+    int errorCount = 0;
+    qint64 totalBytes = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    bool shardsStarted = true;
+    QFuture<void> scan = QtConcurrent::run([&]() {
+        if (sharded) {
+            shardsStarted = shards.analyzeFolder(folder, &controller, options, shardCount);
+        } else {
+            analyzer.analyzeFolder(folder, &controller, options);
+        }
+    });
+
+    // Записи забираются из буфера и пишутся в stdout; если вывод медленный,
+    // буфер заполняется и анализ ждет, а не копит результаты в памяти
+    QVector<ImageMetadata> batch;
+    Backoff backoff;
+    while (!results.isFinished()) {
+        batch.clear();
+        if (results.popBatch(batch, 4096) == 0) {
+            backoff.wait();
+            continue;
+        }
+        backoff.reset();
+
+        for (const ImageMetadata &metadata : batch) {
+            writer.write(metadata);
+            fileCount++;
+            totalBytes += metadata.bytes;
+            if (metadata.hasError()) errorCount++;
+        }
+        if (store.isOpen() && !store.append(batch)) {
+            err << "Ошибка записи результатов: " << store.errorString() << "\n";
+            err.flush();
+        }
+        for (const ImageMetadata &metadata : batch) {
+            PathPool::instance().release(metadata.pathId);
+        }
+        writer.flush();
+        out.flush();
+    }
+    scan.waitForFinished();
+    qint64 elapsed = timer.elapsed();
+
+    writer.flush();
+    out.flush();
+    if (useCache) cache.save();
+    if (store.isOpen() && !store.finish()) {
+        err << "Не удалось сохранить результаты: " << parser.value(saveResultsOption) << "\n";
+    }
+    if (parser.isSet(traceOption) && !profiler.writeChromeTrace(parser.value(traceOption))) {
+        err << "Не удалось сохранить трассировку: " << parser.value(traceOption) << "\n";
+    }
+
+    double seconds = qMax<qint64>(elapsed, 1) / 1000.0;
+    err << QString("Файлов: %1 (ошибок: %2), объем: %3\n")
+               .arg(fileCount)
+               .arg(errorCount)
+               .arg(ImageMetadata::formatFileSize(totalBytes));
+    err << QString("Время: %1 сек., скорость: %2 файлов/сек., %3 МБ/сек.\n")
+               .arg(seconds, 0, 'f', 2)
+               .arg(fileCount / seconds, 0, 'f', 1)
+               .arg(totalBytes / (1024.0 * 1024.0) / seconds, 0, 'f', 1);
+    if (sharded) {
+        err << QString("Процессов: %1, перезапусков: %2, файлов со сбоем: %3\n")
+                   .arg(shardCount)
+                   .arg(shards.restarts())
+                   .arg(shards.crashedFiles());
+        if (!shards.errorString().isEmpty()) err << shards.errorString() << "\n";
+    } else if (controller.isCancelled()) {
+        err << "Анализ прерван, продолжить можно с --resume\n";
+    }
+
+    if (controller.isCancelled()) return 130;
+    // Процессы не запустились или файлы остались неразобранными: результат неполон
+    if (sharded && (!shardsStarted || !shards.errorString().isEmpty())) return 1;
+    return 0;
+}
@@ -0,0 +1,312 @@
+#include "duplicatefinder.h"
+#include "perceptualhash.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace {
+
+// Многоиндексный поиск: 64 бита хэша делятся на maxDistance + 1 блоков.
+// У двух хэшей на расстоянии не больше maxDistance хотя бы один блок
+// совпадает полностью, поэтому сравнивать нужно только хэши с общим
+// значением какого-нибудь блока. Для каждого блока хэши сортируются по
+// его значению, и полностью сравниваются пары внутри одинаковых серий.
+struct HashBlock {
+    int shift = 0;
+    int bits = 0;
+    QVector<QPair<int, int>> edges; // найденные пары близких хэшей
+};
+
+// Узел графа близких хэшей: файлы с одним хэшем и номера соседних узлов
+struct HashNode {
+    QVector<const ImageMetadata *> files;
+    QVector<int> neighbours;
+};
+
+QVector<HashBlock> hashBlocks(int maxDistance)
+{
+    QVector<HashBlock> blocks;
+    if (maxDistance <= 0) return blocks;
+
+    const int blockCount = qMin(maxDistance + 1, 64);
+    int shift = 0;
+    for (int i = 0; i < blockCount; ++i) {
+        HashBlock block;
+        block.shift = shift;
+        block.bits = 64 / blockCount + (i < 64 % blockCount ? 1 : 0);
+        shift += block.bits;
+        blocks.append(block);
+    }
+    return blocks;
+}
+
+// Нулевой хэш дают пустые и однотонные изображения (нет перепадов яркости):
+// по нему разные картинки неотличимы, и в поиск такие файлы не входят
+bool isIndexed(const ImageMetadata &metadata)
+{
+    return !metadata.hasError() && metadata.hasPerceptualHash() && metadata.perceptualHash != 0;
+}
+
+quint64 blockMask(int bits)
+{
+    return bits >= 64 ? ~quint64(0) : (quint64(1) << bits) - 1;
+}
+
+void findPairs(const QVector<quint64> &hashes, int maxDistance, HashBlock &block)
+{
+    const quint64 mask = blockMask(block.bits);
+    QVector<QPair<quint64, int>> keys(hashes.size());
+    for (int i = 0; i < hashes.size(); ++i) {
+        keys[i] = qMakePair((hashes[i] >> block.shift) & mask, i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    for (int begin = 0; begin < keys.size();) {
+        int end = begin + 1;
+        while (end < keys.size() && keys[end].first == keys[begin].first) end++;
+
+        for (int a = begin; a < end; ++a) {
+            const quint64 hash = hashes[keys[a].second];
+            for (int b = a + 1; b < end; ++b) {
+                if (PerceptualHash::distance(hash, hashes[keys[b].second]) <= maxDistance) {
+                    block.edges.append(qMakePair(keys[a].second, keys[b].second));
+                }
+            }
+        }
+        begin = end;
+    }
+}
+
+// Порядок выбора оставляемого файла: наибольшее разрешение, затем размер
+bool preferredFile(const ImageMetadata *first, const ImageMetadata *second)
+{
+    if (first->pixels() != second->pixels()) return first->pixels() > second->pixels();
+    if (first->bytes != second->bytes) return first->bytes > second->bytes;
+    return first->pathId < second->pathId;
+}
+
+// Группы строятся вокруг оставляемого файла: лучший еще не взятый файл
+// забирает свой хэш и соседние. В группу попадают только файлы не дальше
+// maxDistance от оставляемого; цепочка A~B~C не сводит A и C вместе.
+// У всех файлов узла один хэш, поэтому узел всегда уходит в группу целиком.
+void groupNodes(const QVector<HashNode> &nodes, DuplicateReport &report)
+{
+    QVector<QPair<const ImageMetadata *, int>> files;
+    for (int i = 0; i < nodes.size(); ++i) {
+        for (const ImageMetadata *metadata : nodes.at(i).files) {
+            files.append(qMakePair(metadata, i));
+        }
+    }
+    std::sort(files.begin(), files.end(), [](const QPair<const ImageMetadata *, int> &a,
+                                             const QPair<const ImageMetadata *, int> &b) {
+        return preferredFile(a.first, b.first);
+    });
+
+    QVector<bool> claimed(nodes.size(), false);
+    for (const QPair<const ImageMetadata *, int> &leader : files) {
+        if (claimed[leader.second]) continue;
+
+        const HashNode &node = nodes.at(leader.second);
+        QVector<const ImageMetadata *> members = node.files;
+        claimed[leader.second] = true;
+        for (int neighbour : node.neighbours) {
+            if (claimed[neighbour]) continue;
+            claimed[neighbour] = true;
+            members += nodes.at(neighbour).files;
+        }
+        if (members.size() < 2) continue;
+
+        std::sort(members.begin(), members.end(), preferredFile);
+
+        DuplicateGroup group;
+        const quint64 keptHash = leader.first->perceptualHash;
+        for (int i = 0; i < members.size(); ++i) {
+            const ImageMetadata &metadata = *members.at(i);
+            group.files.append(metadata);
+            group.distances.append(PerceptualHash::distance(keptHash, metadata.perceptualHash));
+            if (i > 0) group.reclaimableBytes += metadata.bytes;
+        }
+
+        report.duplicateFiles += members.size() - 1;
+        report.reclaimableBytes += group.reclaimableBytes;
+        report.groups.append(group);
+    }
+
+    std::sort(report.groups.begin(), report.groups.end(), [](const DuplicateGroup &a, const DuplicateGroup &b) {
+        return a.reclaimableBytes > b.reclaimableBytes;
+    });
+}
+
+} // namespace
+
+DuplicateReport DuplicateFinder::find(const QVector<ImageMetadata> &results, int maxDistance)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    DuplicateIndex index(maxDistance);
+    index.rebuild(results);
+    DuplicateReport report = index.report();
+    report.elapsedMs = timer.elapsed();
+    return report;
+}
+
+DuplicateIndex::DuplicateIndex(int maxDistance) : m_maxDistance(maxDistance)
+{
+    for (const HashBlock &layout : hashBlocks(maxDistance)) {
+        Block block;
+        block.shift = layout.shift;
+        block.bits = layout.bits;
+        m_blocks.append(block);
+    }
+}
+
+quint64 DuplicateIndex::blockValue(const Block &block, quint64 hash) const
+{
+    return (hash >> block.shift) & blockMask(block.bits);
+}
+
+void DuplicateIndex::addHash(quint64 hash)
+{
+    // Кандидаты - хэши с тем же значением хотя бы одного блока
+    Node &node = m_nodes[hash];
+    for (Block &block : m_blocks) {
+        QVector<quint64> &bucket = block.hashes[blockValue(block, hash)];
+        for (quint64 other : bucket) {
+            if (PerceptualHash::distance(hash, other) > m_maxDistance) continue;
+            if (node.neighbours.contains(other)) continue;
+            node.neighbours.append(other);
+            m_nodes[other].neighbours.append(hash);
+        }
+        bucket.append(hash);
+    }
+}
+
+void DuplicateIndex::removeHash(quint64 hash)
+{
+    const Node node = m_nodes.take(hash);
+    for (Block &block : m_blocks) {
+        auto bucket = block.hashes.find(blockValue(block, hash));
+        if (bucket == block.hashes.end()) continue;
+        bucket->removeOne(hash);
+        if (bucket->isEmpty()) block.hashes.erase(bucket);
+    }
+    for (quint64 other : node.neighbours) {
+        auto neighbour = m_nodes.find(other);
+        if (neighbour != m_nodes.end()) neighbour->neighbours.removeOne(hash);
+    }
+}
+
+void DuplicateIndex::insert(const ImageMetadata &metadata)
+{
+    remove(metadata.pathId);
+    if (!isIndexed(metadata)) return;
+
+    const quint64 hash = metadata.perceptualHash;
+    if (!m_nodes.contains(hash)) addHash(hash);
+    m_nodes[hash].files.append(metadata);
+    m_pathHashes.insert(metadata.pathId, hash);
+}
+
+void DuplicateIndex::remove(quint32 pathId)
+{
+    auto it = m_pathHashes.find(pathId);
+    if (it == m_pathHashes.end()) return;
+
+    const quint64 hash = it.value();
+    m_pathHashes.erase(it);
+
+    Node &node = m_nodes[hash];
+    for (int i = 0; i < node.files.size(); ++i) {
+        if (node.files.at(i).pathId == pathId) {
+            node.files.remove(i);
+            break;
+        }
+    }
+    if (node.files.isEmpty()) removeHash(hash);
+}
+
+void DuplicateIndex::rebuild(const QVector<ImageMetadata> &results)
+{
+    clear();
+
+    // Файлы с одинаковым хэшем - один узел графа
+    for (const ImageMetadata &metadata : results) {
+        if (!isIndexed(metadata)) continue;
+        m_nodes[metadata.perceptualHash].files.append(metadata);
+        m_pathHashes.insert(metadata.pathId, metadata.perceptualHash);
+    }
+
+    const QVector<quint64> hashes = m_nodes.keys().toVector();
+    for (Block &block : m_blocks) {
+        for (quint64 hash : hashes) {
+            block.hashes[blockValue(block, hash)].append(hash);
+        }
+    }
+
+    // Блоки обрабатываются параллельно; пара может найтись в нескольких блоках
+    QVector<HashBlock> blocks;
+    if (hashes.size() > 1) blocks = hashBlocks(m_maxDistance);
+    const int maxDistance = m_maxDistance;
+    QtConcurrent::blockingMap(blocks, [&hashes, maxDistance](HashBlock &block) {
+        findPairs(hashes, maxDistance, block);
+    });
+    for (const HashBlock &block : blocks) {
+        for (const QPair<int, int> &edge : block.edges) {
+            m_nodes[hashes[edge.first]].neighbours.append(hashes[edge.second]);
+            m_nodes[hashes[edge.second]].neighbours.append(hashes[edge.first]);
+        }
+    }
+    if (blocks.size() > 1) {
+        for (Node &node : m_nodes) {
+            std::sort(node.neighbours.begin(), node.neighbours.end());
+            node.neighbours.erase(std::unique(node.neighbours.begin(), node.neighbours.end()),
+                                  node.neighbours.end());
+        }
+    }
+}
+
+void DuplicateIndex::clear()
+{
+    for (Block &block : m_blocks) {
+        block.hashes.clear();
+    }
+    m_nodes.clear();
+    m_pathHashes.clear();
+}
+
+DuplicateReport DuplicateIndex::report() const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    DuplicateReport report;
+    report.maxDistance = m_maxDistance;
+    report.hashedFiles = m_pathHashes.size();
+
+    // Граф уже построен: остается пронумеровать узлы и собрать группы
+    QHash<quint64, int> numbers;
+    numbers.reserve(m_nodes.size());
+    QVector<HashNode> nodes;
+    nodes.reserve(m_nodes.size());
+    for (auto it = m_nodes.constBegin(); it != m_nodes.constEnd(); ++it) {
+        numbers.insert(it.key(), nodes.size());
+        HashNode node;
+        for (const ImageMetadata &metadata : it->files) {
+            node.files.append(&metadata);
+        }
+        nodes.append(node);
+    }
+    for (auto it = m_nodes.constBegin(); it != m_nodes.constEnd(); ++it) {
+        QVector<int> &neighbours = nodes[numbers.value(it.key())].neighbours;
+        for (quint64 other : it->neighbours) {
+            neighbours.append(numbers.value(other));
+        }
+    }
+
+    groupNodes(nodes, report);
+    report.elapsedMs = timer.elapsed();
+    return report;
+}
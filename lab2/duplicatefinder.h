@@ -0,0 +1,79 @@
+#ifndef DUPLICATEFINDER_H
+#define DUPLICATEFINDER_H
+
+#include <QHash>
+#include <QVector>
+#include "imagemetadata.h"
+
+// Группа похожих изображений. Первым идет файл, который стоит оставить
+// (наибольшее разрешение, затем размер), остальные можно удалить; каждый
+// из них отличается от оставляемого не больше чем на maxDistance бит.
+struct DuplicateGroup {
+    QVector<ImageMetadata> files;
+    QVector<int> distances;         // бит отличия от первого файла
+    qint64 reclaimableBytes = 0;    // сумма размеров всех, кроме первого
+};
+
+struct DuplicateReport {
+    QVector<DuplicateGroup> groups; // по убыванию reclaimableBytes
+    int hashedFiles = 0;
+    int duplicateFiles = 0;         // файлов в группах, кроме оставляемых
+    qint64 reclaimableBytes = 0;
+    int maxDistance = 0;
+    qint64 elapsedMs = 0;
+};
+
+// Поиск похожих изображений по перцептивным хэшам. Одинаковые хэши
+// объединяются сразу, близкие по расстоянию Хэмминга ищутся по частям
+// хэша (многоиндексный поиск) вместо сравнения каждой пары файлов.
+class DuplicateFinder
+{
+public:
+    static const int kDefaultMaxDistance = 6;
+
+    // Учитываются записи с посчитанным ненулевым хэшем и без ошибок
+    static DuplicateReport find(const QVector<ImageMetadata> &results,
+                                int maxDistance = kDefaultMaxDistance);
+};
+
+// Тот же поиск, пополняемый по одному файлу: при наблюдении за папкой
+// новый хэш сравнивается только с хэшами из своих серий блоков, и
+// повторного поиска по всем записям не нужно. Не потокобезопасен.
+class DuplicateIndex
+{
+public:
+    explicit DuplicateIndex(int maxDistance = DuplicateFinder::kDefaultMaxDistance);
+
+    // Запись с тем же номером пути заменяется; запись без хэша или с
+    // ошибкой только убирает прежнюю
+    void insert(const ImageMetadata &metadata);
+    void remove(quint32 pathId);
+    // Полная перестройка по всем записям; пары ищутся параллельно по блокам
+    void rebuild(const QVector<ImageMetadata> &results);
+    void clear();
+
+    DuplicateReport report() const;
+
+private:
+    struct Node {
+        QVector<ImageMetadata> files;   // файлы с этим хэшем
+        QVector<quint64> neighbours;    // близкие хэши
+    };
+
+    struct Block {
+        int shift = 0;
+        int bits = 0;
+        QHash<quint64, QVector<quint64>> hashes;   // значение блока -> хэши
+    };
+
+    quint64 blockValue(const Block &block, quint64 hash) const;
+    void addHash(quint64 hash);
+    void removeHash(quint64 hash);
+
+    int m_maxDistance;
+    QVector<Block> m_blocks;
+    QHash<quint64, Node> m_nodes;
+    QHash<quint32, quint64> m_pathHashes;
+};
+
+#endif // DUPLICATEFINDER_H
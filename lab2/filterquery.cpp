@@ -0,0 +1,164 @@
+#include "filterquery.h"
+#include <QRegularExpression>
+
+namespace {
+
+struct FieldName {
+    const char *name;
+    FilterQuery::Field field;
+};
+
+const FieldName kFields[] = {
+    {"width", FilterQuery::Width},
+    {"height", FilterQuery::Height},
+    {"pixels", FilterQuery::Pixels},
+    {"dpi", FilterQuery::Dpi},
+    {"size", FilterQuery::FileSize},
+    {"depth", FilterQuery::Depth},
+    {"colors", FilterQuery::Colors},
+    {"pages", FilterQuery::Pages}
+};
+
+bool parseOp(const QString &text, FilterQuery::Op &op)
+{
+    if (text == "<") op = FilterQuery::Less;
+    else if (text == "<=") op = FilterQuery::LessEqual;
+    else if (text == ">") op = FilterQuery::Greater;
+    else if (text == ">=") op = FilterQuery::GreaterEqual;
+    else if (text == "=" || text == ":") op = FilterQuery::Equal;
+    else if (text == "!=") op = FilterQuery::NotEqual;
+    else return false;
+    return true;
+}
+
+// Число с необязательным множителем: 10M, 1.5k, 5MB, 300KB.
+// Для размера файла множители двоичные (1024), для остального - десятичные.
+bool parseNumber(const QString &text, FilterQuery::Field field, quint64 &value)
+{
+    static const QRegularExpression pattern("^(\\d+(?:[.,]\\d+)?)\\s*([kmgкмг]?)(?:b|б|p|px|mp)?$",
+                                            QRegularExpression::CaseInsensitiveOption);
+    QRegularExpressionMatch match = pattern.match(text);
+    if (!match.hasMatch()) return false;
+
+    QString number = match.captured(1);
+    number.replace(',', '.');
+    double result = number.toDouble();
+
+    QString unit = match.captured(2).toLower();
+    double base = field == FilterQuery::FileSize ? 1024.0 : 1000.0;
+    if (unit == "k" || unit == "к") result *= base;
+    else if (unit == "m" || unit == "м") result *= base * base;
+    else if (unit == "g" || unit == "г") result *= base * base * base;
+
+    value = quint64(result + 0.5);
+    return true;
+}
+
+// Маска форматов: по расширению (jpg, tiff) или по названию формата
+bool parseFormats(const QString &text, quint32 &mask)
+{
+    mask = 0;
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts)) {
+        ImageFormat format = ImageMetadata::formatFromSuffix(item);
+        if (format != ImageFormat::Unknown) {
+            mask |= 1u << int(format);
+            continue;
+        }
+        for (int i = 1; i < int(ImageFormat::Count); ++i) {
+            if (ImageMetadata::formatName(ImageFormat(i)).contains(item, Qt::CaseInsensitive)) {
+                mask |= 1u << i;
+            }
+        }
+    }
+    return mask != 0;
+}
+
+bool parseCompressions(const QString &text, quint32 &mask)
+{
+    mask = 0;
+    for (const QString &item : text.split(',', Qt::SkipEmptyParts)) {
+        for (int i = 1; i <= int(Compression::Other); ++i) {
+            if (ImageMetadata::compressionName(Compression(i)).contains(item, Qt::CaseInsensitive)) {
+                mask |= 1u << i;
+            }
+        }
+    }
+    return mask != 0;
+}
+
+} // namespace
+
+FilterQuery FilterQuery::parse(const QString &text, QString *error)
+{
+    static const QRegularExpression whitespace("\\s+");
+    static const QRegularExpression condition("^([a-z]+)(<=|>=|!=|<|>|=|:)(.+)$",
+                                              QRegularExpression::CaseInsensitiveOption);
+
+    FilterQuery query;
+    query.m_text = text;
+    if (error) error->clear();
+
+    auto fail = [&](const QString &message) {
+        if (error) *error = message;
+        FilterQuery invalid;
+        invalid.m_text = text;
+        invalid.m_valid = false;
+        return invalid;
+    };
+
+    for (const QString &token : text.split(whitespace, Qt::SkipEmptyParts)) {
+        QRegularExpressionMatch match = condition.match(token);
+        if (!match.hasMatch()) {
+            query.m_words.append(token.toLower());
+            continue;
+        }
+
+        const QString name = match.captured(1).toLower();
+        const QString value = match.captured(3);
+        Op op = Equal;
+        parseOp(match.captured(2), op);
+
+        if (name == "format" || name == "compression") {
+            if (op != Equal) return fail(QString("Для поля %1 допустимо только ':'").arg(name));
+
+            quint32 mask;
+            if (name == "format") {
+                if (!parseFormats(value, mask)) return fail(QString("Неизвестный формат: %1").arg(value));
+                query.m_formatMasks.append(mask);
+            } else {
+                if (!parseCompressions(value, mask)) return fail(QString("Неизвестное сжатие: %1").arg(value));
+                query.m_compressionMasks.append(mask);
+            }
+            continue;
+        }
+
+        const FieldName *field = nullptr;
+        for (const FieldName &candidate : kFields) {
+            if (name == candidate.name) field = &candidate;
+        }
+        if (!field) {
+            return fail(QString("Неизвестное поле: %1 (доступны format, compression, width, height, "
+                                "pixels, dpi, size, depth, colors, pages)").arg(name));
+        }
+
+        Condition parsed;
+        parsed.field = field->field;
+        parsed.op = op;
+        if (!parseNumber(value, parsed.field, parsed.value)) {
+            return fail(QString("Неверное число: %1").arg(value));
+        }
+        query.m_conditions.append(parsed);
+    }
+
+    return query;
+}
+
+bool FilterQuery::isEmpty() const
+{
+    return m_words.isEmpty() && isPlainText();
+}
+
+bool FilterQuery::isPlainText() const
+{
+    return m_conditions.isEmpty() && m_formatMasks.isEmpty() && m_compressionMasks.isEmpty();
+}
@@ -0,0 +1,82 @@
+#ifndef FILTERQUERY_H
+#define FILTERQUERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "imagemetadata.h"
+
+// Выражение фильтра из строки поиска, например
+//   format:tif pixels>10M dpi<150 size>5MB
+// Условия объединяются через И. Слово без поля ищется в имени файла,
+// названии формата и сжатия. Разбирается один раз, затем проверяется
+// по столбцам SearchIndex.
+class FilterQuery
+{
+public:
+    enum Field {
+        Width,
+        Height,
+        Pixels,
+        Dpi,
+        FileSize,
+        Depth,
+        Colors,
+        Pages
+    };
+
+    enum Op {
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Equal,
+        NotEqual
+    };
+
+    struct Condition {
+        Field field;
+        Op op;
+        quint64 value;
+    };
+
+    static FilterQuery parse(const QString &text, QString *error = nullptr);
+
+    static bool compare(quint64 value, Op op, quint64 operand)
+    {
+        switch (op) {
+        case Less: return value < operand;
+        case LessEqual: return value <= operand;
+        case Greater: return value > operand;
+        case GreaterEqual: return value >= operand;
+        case Equal: return value == operand;
+        case NotEqual: return value != operand;
+        }
+        return false;
+    }
+
+    QString text() const { return m_text; }
+    bool isValid() const { return m_valid; }
+    bool isEmpty() const;
+
+    // Только слова: дописанный запрос сужает результат предыдущего
+    bool isPlainText() const;
+
+    const QStringList &words() const { return m_words; }
+    const QVector<Condition> &conditions() const { return m_conditions; }
+
+    // Битовые маски допустимых значений ImageFormat / Compression,
+    // по одной на условие format: или compression:
+    const QVector<quint32> &formatMasks() const { return m_formatMasks; }
+    const QVector<quint32> &compressionMasks() const { return m_compressionMasks; }
+
+private:
+    QString m_text;
+    bool m_valid = true;
+    QStringList m_words;    // в нижнем регистре
+    QVector<Condition> m_conditions;
+    QVector<quint32> m_formatMasks;
+    QVector<quint32> m_compressionMasks;
+};
+
+#endif // FILTERQUERY_H
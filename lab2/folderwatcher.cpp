@@ -0,0 +1,435 @@
+#include "folderwatcher.h"
+#include "imageanalyzer.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include <QtConcurrent>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Копирование файла порождает серию событий: перечитываем один раз после затишья
+const int kDebounceMs = 300;
+
+#ifdef Q_OS_LINUX
+// Файлы - готовые после записи или переименования и удаленные; каталоги - созданные и исчезнувшие
+const quint32 kInotifyMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE |
+                             IN_DELETE_SELF | IN_ONLYDIR;
+#endif
+
+QString directoryOf(const QString &path)
+{
+    return path.left(path.lastIndexOf('/'));
+}
+
+} // namespace
+
+FolderWatcher::FolderWatcher(QObject *parent) : QObject(parent)
+{
+    m_debounce.setSingleShot(true);
+    m_debounce.setInterval(kDebounceMs);
+    connect(&m_debounce, &QTimer::timeout, this, &FolderWatcher::startRescan);
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &FolderWatcher::directoryChanged);
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &FolderWatcher::fileChanged);
+    connect(&m_rescan, &QFutureWatcher<Rescan>::finished, this, &FolderWatcher::rescanFinished);
+
+#ifdef Q_OS_LINUX
+    m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify >= 0) {
+        m_notifier = new QSocketNotifier(m_inotify, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, &FolderWatcher::readEvents);
+    }
+#endif
+}
+
+FolderWatcher::~FolderWatcher()
+{
+    m_rescan.waitForFinished();
+
+#ifdef Q_OS_LINUX
+    if (m_inotify >= 0) {
+        delete m_notifier;
+        ::close(m_inotify);
+    }
+#endif
+}
+
+void FolderWatcher::start(const QString &folderPath, bool recursive, const QStringList &known)
+{
+    stop();
+
+    m_root = QDir::cleanPath(folderPath);
+    m_recursive = recursive;
+    m_active = true;
+
+    // Первый проход: снимок всей папки и сверка с уже известными путями
+    QSet<QString> knownSet;
+    knownSet.reserve(known.size());
+    for (const QString &path : known) {
+        knownSet.insert(path);
+    }
+    QString root = m_root;
+    m_rescan.setFuture(QtConcurrent::run([root, recursive, knownSet]() {
+        return rescan(QHash<QString, DirectorySnapshot>(), QStringList{root}, recursive, knownSet,
+                      QHash<QString, FileStamp>());
+    }));
+}
+
+void FolderWatcher::stop()
+{
+    m_active = false;
+    m_debounce.stop();
+    m_rescan.waitForFinished();
+
+    const QStringList watched = m_watcher.directories() + m_watcher.files();
+    if (!watched.isEmpty()) m_watcher.removePaths(watched);
+    unwatchDirectories(m_dirWatches.keys());
+    m_dirs.clear();
+    m_dirty.clear();
+    m_settling.clear();
+    m_written.clear();
+    m_closed.clear();
+    m_deleted.clear();
+}
+
+void FolderWatcher::watchDirectories(const QStringList &dirs)
+{
+    if (dirs.isEmpty()) return;
+#ifdef Q_OS_LINUX
+    if (m_inotify >= 0) {
+        for (const QString &dir : dirs) {
+            int watch = ::inotify_add_watch(m_inotify, QFile::encodeName(dir).constData(), kInotifyMask);
+            if (watch < 0) continue;
+            m_watchDirs.insert(watch, dir);
+            m_dirWatches.insert(dir, watch);
+        }
+        return;
+    }
+#endif
+    m_watcher.addPaths(dirs);
+}
+
+void FolderWatcher::unwatchDirectories(const QStringList &dirs)
+{
+    if (dirs.isEmpty()) return;
+#ifdef Q_OS_LINUX
+    if (m_inotify >= 0) {
+        for (const QString &dir : dirs) {
+            auto it = m_dirWatches.find(dir);
+            if (it == m_dirWatches.end()) continue;
+            // Подписка исчезнувшего каталога уже снята ядром, ошибка не важна
+            ::inotify_rm_watch(m_inotify, it.value());
+            m_watchDirs.remove(it.value());
+            m_dirWatches.erase(it);
+        }
+        return;
+    }
+#endif
+    m_watcher.removePaths(dirs);
+}
+
+void FolderWatcher::readEvents()
+{
+#ifdef Q_OS_LINUX
+    const QStringList filters = ImageAnalyzer::nameFilters();
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    bool any = false;
+    for (;;) {
+        const ssize_t length = ::read(m_inotify, buffer, sizeof(buffer));
+        if (length <= 0) break;
+
+        for (ssize_t pos = 0; pos < length;) {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(buffer + pos);
+            pos += ssize_t(sizeof(struct inotify_event)) + event->len;
+            if (!m_active) continue;
+
+            // События потеряны: все каталоги сверяются со снимком
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (auto it = m_dirs.constBegin(); it != m_dirs.constEnd(); ++it) m_dirty.insert(it.key());
+                any = true;
+                continue;
+            }
+
+            const QString dir = m_watchDirs.value(event->wd);
+            if (dir.isEmpty()) continue;
+            if (event->mask & IN_IGNORED) {
+                m_watchDirs.remove(event->wd);
+                m_dirWatches.remove(dir);
+                continue;
+            }
+            // Исчезнувший каталог при перечитывании удаляется вместе с файлами
+            if (event->mask & IN_DELETE_SELF) {
+                m_dirty.insert(dir);
+                any = true;
+                continue;
+            }
+            if (event->len == 0) continue;
+
+            // Появившийся или исчезнувший вложенный каталог: перечитывается его родитель
+            const QString name = QFile::decodeName(event->name);
+            if (event->mask & IN_ISDIR) {
+                if (m_recursive) {
+                    m_dirty.insert(dir);
+                    any = true;
+                }
+                continue;
+            }
+            if (name.startsWith('.') || !QDir::match(filters, name)) continue;
+
+            // Создание без записи не сообщается: файл готов, когда его закроют после записи
+            const QString path = dir + '/' + name;
+            if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                m_deleted.remove(path);
+                m_closed.insert(path);
+                any = true;
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                m_closed.remove(path);
+                m_deleted.insert(path);
+                auto snapshot = m_dirs.find(dir);
+                if (snapshot != m_dirs.end()) snapshot->remove(name);
+                any = true;
+            }
+        }
+    }
+    if (any && !m_rescan.isRunning()) m_debounce.start();
+#endif
+}
+
+void FolderWatcher::directoryChanged(const QString &path)
+{
+    if (!m_active) return;
+
+    m_dirty.insert(path);
+    if (!m_rescan.isRunning()) m_debounce.start();
+}
+
+void FolderWatcher::fileChanged(const QString &path)
+{
+    if (!m_active || !m_settling.contains(path)) return;
+
+    // Файл еще пишется: отметка проверится после затишья
+    m_written.insert(path);
+    if (!m_rescan.isRunning()) m_debounce.start();
+}
+
+void FolderWatcher::startRescan()
+{
+    if (!m_active || m_rescan.isRunning()) return;
+
+    // Одни события о файлах: перечитывать нечего
+    if (m_dirty.isEmpty() && m_settling.isEmpty()) {
+        if (m_closed.isEmpty() && m_deleted.isEmpty()) return;
+        const QStringList changed = m_closed.values();
+        const QStringList removed = m_deleted.values();
+        m_closed.clear();
+        m_deleted.clear();
+        emit changesDetected(changed, removed);
+        return;
+    }
+
+    QStringList dirs = m_dirty.values();
+    m_dirty.clear();
+    m_written.clear();
+
+    // Копии неявно разделяются и не меняются, пока идет перечитывание
+    QHash<QString, DirectorySnapshot> previous = m_dirs;
+    QHash<QString, FileStamp> settling = m_settling;
+    bool recursive = m_recursive;
+    m_rescan.setFuture(QtConcurrent::run([previous, dirs, recursive, settling]() {
+        return rescan(previous, dirs, recursive, QSet<QString>(), settling);
+    }));
+}
+
+void FolderWatcher::rescanFinished()
+{
+    if (!m_active) return;
+
+    Rescan result = m_rescan.result();
+    for (const QString &dir : result.removedDirs) {
+        m_dirs.remove(dir);
+    }
+    for (auto it = result.dirs.constBegin(); it != result.dirs.constEnd(); ++it) {
+        m_dirs.insert(it.key(), it.value());
+    }
+    unwatchDirectories(result.removedDirs);
+    watchDirectories(result.addedDirs);
+
+    // Снимок хранит последние отметки: дописанный файл не считается измененным снова
+    for (auto it = result.stamps.constBegin(); it != result.stamps.constEnd(); ++it) {
+        auto dir = m_dirs.find(directoryOf(it.key()));
+        if (dir != m_dirs.end()) dir->insert(it.key().mid(it.key().lastIndexOf('/') + 1), it.value());
+    }
+
+    QSet<QString> changed = m_closed;
+    QSet<QString> removed = m_deleted;
+    m_closed.clear();
+    m_deleted.clear();
+    for (const QString &path : result.removed) {
+        changed.remove(path);
+        removed.insert(path);
+    }
+
+    // inotify сообщит об окончании записи сам: найденные при перечитывании
+    // файлы (в новом каталоге или после переполнения очереди) выдаются сразу
+    if (m_inotify >= 0) {
+        for (const QString &path : result.changed) {
+            changed.insert(path);
+        }
+        if (!changed.isEmpty() || !removed.isEmpty()) emit changesDetected(changed.values(), removed.values());
+        if (!m_dirty.isEmpty() || !m_closed.isEmpty() || !m_deleted.isEmpty()) m_debounce.start();
+        return;
+    }
+
+    // Ожидавший файл готов, если отметка не изменилась и записей в него за проход не было;
+    // исчезнувший (без отметки) просто перестает ожидать
+    QSet<QString> settledSet;
+    for (const QString &path : result.settled) {
+        settledSet.insert(path);
+    }
+    QStringList unwatch;
+    for (auto it = m_settling.begin(); it != m_settling.end();) {
+        auto stamp = result.stamps.constFind(it.key());
+        const bool present = stamp != result.stamps.constEnd();
+        const bool ready = present && settledSet.contains(it.key()) && !m_written.contains(it.key());
+        if (present && !ready) {
+            it.value() = stamp.value();
+            ++it;
+            continue;
+        }
+        if (ready) changed.insert(it.key());
+        unwatch.append(it.key());
+        it = m_settling.erase(it);
+    }
+
+    QStringList watch;
+    for (const QString &path : result.changed) {
+        if (!m_settling.contains(path)) watch.append(path);
+        m_settling.insert(path, result.stamps.value(path));
+    }
+    if (!unwatch.isEmpty()) m_watcher.removePaths(unwatch);
+    if (!watch.isEmpty()) m_watcher.addPaths(watch);
+
+    if (!changed.isEmpty() || !removed.isEmpty()) {
+        emit changesDetected(changed.values(), removed.values());
+    }
+
+    // События, пришедшие во время перечитывания, и файлы, запись в которые еще идет
+    if (!m_dirty.isEmpty() || !m_settling.isEmpty()) m_debounce.start();
+}
+
+FolderWatcher::Rescan FolderWatcher::rescan(const QHash<QString, DirectorySnapshot> &previous,
+                                            const QStringList &dirs, bool recursive,
+                                            const QSet<QString> &known,
+                                            const QHash<QString, FileStamp> &settling)
+{
+    Rescan result;
+    const QStringList filters = ImageAnalyzer::nameFilters();
+    const bool initial = previous.isEmpty();
+    QSet<QString> seen;
+    QSet<QString> dropped;
+
+    // Каталог исчез: все его файлы и вложенные каталоги удалены
+    auto dropDirectory = [&](const QString &dir) {
+        const QString prefix = dir + '/';
+        for (auto it = previous.constBegin(); it != previous.constEnd(); ++it) {
+            if (it.key() != dir && !it.key().startsWith(prefix)) continue;
+            if (dropped.contains(it.key())) continue;
+            dropped.insert(it.key());
+            for (auto file = it.value().constBegin(); file != it.value().constEnd(); ++file) {
+                result.removed.append(it.key() + '/' + file.key());
+            }
+            result.removedDirs.append(it.key());
+        }
+    };
+
+    QStringList queue = dirs;
+    QSet<QString> queued;
+    for (const QString &dir : dirs) {
+        queued.insert(dir);
+    }
+    while (!queue.isEmpty()) {
+        const QString dir = queue.takeFirst();
+        QDir directory(dir);
+        if (!directory.exists()) {
+            if (previous.contains(dir)) dropDirectory(dir);
+            continue;
+        }
+
+        const DirectorySnapshot old = previous.value(dir);
+        DirectorySnapshot current;
+        const QFileInfoList files = directory.entryInfoList(filters, QDir::Files | QDir::NoDotAndDotDot);
+        for (const QFileInfo &info : files) {
+            FileStamp stamp;
+            stamp.size = info.size();
+            stamp.modified = info.lastModified().toMSecsSinceEpoch();
+            current.insert(info.fileName(), stamp);
+
+            const QString path = info.filePath();
+            auto before = old.constFind(info.fileName());
+            if (before == old.constEnd()) {
+                if (initial && known.contains(path)) {
+                    seen.insert(path);
+                    continue;
+                }
+            } else if (before->size == stamp.size && before->modified == stamp.modified) {
+                continue;
+            }
+            result.changed.append(path);
+            result.stamps.insert(path, stamp);
+        }
+        for (auto it = old.constBegin(); it != old.constEnd(); ++it) {
+            if (!current.contains(it.key())) result.removed.append(dir + '/' + it.key());
+        }
+
+        if (!previous.contains(dir)) result.addedDirs.append(dir);
+        result.dirs.insert(dir, current);
+
+        if (!recursive) continue;
+
+        // Новые вложенные каталоги перечитываются целиком, исчезнувшие - удаляются
+        const QStringList subdirs = directory.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+        QSet<QString> present;
+        for (const QString &name : subdirs) {
+            const QString subdir = dir + '/' + name;
+            present.insert(subdir);
+            if (!previous.contains(subdir) && !queued.contains(subdir)) {
+                queue.append(subdir);
+                queued.insert(subdir);
+            }
+        }
+        for (auto it = previous.constBegin(); it != previous.constEnd(); ++it) {
+            const QString &path = it.key();
+            if (path.startsWith(dir + '/') && path.lastIndexOf('/') == dir.size() && !present.contains(path)) {
+                dropDirectory(path);
+            }
+        }
+    }
+
+    // Известные пути, которых нет на диске, удалены после анализа
+    if (initial) {
+        for (const QString &path : known) {
+            if (!seen.contains(path)) result.removed.append(path);
+        }
+    }
+
+    // Ожидающие окончания записи проверяются по одному, без перечитывания каталога.
+    // Снова измененный при перечитывании каталога уже получил новую отметку.
+    for (auto it = settling.constBegin(); it != settling.constEnd(); ++it) {
+        if (result.stamps.contains(it.key())) continue;
+
+        QFileInfo info(it.key());
+        if (!info.exists()) continue;
+        FileStamp stamp;
+        stamp.size = info.size();
+        stamp.modified = info.lastModified().toMSecsSinceEpoch();
+        result.stamps.insert(it.key(), stamp);
+        if (stamp.size == it->size && stamp.modified == it->modified) result.settled.append(it.key());
+    }
+    return result;
+}
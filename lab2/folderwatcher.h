@@ -0,0 +1,98 @@
+#ifndef FOLDERWATCHER_H
+#define FOLDERWATCHER_H
+
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+
+class QSocketNotifier;
+
+// Наблюдение за папкой после анализа. Подписка на каталоги (уведомления ОС,
+// без опроса), между изменениями наблюдение не расходует процессор.
+// В Linux - inotify: события называют файл, закрытие после записи
+// (IN_CLOSE_WRITE) и переименование в каталог сообщают о готовом новом или
+// перезаписанном на месте файле, удаление и переименование из каталога -
+// об удаленном. Каталог перечитывается, только если в нем появился или
+// исчез вложенный каталог, или очередь событий переполнилась.
+// На других системах - QFileSystemWatcher: при событии каталог перечитывается,
+// и по размеру и времени изменения файлов находятся новые, измененные и
+// удаленные. Запись в файл событий каталога не порождает, поэтому новый или
+// измененный файл сначала ждет окончания записи: на него ставится своя
+// подписка, и после каждого затишья его отметка проверяется, пока не совпадет
+// на двух проходах подряд. Файл, перезаписанный на месте, так не замечается.
+class FolderWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FolderWatcher(QObject *parent = nullptr);
+    ~FolderWatcher();
+
+    // known - пути, уже учтенные в результатах. Снимок папки строится
+    // в фоне; расхождения с known приходят первым changesDetected.
+    void start(const QString &folderPath, bool recursive, const QStringList &known);
+    void stop();
+
+    bool isActive() const { return m_active; }
+    int directoryCount() const { return m_dirs.size(); }
+
+signals:
+    // changed - новые и измененные файлы, запись в которые закончилась;
+    // их нужно проанализировать
+    void changesDetected(const QStringList &changed, const QStringList &removed);
+
+private:
+    struct FileStamp {
+        qint64 size = 0;
+        qint64 modified = 0;
+    };
+    typedef QHash<QString, FileStamp> DirectorySnapshot;   // имя файла -> отметка
+
+    struct Rescan {
+        QHash<QString, DirectorySnapshot> dirs;     // перечитанные каталоги
+        QStringList addedDirs;
+        QStringList removedDirs;
+        QStringList changed;
+        QStringList removed;
+        QStringList settled;                        // из ожидавших: отметка не изменилась
+        QHash<QString, FileStamp> stamps;           // отметки измененных и ожидавших файлов
+    };
+
+    static Rescan rescan(const QHash<QString, DirectorySnapshot> &previous, const QStringList &dirs,
+                         bool recursive, const QSet<QString> &known,
+                         const QHash<QString, FileStamp> &settling);
+
+    void directoryChanged(const QString &path);
+    void fileChanged(const QString &path);
+    void startRescan();
+    void rescanFinished();
+    void watchDirectories(const QStringList &dirs);
+    void unwatchDirectories(const QStringList &dirs);
+    void readEvents();
+
+    QFileSystemWatcher m_watcher;
+    QTimer m_debounce;
+    QFutureWatcher<Rescan> m_rescan;
+
+    QString m_root;
+    bool m_recursive = false;
+    bool m_active = false;
+    QHash<QString, DirectorySnapshot> m_dirs;
+    QSet<QString> m_dirty;
+    QHash<QString, FileStamp> m_settling;   // изменились, запись может еще идти
+    QSet<QString> m_written;                // запись во время текущего перечитывания
+
+    // inotify; -1 - недоступен, работает QFileSystemWatcher
+    int m_inotify = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    QHash<int, QString> m_watchDirs;        // дескриптор подписки -> каталог
+    QHash<QString, int> m_dirWatches;
+    QSet<QString> m_closed;                 // записаны до конца, еще не сообщены
+    QSet<QString> m_deleted;                // удалены, еще не сообщены
+};
+
+#endif // FOLDERWATCHER_H
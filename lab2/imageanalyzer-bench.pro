@@ -0,0 +1,21 @@
+QT += core gui concurrent
+QT -= widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = imageanalyzer-bench
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(analyzer.pri)
+
+SOURCES += \
+    benchmain.cpp
+
+win32: LIBS += -lpsapi
+
+CONFIG += release
+QMAKE_CXXFLAGS_RELEASE -= -O
+QMAKE_CXXFLAGS_RELEASE += -O2
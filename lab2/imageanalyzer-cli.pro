@@ -0,0 +1,19 @@
+QT += core gui concurrent
+QT -= widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = imageanalyzer-cli
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(analyzer.pri)
+
+SOURCES += \
+    climain.cpp
+
+CONFIG += release
+QMAKE_CXXFLAGS_RELEASE -= -O
+QMAKE_CXXFLAGS_RELEASE += -O2
@@ -1,120 +1,616 @@
 #include "imageanalyzer.h"
+#include "imageprobe.h"
+#include "pathpool.h"
+#include "metadatacache.h"
+#include "latencyhistogram.h"
+#include "scanprofiler.h"
+#include "boundedqueue.h"
+#include "scancontroller.h"
+#include "scancheckpoint.h"
+#include "pixelanalyzer.h"
+#include "perceptualhash.h"
 #include <QDir>
+#include <QDirIterator>
 #include <QFileInfo>
 #include <QImage>
+#include <QImageReader>
 #include <QDebug>
 #include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QHash>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+#include <algorithm>
 
-ImageAnalyzer::ImageAnalyzer(QObject *parent) : QObject(parent) {}
+namespace {
 
-void ImageAnalyzer::analyzeFolder(const QString &folderPath, bool *stopFlag)
+// Результаты потока копятся локально и выдаются одним захватом мьютекса
+const int kDeliveryChunk = 16;
+
+// Наибольшая пачка путей, переставляемая планировщиком чтения
+const int kIoBatch = 2048;
+
+// Потоков при подборе без декодирования: чтение заголовков почти не
+// загружает процессор, NVMe выгодна глубокая очередь запросов
+const int kMaxIoThreads = 16;
+
+// Подкачивается начало файла, где заголовок; пиксели - файл целиком
+const qint64 kPrefetchHeaderBytes = 256 * 1024;
+
+// QImage декодирует файл целиком и не прерывается. Файлы крупнее этого,
+// чей заголовок не разобран, читаются через QImageReader только до размеров,
+// чтобы отмена не ждала декодирования многогигабайтного TIFF.
+const qint64 kMaxFallbackDecodeBytes = 64 * 1024 * 1024;
+
+struct PathItem {
+    int index = 0;
+    QString path;
+};
+
+void updatePeak(std::atomic<int> &peak, int value)
+{
+    int current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+ImageAnalyzer::ImageAnalyzer(QObject *parent) : QObject(parent)
 {
-    QStringList imageFilters = {"*.jpg", "*.jpeg", "*.gif", "*.tif", "*.tiff",
-                                "*.bmp", "*.png", "*.pcx"};
+}
 
-    QDir directory(folderPath);
-    QStringList imageFiles = directory.entryList(imageFilters, QDir::Files | QDir::NoDotAndDotDot);
+QStringList ImageAnalyzer::nameFilters()
+{
+    return {"*.jpg", "*.jpeg", "*.gif", "*.tif", "*.tiff", "*.bmp", "*.png", "*.pcx"};
+}
 
-    int totalFiles = imageFiles.size();
-    if (totalFiles == 0) {
-        emit finished();
-        return;
+PipelineMetrics ImageAnalyzer::pipelineMetrics() const
+{
+    PipelineMetrics metrics;
+    metrics.pathQueueDepth = m_pathQueueDepth.load(std::memory_order_relaxed);
+    metrics.pathQueuePeak = m_pathQueuePeak.load(std::memory_order_relaxed);
+    metrics.pathQueueCapacity = m_pathQueueCapacity.load(std::memory_order_relaxed);
+    if (m_results) {
+        metrics.resultDepth = m_results->size();
+        metrics.resultCapacity = m_results->capacity();
     }
+    metrics.resultPeak = m_resultPeak.load(std::memory_order_relaxed);
+    metrics.pendingPeak = m_pendingPeak.load(std::memory_order_relaxed);
+    metrics.walkerBlockedMs = m_walkerBlockedNs.load(std::memory_order_relaxed) / 1000000;
+    metrics.deliveryBlockedMs = m_deliveryBlockedNs.load(std::memory_order_relaxed) / 1000000;
+    metrics.activeThreads = m_activeThreads.load(std::memory_order_relaxed);
+    metrics.maxThreads = m_maxThreads.load(std::memory_order_relaxed);
+    metrics.ioLatencyUs = m_ioLatencyUs.load(std::memory_order_relaxed);
+    metrics.prefetchedFiles = m_prefetchedFiles.load(std::memory_order_relaxed);
+    metrics.adaptiveThreads = m_adaptiveThreads.load(std::memory_order_relaxed);
+    return metrics;
+}
+
+void ImageAnalyzer::analyzeFolder(const QString &folderPath, ScanController *controller,
+                                  const ScanOptions &options)
+{
+    Q_ASSERT(m_results);
+    Q_ASSERT(controller);
+    setAnalysisMode(options);
+
+    // Без заданного числа потоков оно подбирается планировщиком чтения
+    const bool adaptive = options.threadCount <= 0;
+    const bool decodes = options.deepAnalysis || options.perceptualHash;
+    int threadCount = adaptive ? QThread::idealThreadCount() : options.threadCount;
+    if (adaptive && !decodes) threadCount = qMax(threadCount, kMaxIoThreads);
+    threadCount = qMax(1, threadCount);
+
+    IoScheduler scheduler(options.ioOrder, options.prefetchWindow,
+                          decodes ? 0 : kPrefetchHeaderBytes, threadCount, adaptive);
+    m_io = &scheduler;
+
+    // Найденные пути идут в ограниченную очередь: если анализ не успевает,
+    // обход каталога ждет, и память не растет вместе с размером папки
+    BoundedQueue<PathItem> paths(options.pathQueueCapacity);
+    std::atomic<bool> listingDone{false};
+    std::atomic<int> found{0};
+    std::atomic<int> processed{0};
 
-    int processed = 0;
+    m_pathQueueDepth = 0;
+    m_pathQueuePeak = 0;
+    m_pathQueueCapacity = paths.capacity();
+    m_resultPeak = 0;
+    m_pendingPeak = 0;
+    m_walkerBlockedNs = 0;
+    m_deliveryBlockedNs = 0;
+    m_activeThreads = scheduler.activeThreads();
+    m_maxThreads = threadCount;
+    m_ioLatencyUs = 0;
+    m_prefetchedFiles = 0;
+    m_adaptiveThreads = adaptive;
 
-    for (const QString &filename : imageFiles) {
-        if (*stopFlag) break;
+    QMutex deliveryMutex;
 
-        QString filePath = directory.filePath(filename);
-        ImageMetadata metadata = analyzeImage(filePath);
-        emit resultReady(filename, metadata);
+    // Для упорядоченной выдачи: готовые результаты ждут, пока не будут
+    // выданы все предыдущие в порядке обнаружения. Потоки не уходят дальше
+    // окна от первого невыданного, поэтому ожидающих не больше размера окна.
+    QHash<int, ImageMetadata> pending;
+    std::atomic<int> nextToDeliver{0};
+    const int window = m_results->capacity();
 
-        processed++;
-        int progress = (processed * 100) / totalFiles;
-        QString status = QString("Обработка: %1/%2 файлов").arg(processed).arg(totalFiles);
+    auto reportProgress = [&]() {
+        int total = found.load(std::memory_order_relaxed);
+        int done = processed.load(std::memory_order_relaxed);
+        m_pathQueueDepth = paths.size();
+
+        scheduler.adjust(done);
+        m_activeThreads = scheduler.activeThreads();
+        m_ioLatencyUs = scheduler.ioLatencyUs();
+        m_prefetchedFiles = scheduler.prefetchedFiles();
+
+        int progress = total > 0 ? (done * 100) / total : 0;
+        QString status = listingDone ? QString("Обработка: %1/%2 файлов").arg(done).arg(total)
+                                     : QString("Обработка: %1/%2 файлов (поиск продолжается)").arg(done).arg(total);
         emit progressUpdated(progress, status);
+    };
+
+    auto notifyConsumer = [&]() {
+        if (m_results->markSignaled()) emit resultsAvailable();
+    };
+
+    // Запись в буфер результатов; если потребитель отстает - ждем его
+    auto pushResult = [&](ImageMetadata &&metadata) {
+        if (!m_results->tryPush(std::move(metadata))) {
+            notifyConsumer();
+
+            QElapsedTimer blocked;
+            blocked.start();
+            Backoff backoff;
+            while (!m_results->tryPush(std::move(metadata)) && !controller->isCancelled()) {
+                backoff.wait();
+            }
+            m_deliveryBlockedNs += blocked.nsecsElapsed();
+        }
+        updatePeak(m_resultPeak, m_results->size());
+    };
 
-        QThread::msleep(1);
+    auto deliver = [&](QVector<QPair<int, ImageMetadata>> &buffer) {
+        if (buffer.isEmpty()) return;
+
+        ScanProfiler::Scope scope(m_profiler, ScanProfiler::Delivery);
+        QMutexLocker locker(&deliveryMutex);
+
+        for (auto &item : buffer) {
+            if (options.orderedResults) {
+                pending.insert(item.first, std::move(item.second));
+            } else {
+                pushResult(std::move(item.second));
+            }
+        }
+
+        if (options.orderedResults) {
+            updatePeak(m_pendingPeak, pending.size());
+
+            int next = nextToDeliver.load(std::memory_order_relaxed);
+            auto it = pending.find(next);
+            while (it != pending.end()) {
+                pushResult(std::move(it.value()));
+                pending.erase(it);
+                it = pending.find(++next);
+            }
+            nextToDeliver.store(next, std::memory_order_release);
+        }
+
+        processed += buffer.size();
+        buffer.clear();
+        notifyConsumer();
+    };
+
+    auto worker = [&](int workerIndex) {
+        QVector<QPair<int, ImageMetadata>> buffer;
+        PathItem item;
+        QElapsedTimer fileTimer;
+        Backoff backoff;
+
+        while (controller->waitIfPaused()) {
+            bool done = listingDone.load(std::memory_order_acquire);
+
+            // Поток сверх подобранного числа ждет, не беря путей
+            if (workerIndex >= scheduler.activeThreads()) {
+                deliver(buffer);
+                if (done && paths.size() == 0) break;
+                QThread::msleep(5);
+                continue;
+            }
+
+            if (!paths.tryPop(item)) {
+                // Очередь пуста: отдаем накопленное, чтобы не задерживать выдачу
+                deliver(buffer);
+                if (done) break;
+                backoff.wait();
+                continue;
+            }
+            backoff.reset();
+            scheduler.started();
+
+            if (options.orderedResults &&
+                item.index - nextToDeliver.load(std::memory_order_acquire) >= window) {
+                deliver(buffer);
+                Backoff windowBackoff;
+                while (item.index - nextToDeliver.load(std::memory_order_acquire) >= window &&
+                       !controller->isCancelled()) {
+                    windowBackoff.wait();
+                }
+                if (controller->isCancelled()) break;
+            }
+
+            if (m_latency) fileTimer.start();
+            m_busyWorkers++;
+            MetadataCache::FileKey fileKey;
+            ImageMetadata metadata = analyzeImage(item.path, controller, m_checkpoint ? &fileKey : nullptr);
+            m_busyWorkers--;
+            if (m_latency) m_latency->record(fileTimer.nsecsElapsed());
+
+            // Прерванный анализ не выдается и не попадает в журнал:
+            // при продолжении файл будет прочитан заново
+            if (controller->isCancelled()) break;
+            if (m_checkpoint) m_checkpoint->append(item.path, fileKey, metadata);
+            buffer.append(qMakePair(item.index, std::move(metadata)));
+
+            if (buffer.size() >= kDeliveryChunk) deliver(buffer);
+        }
+        deliver(buffer);
+    };
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+
+    QVector<QFuture<void>> workers;
+    for (int i = 0; i < threadCount; ++i) {
+        workers.append(QtConcurrent::run(&pool, [&worker, i]() { worker(i); }));
     }
 
+    QElapsedTimer progressTimer;
+    progressTimer.start();
+
+    // Путь уходит в очередь анализа; если анализ не успевает - ждем места
+    auto dispatch = [&](PathItem &&item) {
+        scheduler.dispatched(item.path);
+        if (!paths.tryPush(std::move(item))) {
+            QElapsedTimer blocked;
+            blocked.start();
+            Backoff backoff;
+            while (!paths.tryPush(std::move(item)) && controller->waitIfPaused()) {
+                backoff.wait();
+                if (progressTimer.elapsed() >= options.progressIntervalMs) {
+                    reportProgress();
+                    progressTimer.restart();
+                }
+            }
+            m_walkerBlockedNs += blocked.nsecsElapsed();
+        }
+        updatePeak(m_pathQueuePeak, paths.size());
+    };
+
+    // Найденные пути копятся пачкой и уходят в очередь в порядке расположения
+    // на диске; номер из обхода сохраняет порядок выдачи. Пачка охватывает
+    // меньше половины окна выдачи: иначе все потоки могли бы ждать
+    // предшественников, оставшихся в очереди.
+    QVector<PathItem> batch;
+    const int batchSpan = qBound(1, window / 2, kIoBatch);
+    auto flushBatch = [&]() {
+        if (batch.isEmpty()) return;
+
+        QVector<QString> batchPaths;
+        batchPaths.reserve(batch.size());
+        for (const PathItem &pathItem : batch) {
+            batchPaths.append(pathItem.path);
+        }
+        for (int i : scheduler.order(batchPaths)) {
+            dispatch(std::move(batch[i]));
+        }
+        batch.clear();
+    };
+
+    // Обход каталога в этом потоке: пути по одному попадают в очередь
+    QDirIterator::IteratorFlags flags = options.recursive ? QDirIterator::Subdirectories
+                                                          : QDirIterator::NoIteratorFlags;
+    QDirIterator it(folderPath, nameFilters(), QDir::Files | QDir::NoDotAndDotDot, flags);
+    int index = 0;
+
+    qint64 listingStart = m_profiler ? m_profiler->now() : 0;
+    while (it.hasNext() && controller->waitIfPaused()) {
+        PathItem item;
+        item.index = index++;
+        item.path = it.next();
+        if (m_profiler) m_profiler->record(ScanProfiler::Listing, listingStart);
+        found++;
+
+        // Файл обработан в прерванном запуске: результат из журнала выдается
+        // сразу, минуя очередь путей и потоки анализа
+        ImageMetadata restored;
+        if (m_checkpoint && m_checkpoint->take(item.path, restored) && isComplete(restored)) {
+            restored.pathId = PathPool::instance().intern(item.path);
+            if (options.orderedResults) {
+                // Предшественники из пачки должны дойти до потоков анализа
+                if (item.index - nextToDeliver.load(std::memory_order_acquire) >= window) flushBatch();
+                Backoff windowBackoff;
+                while (item.index - nextToDeliver.load(std::memory_order_acquire) >= window &&
+                       !controller->isCancelled()) {
+                    windowBackoff.wait();
+                }
+                if (controller->isCancelled()) break;
+            }
+            QVector<QPair<int, ImageMetadata>> single;
+            single.append(qMakePair(item.index, std::move(restored)));
+            deliver(single);
+
+            if (progressTimer.elapsed() >= options.progressIntervalMs) {
+                reportProgress();
+                progressTimer.restart();
+            }
+            if (m_profiler) listingStart = m_profiler->now();
+            continue;
+        }
+
+        // Пачка уходит, когда набрана или когда потокам нечего делать
+        if (!batch.isEmpty() && item.index - batch.first().index >= batchSpan) flushBatch();
+        batch.append(std::move(item));
+        if (paths.size() == 0) flushBatch();
+
+        if (progressTimer.elapsed() >= options.progressIntervalMs) {
+            reportProgress();
+            progressTimer.restart();
+        }
+        if (m_profiler) listingStart = m_profiler->now();
+    }
+    if (!controller->isCancelled()) flushBatch();
+    listingDone.store(true, std::memory_order_release);
+
+    while (!pool.waitForDone(options.progressIntervalMs)) {
+        reportProgress();
+    }
+    for (QFuture<void> &future : workers) {
+        future.waitForFinished();
+    }
+
+    // После остановки выдаем то, что успели обработать, пропуская пробелы
+    if (options.orderedResults && !pending.isEmpty()) {
+        QList<int> indexes = pending.keys();
+        std::sort(indexes.begin(), indexes.end());
+        for (int pendingIndex : indexes) {
+            pushResult(std::move(pending[pendingIndex]));
+        }
+    }
+
+    if (m_checkpoint) {
+        if (controller->isCancelled()) m_checkpoint->flush();
+        else m_checkpoint->remove();
+    }
+
+    m_results->close();
+    notifyConsumer();
+    reportProgress();
+    m_io = nullptr;
+
     emit finished();
 }
 
-ImageMetadata ImageAnalyzer::analyzeImage(const QString &filePath)
+bool ImageAnalyzer::isComplete(const ImageMetadata &metadata) const
+{
+    // Статистика пикселей и хэш есть только у записей, посчитанных в этих режимах;
+    // у файла с ошибкой их не будет никогда
+    if (metadata.hasError()) return true;
+    if (m_deepAnalysis && !metadata.hasContent()) return false;
+    if (m_perceptualHash && !metadata.hasPerceptualHash()) return false;
+    return true;
+}
+
+void ImageAnalyzer::setAnalysisMode(const ScanOptions &options)
+{
+    m_deepAnalysis = options.deepAnalysis;
+    m_perceptualHash = options.perceptualHash;
+}
+
+QVector<ImageMetadata> ImageAnalyzer::analyzeFiles(const QStringList &paths, int threadCount)
+{
+    QVector<ImageMetadata> results(paths.size());
+    analyzeFiles(paths, threadCount, [&results](int index, ImageMetadata &&metadata) {
+        results[index] = std::move(metadata);
+    });
+    return results;
+}
+
+void ImageAnalyzer::analyzeFiles(const QStringList &paths, int threadCount,
+                                 const std::function<void(int, ImageMetadata &&)> &ready)
+{
+    std::atomic<int> next{0};
+
+    auto worker = [&]() {
+        m_busyWorkers++;
+        for (int i = next++; i < paths.size(); i = next++) {
+            ready(i, analyzeImage(paths.at(i), nullptr));
+        }
+        m_busyWorkers--;
+    };
+
+    // Обычно изменений немного: потоков не больше, чем файлов
+    threadCount = qMin(paths.size(), threadCount > 0 ? threadCount : QThread::idealThreadCount());
+    QVector<QFuture<void>> helpers;
+    for (int i = 1; i < threadCount; ++i) {
+        helpers.append(QtConcurrent::run(worker));
+    }
+    worker();
+    for (QFuture<void> &future : helpers) {
+        future.waitForFinished();
+    }
+}
+
+ImageMetadata ImageAnalyzer::analyzeImage(const QString &filePath, const ScanController *controller,
+                                          MetadataCache::FileKey *fileKey)
 {
     ImageMetadata metadata;
-    metadata.filepath = filePath;
-    metadata.filename = QFileInfo(filePath).fileName();
+    metadata.pathId = PathPool::instance().intern(filePath);
 
-    QImage image(filePath);
+    QElapsedTimer ioTimer;
+    if (m_io) ioTimer.start();
 
-    if (image.isNull()) {
-        metadata.error = "Не удается загрузить изображение";
-        return metadata;
+    QFileInfo fileInfo(filePath);
+    MetadataCache::FileKey cacheKey;
+    {
+        ScanProfiler::Scope scope(m_profiler, ScanProfiler::Stat);
+        metadata.bytes = fileInfo.size();
+        if (m_cache || fileKey) cacheKey = MetadataCache::fileKey(fileInfo);
+        if (fileKey) *fileKey = cacheKey;
+        if (m_cache) {
+            ImageMetadata cached = metadata;
+            if (m_cache->lookup(filePath, cacheKey, cached) && isComplete(cached)) {
+                return cached;
+            }
+        }
     }
 
-    try {
-        // 1. Размер изображения в пикселях
-        metadata.size = QString("%1 × %2").arg(image.width()).arg(image.height());
+    metadata.format = ImageMetadata::formatFromSuffix(fileInfo.suffix());
 
-        // 2. Разрешение DPI
-        int dpmX = image.dotsPerMeterX();
-        int dpmY = image.dotsPerMeterY();
-        if (dpmX > 0 && dpmY > 0) {
-            int dpiX = qRound(dpmX * 0.0254);
-            int dpiY = qRound(dpmY * 0.0254);
-            metadata.resolution = QString("%1 × %2").arg(dpiX).arg(dpiY);
-        } else {
-            metadata.resolution = "Не указано";
-        }
-
-        // 3. Глубина цвета
-        switch (image.depth()) {
-        case 1: metadata.colorDepth = "1 бит"; break;
-        case 8: metadata.colorDepth = "8 бит"; break;
-        case 24: metadata.colorDepth = "24 бита"; break;
-        case 32: metadata.colorDepth = "32 бита"; break;
-        default: metadata.colorDepth = QString("%1 бит").arg(image.depth());
-        }
-
-        // 4. Формат и сжатие
-        QString ext = QFileInfo(filePath).suffix().toUpper();
-        metadata.format = ext;
-
-        if (ext == "JPG" || ext == "JPEG") {
-            metadata.compression = "JPEG";
-        } else if (ext == "PNG") {
-            metadata.compression = "Deflate";
-        } else if (ext == "GIF") {
-            metadata.compression = "LZW";
-        } else if (ext == "TIFF" || ext == "TIF") {
-            metadata.compression = "Зависит от файла";
-        } else if (ext == "BMP") {
-            metadata.compression = "Без сжатия";
-        } else if (ext == "PCX") {
-            metadata.compression = "RLE";
+    // Сначала разбираем только заголовок файла
+    ProbeInfo info;
+    QImage image;
+    bool probed;
+    {
+        ScanProfiler::Scope scope(m_profiler, ScanProfiler::Probe);
+        probed = ImageProbe::probe(filePath, info, controller);
+    }
+    if (m_io) m_io->recordIo(ioTimer.nsecsElapsed());
+    if (!probed) {
+        if (controller && controller->isCancelled()) return metadata;
+
+        if (metadata.bytes > kMaxFallbackDecodeBytes) {
+            // Только размеры и формат пикселей из заголовка, без разрешения и палитры
+            QImageReader reader(filePath);
+            QSize size;
+            {
+                ScanProfiler::Scope scope(m_profiler, ScanProfiler::Decode);
+                size = reader.size();
+            }
+            if (!size.isValid()) {
+                metadata.error = ImageError::LoadFailed;
+                if (m_cache) m_cache->store(filePath, cacheKey, metadata);
+                return metadata;
+            }
+
+            info.width = size.width();
+            info.height = size.height();
+            if (reader.imageFormat() != QImage::Format_Invalid) {
+                info.depth = QImage::toPixelFormat(reader.imageFormat()).bitsPerPixel();
+            }
         } else {
-            metadata.compression = "Неизвестно";
+            // Полное декодирование - только если заголовок не распознан
+            {
+                ScanProfiler::Scope scope(m_profiler, ScanProfiler::Decode);
+                image.load(filePath);
+            }
+            if (image.isNull()) {
+                metadata.error = ImageError::LoadFailed;
+                if (m_cache) m_cache->store(filePath, cacheKey, metadata);
+                return metadata;
+            }
+
+            info.width = image.width();
+            info.height = image.height();
+            info.depth = image.depth();
+            info.dpiX = image.dotsPerMeterX() > 0 ? qRound(image.dotsPerMeterX() * 0.0254) : 0;
+            info.dpiY = image.dotsPerMeterY() > 0 ? qRound(image.dotsPerMeterY() * 0.0254) : 0;
+            info.paletteColors = image.colorCount();
         }
 
-        QFileInfo fileInfo(filePath);
-        metadata.fileSize = formatFileSize(fileInfo.size());
+        // Сжатие известно только по расширению
+        switch (metadata.format) {
+        case ImageFormat::Jpeg: info.compression = Compression::Jpeg; break;
+        case ImageFormat::Png: info.compression = Compression::Deflate; break;
+        case ImageFormat::Gif: info.compression = Compression::Lzw; break;
+        case ImageFormat::Bmp: info.compression = Compression::None; break;
+        case ImageFormat::Pcx: info.compression = Compression::Rle; break;
+        default: info.compression = Compression::Unknown;
+        }
+    }
 
-        if (ext == "BMP" && image.colorCount() > 0) {
-            metadata.colorsInPalette = QString::number(image.colorCount());
+    if (info.format != ImageFormat::Unknown) metadata.format = info.format;
+    metadata.width = quint32(info.width);
+    metadata.height = quint32(info.height);
+    metadata.dpiX = quint32(qMax(info.dpiX, 0));
+    metadata.dpiY = quint32(qMax(info.dpiY, 0));
+    metadata.depth = quint8(info.depth);
+    metadata.compression = info.compression;
+    metadata.paletteColors = quint32(qMax(info.paletteColors, 0));
+    metadata.details = info.details;
+    if (info.pages.size() > 1) {
+        PageList *pageList = new PageList;
+        pageList->pages = info.pages;
+        metadata.pageList = QExplicitlySharedDataPointer<PageList>(pageList);
+    }
+
+    if (m_deepAnalysis && metadata.format == ImageFormat::Tiff && metadata.pageCount() > 1) {
+        if (controller && controller->isCancelled()) return metadata;
+        analyzePages(filePath, metadata, controller);
+        if (controller && controller->isCancelled()) return metadata;
+    } else if (m_deepAnalysis) {
+        if (controller && controller->isCancelled()) return metadata;
+        if (image.isNull()) {
+            ScanProfiler::Scope scope(m_profiler, ScanProfiler::Decode);
+            image.load(filePath);
+        }
+        if (!image.isNull()) {
+            // Ядра делятся между файлами, которые сейчас анализируются: при полном
+            // пуле каждое изображение считается одной полосой
+            ScanProfiler::Scope scope(m_profiler, ScanProfiler::Pixels);
+            const int busy = qMax(1, m_busyWorkers.load(std::memory_order_relaxed));
+            const int bands = qMax(1, QThread::idealThreadCount() / busy);
+            PixelAnalyzer::analyze(image, PixelAnalyzer::Auto, bands).applyTo(metadata);
         }
+    }
 
-    } catch (...) {
-        metadata.error = "Ошибка при анализе изображения";
+    if (m_perceptualHash) {
+        if (controller && controller->isCancelled()) return metadata;
+        ScanProfiler::Scope scope(m_profiler, ScanProfiler::Hash);
+        // Уже декодированное изображение не читается повторно
+        bool hashed = true;
+        if (!image.isNull()) metadata.perceptualHash = PerceptualHash::compute(image);
+        else hashed = PerceptualHash::fromFile(filePath, metadata.perceptualHash);
+        if (hashed) metadata.contentFlags |= ImageMetadata::PerceptualHashed;
     }
 
+    if (m_cache) m_cache->store(filePath, cacheKey, metadata);
     return metadata;
 }
 
-QString ImageAnalyzer::formatFileSize(qint64 bytes)
+void ImageAnalyzer::analyzePages(const QString &filePath, ImageMetadata &metadata,
+                                 const ScanController *controller)
 {
-    if (bytes < 1024) return QString("%1 байт").arg(bytes);
-    else if (bytes < 1024 * 1024) return QString("%1 КБ").arg(bytes / 1024.0, 0, 'f', 1);
-    else return QString("%1 МБ").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+    // Страницы независимы: каждая декодируется своим QImageReader, параллельно.
+    // Поток файла участвует в обработке сам, поэтому вызов из пула не блокирует его.
+    // Уменьшенные копии страниц в статистику не входят
+    QVector<int> pages;
+    const QVector<PageInfo> &pageInfo = metadata.pageList->pages;
+    for (int i = 0; i < pageInfo.size(); ++i) {
+        if (!(pageInfo[i].flags & PageInfo::Reduced)) pages.append(i);
+    }
+
+    PixelAccumulator accumulator;
+    ScanProfiler *profiler = m_profiler;
+    QtConcurrent::blockingMap(pages, [&filePath, &accumulator, profiler, controller](int &page) {
+        if (controller && controller->isCancelled()) return;
+
+        QImage image;
+        {
+            ScanProfiler::Scope scope(profiler, ScanProfiler::Decode);
+            QImageReader reader(filePath);
+            if (reader.jumpToImage(page)) image = reader.read();
+        }
+        if (image.isNull()) return;
+
+        ScanProfiler::Scope scope(profiler, ScanProfiler::Pixels);
+        accumulator.add(image);
+    });
+
+    if (controller && controller->isCancelled()) return;
+    const PixelStatistics stats = accumulator.statistics();
+    if (stats.pixels > 0) stats.applyTo(metadata);
 }
@@ -3,18 +3,53 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include "imagemetadata.h"
+#include "metadatacache.h"
+#include "spscring.h"
+#include "ioscheduler.h"
 
-struct ImageMetadata {
-    QString filename;
-    QString filepath;
-    QString size;
-    QString resolution;
-    QString colorDepth;
-    QString compression;
-    QString format;
-    QString error;
-    QString fileSize;
-    QString colorsInPalette;
+class LatencyHistogram;
+class ScanProfiler;
+class ScanController;
+class ScanCheckpoint;
+
+// Буфер готовых результатов между сканированием и потребителем
+typedef SpscRing<ImageMetadata> ResultRing;
+
+// Параметры сканирования папки
+struct ScanOptions {
+    int threadCount = 0;          // 0 - подбирается по задержке диска, не больше числа ядер (без пикселей - от 16)
+    bool recursive = false;       // обходить вложенные папки
+    bool orderedResults = true;   // выдавать результаты в порядке списка файлов
+    int pathQueueCapacity = 4096; // найденных путей, ожидающих анализа
+    int progressIntervalMs = 50;  // период обновления прогресса
+    bool deepAnalysis = false;    // статистика пикселей: каждый файл декодируется
+    bool perceptualHash = false;  // хэш уменьшенной копии для поиска похожих изображений
+    IoOrder ioOrder = IoOrder::Inode; // порядок чтения файлов внутри пачки найденных
+    int prefetchWindow = 32;      // файлов вперед для подкачки (posix_fadvise), 0 - без подкачки
+};
+
+// Заполненность очередей конвейера: обход -> очередь путей -> потоки
+// анализа -> буфер результатов -> потребитель
+struct PipelineMetrics {
+    int pathQueueDepth = 0;
+    int pathQueuePeak = 0;
+    int pathQueueCapacity = 0;
+    int resultDepth = 0;
+    int resultPeak = 0;
+    int resultCapacity = 0;
+    int pendingPeak = 0;            // результаты, ждущие предшественников (по порядку)
+    qint64 walkerBlockedMs = 0;     // обход ждал места в очереди путей
+    qint64 deliveryBlockedMs = 0;   // потоки ждали, пока потребитель освободит буфер
+    int activeThreads = 0;          // читающих потоков сейчас (при подборе)
+    int maxThreads = 0;
+    qint64 ioLatencyUs = 0;         // среднее время stat и заголовка за последний интервал
+    int prefetchedFiles = 0;
+    bool adaptiveThreads = false;
 };
 
 class ImageAnalyzer : public QObject
@@ -23,16 +58,85 @@ class ImageAnalyzer : public QObject
 
 public:
     explicit ImageAnalyzer(QObject *parent = nullptr);
-    void analyzeFolder(const QString &folderPath, bool *stopFlag);
+
+    // Маски имен анализируемых файлов
+    static QStringList nameFilters();
+
+    // Кэш проверяется до чтения файла; nullptr - без кэша
+    void setCache(MetadataCache *cache) { m_cache = cache; }
+
+    // Время анализа каждого файла; nullptr - не измерять
+    void setLatencyHistogram(LatencyHistogram *histogram) { m_latency = histogram; }
+
+    // Замеры по этапам сканирования; nullptr - без профилирования
+    void setProfiler(ScanProfiler *profiler) { m_profiler = profiler; }
+
+    // Буфер результатов обязателен. Когда он заполнен, анализ ждет
+    // потребителя; по окончании сканирования буфер закрывается.
+    void setResultRing(ResultRing *results) { m_results = results; }
+
+    // Журнал обработанных файлов: файлы из прошлого запуска выдаются без
+    // повторного чтения, новые дописываются. При отмене журнал сохраняется,
+    // после полного сканирования удаляется. nullptr - без журнала.
+    void setCheckpoint(ScanCheckpoint *checkpoint) { m_checkpoint = checkpoint; }
+
+    // controller обязателен: через него сканирование отменяют и ставят на паузу
+    void analyzeFolder(const QString &folderPath, ScanController *controller,
+                       const ScanOptions &options = ScanOptions());
+
+    // Отдельные файлы (например, измененные в наблюдаемой папке), параллельно,
+    // в режиме последнего analyzeFolder или setAnalysisMode. Результаты в порядке
+    // paths; буфер результатов не используется. threadCount 0 - по числу ядер.
+    QVector<ImageMetadata> analyzeFiles(const QStringList &paths, int threadCount = 0);
+    // То же, но каждый результат сразу передается ready(номер в paths, результат)
+    // из потока, который его получил
+    void analyzeFiles(const QStringList &paths, int threadCount,
+                      const std::function<void(int, ImageMetadata &&)> &ready);
+
+    // Глубокий анализ и хэш для analyzeFiles без analyzeFolder
+    void setAnalysisMode(const ScanOptions &options);
+
+    PipelineMetrics pipelineMetrics() const;
 
 signals:
     void progressUpdated(int value, const QString &status);
-    void resultReady(const QString &filename, const ImageMetadata &metadata);
+    // В буфере появились результаты; повторно - только после clearSignaled()
+    void resultsAvailable();
     void finished();
 
 private:
-    ImageMetadata analyzeImage(const QString &filePath);
-    QString formatFileSize(qint64 bytes);
+    // При отмене возвращает неполную запись, ее нужно отбросить.
+    // fileKey - размер, время изменения и inode файла на момент анализа
+    ImageMetadata analyzeImage(const QString &filePath, const ScanController *controller,
+                               MetadataCache::FileKey *fileKey = nullptr);
+    // Статистика пикселей по всем страницам многостраничного TIFF
+    void analyzePages(const QString &filePath, ImageMetadata &metadata, const ScanController *controller);
+
+    // Запись из кэша или журнала содержит все, что нужно в текущем режиме
+    bool isComplete(const ImageMetadata &metadata) const;
+
+    MetadataCache *m_cache = nullptr;
+    LatencyHistogram *m_latency = nullptr;
+    ScanProfiler *m_profiler = nullptr;
+    ResultRing *m_results = nullptr;
+    ScanCheckpoint *m_checkpoint = nullptr;
+    bool m_deepAnalysis = false;
+    bool m_perceptualHash = false;
+    IoScheduler *m_io = nullptr;    // только на время analyzeFolder
+    std::atomic<int> m_busyWorkers{0};  // потоков, анализирующих файл; делят ядра с полосами
+
+    std::atomic<int> m_pathQueueDepth{0};
+    std::atomic<int> m_pathQueuePeak{0};
+    std::atomic<int> m_pathQueueCapacity{0};
+    std::atomic<int> m_resultPeak{0};
+    std::atomic<int> m_pendingPeak{0};
+    std::atomic<qint64> m_walkerBlockedNs{0};
+    std::atomic<qint64> m_deliveryBlockedNs{0};
+    std::atomic<int> m_activeThreads{0};
+    std::atomic<int> m_maxThreads{0};
+    std::atomic<qint64> m_ioLatencyUs{0};
+    std::atomic<int> m_prefetchedFiles{0};
+    std::atomic<bool> m_adaptiveThreads{false};
 };
 
 #endif // IMAGEANALYZER_H
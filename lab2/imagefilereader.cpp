@@ -0,0 +1,66 @@
+#include "imagefilereader.h"
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+ImageFileReader::ImageFileReader(const QString &filePath)
+#ifndef Q_OS_UNIX
+    : m_file(filePath)
+#endif
+{
+#ifdef Q_OS_UNIX
+    m_fd = ::open(QFile::encodeName(filePath).constData(), O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0) return;
+
+    struct stat st;
+    if (::fstat(m_fd, &st) == 0) m_fileSize = qint64(st.st_size);
+#else
+    if (m_file.open(QIODevice::ReadOnly)) m_fileSize = m_file.size();
+#endif
+}
+
+ImageFileReader::~ImageFileReader()
+{
+#ifdef Q_OS_UNIX
+    if (m_fd >= 0) ::close(m_fd);
+#endif
+}
+
+bool ImageFileReader::isOpen() const
+{
+#ifdef Q_OS_UNIX
+    return m_fd >= 0;
+#else
+    return m_file.isOpen();
+#endif
+}
+
+qint64 ImageFileReader::read(qint64 offset, uchar *data, qint64 length)
+{
+    if (!isOpen() || offset < 0 || length <= 0) return 0;
+
+#ifdef Q_OS_UNIX
+    qint64 total = 0;
+    while (total < length) {
+        ssize_t bytesRead = ::pread(m_fd, data + total, size_t(length - total), off_t(offset + total));
+        if (bytesRead < 0 && errno == EINTR) continue;
+        if (bytesRead <= 0) break;
+        total += bytesRead;
+    }
+    return total;
+#else
+    if (!m_file.seek(offset)) return 0;
+    return qMax<qint64>(0, m_file.read(reinterpret_cast<char *>(data), length));
+#endif
+}
+
+QByteArray ImageFileReader::read(qint64 offset, qint64 length)
+{
+    QByteArray bytes(int(qMax<qint64>(0, length)), Qt::Uninitialized);
+    bytes.resize(int(read(offset, reinterpret_cast<uchar *>(bytes.data()), bytes.size())));
+    return bytes;
+}
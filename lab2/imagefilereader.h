@@ -0,0 +1,38 @@
+#ifndef IMAGEFILEREADER_H
+#define IMAGEFILEREADER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QtGlobal>
+
+// Файл изображения, читаемый ограниченными диапазонами (pread). Разборщики
+// форматов читают окно в начале файла и дочитывают только нужные участки.
+// Если файл укорачивают во время анализа (например, перезаписывают в папке
+// под наблюдением), чтение просто вернет меньше байт, тогда как обращение
+// за новый конец отображенного в память файла завершило бы процесс по SIGBUS.
+class ImageFileReader
+{
+public:
+    explicit ImageFileReader(const QString &filePath);
+    ~ImageFileReader();
+
+    bool isOpen() const;
+    qint64 fileSize() const { return m_fileSize; }
+
+    // До length байт с позиции offset; у конца файла или при ошибке - меньше
+    qint64 read(qint64 offset, uchar *data, qint64 length);
+    QByteArray read(qint64 offset, qint64 length);
+
+private:
+    Q_DISABLE_COPY(ImageFileReader)
+
+    qint64 m_fileSize = 0;
+#ifdef Q_OS_UNIX
+    int m_fd = -1;
+#else
+    QFile m_file;
+#endif
+};
+
+#endif // IMAGEFILEREADER_H
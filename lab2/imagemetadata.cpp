@@ -0,0 +1,238 @@
+#include "imagemetadata.h"
+#include "pathpool.h"
+#include <QStringList>
+
+QString ImageMetadata::filename() const
+{
+    return PathPool::instance().fileName(pathId);
+}
+
+QString ImageMetadata::filepath() const
+{
+    return PathPool::instance().path(pathId);
+}
+
+QString ImageMetadata::sizeText() const
+{
+    if (hasError()) return QString();
+    QString text = QString("%1 × %2").arg(width).arg(height);
+    if (pageCount() > 1) {
+        text += QString(format == ImageFormat::Gif ? " (%1 кадр.)" : " (%1 стр.)").arg(pageCount());
+    }
+    return text;
+}
+
+QString ImageMetadata::resolutionText() const
+{
+    if (hasError()) return QString();
+    if (dpiX > 0 && dpiY > 0) return QString("%1 × %2").arg(dpiX).arg(dpiY);
+    return "Не указано";
+}
+
+QString ImageMetadata::depthText() const
+{
+    if (hasError()) return QString();
+
+    switch (depth) {
+    case 1: return "1 бит";
+    case 8: return "8 бит";
+    case 24: return "24 бита";
+    case 32: return "32 бита";
+    default: return QString("%1 бит").arg(int(depth));
+    }
+}
+
+QString ImageMetadata::compressionText() const
+{
+    if (hasError()) return QString();
+    return compressionName(compression);
+}
+
+QString ImageMetadata::formatText() const
+{
+    return formatName(format);
+}
+
+QString ImageMetadata::errorText() const
+{
+    switch (error) {
+    case ImageError::LoadFailed: return "Не удается загрузить изображение";
+    case ImageError::Crashed: return "Сбой при разборе файла";
+    case ImageError::NotAnalyzed: return "Файл не разобран: процессы анализа остановились";
+    default: return QString();
+    }
+}
+
+QString ImageMetadata::fileSizeText() const
+{
+    return formatFileSize(bytes);
+}
+
+QString ImageMetadata::formatDetailsText() const
+{
+    if (hasError()) return QString();
+
+    const FormatDetails &d = details;
+    QStringList lines;
+
+    switch (format) {
+    case ImageFormat::Jpeg: {
+        switch (d.colorModel) {
+        case 1: lines << "Цветовое пространство: оттенки серого"; break;
+        case 3: lines << "Цветовое пространство: YCbCr"; break;
+        case 4: lines << "Цветовое пространство: CMYK/YCCK"; break;
+        default: break;
+        }
+        switch (d.sampling) {
+        case 0x11: lines << "Субдискретизация: 4:4:4"; break;
+        case 0x21: lines << "Субдискретизация: 4:2:2"; break;
+        case 0x22: lines << "Субдискретизация: 4:2:0"; break;
+        case 0x12: lines << "Субдискретизация: 4:4:0"; break;
+        case 0x41: lines << "Субдискретизация: 4:1:1"; break;
+        case 0: break;
+        default: lines << QString("Субдискретизация: %1x%2").arg(d.sampling >> 4).arg(d.sampling & 0x0F);
+        }
+        if (d.sampleBits > 0) lines << QString("Бит на канал: %1").arg(d.sampleBits);
+        lines << QString("Прогрессивный: %1").arg(d.flags & FormatDetails::Progressive ? "да" : "нет");
+        break;
+    }
+    case ImageFormat::Png: {
+        static const char *colorTypes[] = {"оттенки серого", "?", "RGB", "палитра", "серый + альфа", "?", "RGBA"};
+        static const int channels[] = {1, 0, 3, 1, 2, 0, 4};
+        if (d.colorModel <= 6 && channels[d.colorModel] > 0) {
+            lines << QString("Тип цвета: %1 (каналов: %2)").arg(colorTypes[d.colorModel]).arg(channels[d.colorModel]);
+        }
+        if (d.sampleBits > 0) lines << QString("Бит на канал: %1").arg(d.sampleBits);
+        lines << QString("Чересстрочный (Adam7): %1").arg(d.flags & FormatDetails::Interlaced ? "да" : "нет");
+        if (d.frames > 1) lines << QString("Кадров (APNG): %1").arg(d.frames);
+
+        QStringList names;
+        for (int bit = 0; bit < FormatDetails::PngChunkCount; ++bit) {
+            if (d.chunks & (1 << bit)) names << FormatDetails::chunkName(bit);
+        }
+        if (!names.isEmpty()) lines << "Чанки: " + names.join(", ");
+        break;
+    }
+    case ImageFormat::Gif:
+        lines << QString("Палитровое изображение (%1 цветов)").arg(paletteColors > 0 ? paletteColors : 256);
+        if (d.frames > 0) lines << QString("Кадров: %1").arg(d.frames);
+        if (d.flags & FormatDetails::Interlaced) lines << "Чересстрочные кадры";
+        if (pageList) {
+            int duration = 0;
+            for (const PageInfo &page : pageList->pages) duration += page.delay;
+            lines << QString("Длительность анимации: %1 с").arg(duration / 100.0, 0, 'f', 2);
+        }
+        break;
+    case ImageFormat::Bmp: {
+        QString bmpType;
+        switch (d.headerSize) {
+        case 12: bmpType = "BITMAPCOREHEADER (OS/2 1.x)"; break;
+        case 40: bmpType = "BITMAPINFOHEADER (Windows 3.x+)"; break;
+        case 108: bmpType = "BITMAPV4HEADER"; break;
+        case 124: bmpType = "BITMAPV5HEADER"; break;
+        default: bmpType = QString("Неизвестный заголовок (%1 байт)").arg(d.headerSize);
+        }
+        lines << QString("Тип BMP: %1 | Смещение данных: %2 байт").arg(bmpType).arg(d.dataOffset);
+        lines << QString("Код сжатия: %1").arg(d.compressionCode);
+        break;
+    }
+    case ImageFormat::Tiff: {
+        lines << QString("Тег Compression: %1 (%2)").arg(d.compressionCode).arg(compressionText());
+        static const char *photometric[] = {"WhiteIsZero", "BlackIsZero", "RGB", "палитра", "маска",
+                                            "CMYK", "YCbCr", "?", "CIELab"};
+        if (d.colorModel <= 8) lines << QString("Фотометрия: %1").arg(photometric[d.colorModel]);
+        if (d.sampleBits > 0) lines << QString("Бит на канал: %1").arg(d.sampleBits);
+        if (d.frames > 1) lines << QString("Страниц: %1").arg(d.frames);
+        break;
+    }
+    default:
+        break;
+    }
+
+    return lines.join("\n");
+}
+
+QString ImageMetadata::pagesText(int maxPages) const
+{
+    if (!pageList) return QString();
+
+    const QVector<PageInfo> &pages = pageList->pages;
+    const bool gif = format == ImageFormat::Gif;
+    QStringList lines;
+    for (int i = 0; i < pages.size() && i < maxPages; ++i) {
+        const PageInfo &page = pages[i];
+        QString line = QString("%1 %2: %3 × %4, %5 бит")
+                           .arg(QString(gif ? "Кадр" : "Стр.")).arg(i + 1)
+                           .arg(page.width).arg(page.height).arg(page.depth);
+        if (gif) line += QString(", %1 с").arg(page.delay / 100.0, 0, 'f', 2);
+        else line += QString(", Compression %1").arg(page.compressionCode);
+        if (page.flags & PageInfo::Reduced) line += ", уменьшенная копия";
+        if (page.flags & PageInfo::Interlaced) line += ", чересстрочный";
+        lines << line;
+    }
+    if (pages.size() > maxPages) lines << QString("... и еще %1").arg(pages.size() - maxPages);
+    return lines.join("\n");
+}
+
+const char *FormatDetails::chunkName(int bit)
+{
+    static const char *names[PngChunkCount] = {"PLTE", "tRNS", "gAMA", "cHRM", "sRGB", "iCCP",
+                                               "tEXt", "tIME", "bKGD", "pHYs", "acTL", "eXIf"};
+    return bit >= 0 && bit < PngChunkCount ? names[bit] : "?";
+}
+
+QString ImageMetadata::formatName(ImageFormat format)
+{
+    switch (format) {
+    case ImageFormat::Jpeg: return "JPG";
+    case ImageFormat::Png: return "PNG";
+    case ImageFormat::Gif: return "GIF";
+    case ImageFormat::Bmp: return "BMP";
+    case ImageFormat::Tiff: return "TIF";
+    case ImageFormat::Pcx: return "PCX";
+    default: return "?";
+    }
+}
+
+QString ImageMetadata::compressionName(Compression compression)
+{
+    switch (compression) {
+    case Compression::None: return "Без сжатия";
+    case Compression::Jpeg: return "JPEG";
+    case Compression::JpegProgressive: return "JPEG (прогрессивный)";
+    case Compression::JpegLossless: return "JPEG (без потерь)";
+    case Compression::Deflate: return "Deflate";
+    case Compression::Lzw: return "LZW";
+    case Compression::Rle: return "RLE";
+    case Compression::Rle4: return "RLE4";
+    case Compression::Rle8: return "RLE8";
+    case Compression::Bitfields: return "Без сжатия (битовые маски)";
+    case Compression::PackBits: return "PackBits";
+    case Compression::CcittRle: return "CCITT RLE";
+    case Compression::CcittGroup3: return "CCITT Group 3";
+    case Compression::CcittGroup4: return "CCITT Group 4";
+    case Compression::Png: return "PNG";
+    case Compression::Other: return "Другое";
+    default: return "Неизвестно";
+    }
+}
+
+ImageFormat ImageMetadata::formatFromSuffix(const QString &suffix)
+{
+    QString ext = suffix.toUpper();
+    if (ext == "JPG" || ext == "JPEG") return ImageFormat::Jpeg;
+    if (ext == "PNG") return ImageFormat::Png;
+    if (ext == "GIF") return ImageFormat::Gif;
+    if (ext == "BMP") return ImageFormat::Bmp;
+    if (ext == "TIF" || ext == "TIFF") return ImageFormat::Tiff;
+    if (ext == "PCX") return ImageFormat::Pcx;
+    return ImageFormat::Unknown;
+}
+
+QString ImageMetadata::formatFileSize(qint64 bytes)
+{
+    if (bytes < 1024) return QString("%1 байт").arg(bytes);
+    else if (bytes < 1024 * 1024) return QString("%1 КБ").arg(bytes / 1024.0, 0, 'f', 1);
+    else if (bytes < 1024 * 1024 * 1024) return QString("%1 МБ").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+    else return QString("%1 ГБ").arg(bytes / (1024.0 * 1024.0 * 1024.0), 0, 'f', 1);
+}
@@ -0,0 +1,170 @@
+#ifndef IMAGEMETADATA_H
+#define IMAGEMETADATA_H
+
+#include <QMetaType>
+#include <QSharedData>
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+enum class ImageFormat : quint8 {
+    Unknown,
+    Jpeg,
+    Png,
+    Gif,
+    Bmp,
+    Tiff,
+    Pcx,
+    Count
+};
+
+enum class Compression : quint8 {
+    Unknown,
+    None,
+    Jpeg,
+    JpegProgressive,
+    JpegLossless,
+    Deflate,
+    Lzw,
+    Rle,
+    Rle4,
+    Rle8,
+    Bitfields,
+    PackBits,
+    CcittRle,
+    CcittGroup3,
+    CcittGroup4,
+    Png,
+    Other
+};
+
+enum class ImageError : quint8 {
+    None,
+    LoadFailed,
+    Crashed,                        // процесс анализа аварийно завершился на этом файле
+    NotAnalyzed                     // процессы анализа остановились, не дойдя до файла
+};
+
+// Подробности формата из заголовка. Разбираются вместе с основными
+// метаданными, поэтому панель деталей показывает их без чтения файла.
+struct FormatDetails {
+    enum Flag : quint8 {
+        Interlaced = 1,             // PNG Adam7, GIF с чересстрочными кадрами
+        Progressive = 2             // JPEG
+    };
+
+    // Вспомогательные чанки PNG, встреченные до IDAT
+    enum PngChunk : quint16 {
+        ChunkPalette = 1 << 0,      // PLTE
+        ChunkTransparency = 1 << 1, // tRNS
+        ChunkGamma = 1 << 2,        // gAMA
+        ChunkChromaticity = 1 << 3, // cHRM
+        ChunkSrgb = 1 << 4,         // sRGB
+        ChunkIccProfile = 1 << 5,   // iCCP
+        ChunkText = 1 << 6,         // tEXt, zTXt, iTXt
+        ChunkTime = 1 << 7,         // tIME
+        ChunkBackground = 1 << 8,   // bKGD
+        ChunkPhysical = 1 << 9,     // pHYs
+        ChunkAnimation = 1 << 10,   // acTL (APNG)
+        ChunkExif = 1 << 11,        // eXIf
+        PngChunkCount = 12
+    };
+
+    quint32 dataOffset = 0;         // BMP: смещение данных пикселей
+    quint32 frames = 0;             // GIF, APNG: кадров; TIFF: страниц (IFD); 0 - не подсчитано
+    quint16 compressionCode = 0;    // код в заголовке: TIFF - тег Compression, BMP - biCompression
+    quint16 headerSize = 0;         // BMP: размер заголовка DIB (его версия)
+    quint16 chunks = 0;             // PNG: PngChunk
+    quint8 colorModel = 0;          // PNG: тип цвета; TIFF: Photometric (0xFF - нет); JPEG: компонент
+    quint8 sampleBits = 0;          // бит на канал
+    quint8 sampling = 0;            // JPEG: дискретизация яркости (H << 4 | V), 0 - не YCbCr 1x1
+    quint8 flags = 0;
+
+    static const char *chunkName(int bit);
+};
+
+// Страница TIFF или кадр GIF: разбирается обходом цепочки IFD
+// или блоков GIF, без декодирования пикселей
+struct PageInfo {
+    enum Flag : quint8 {
+        Reduced = 1,                // TIFF: уменьшенная копия (NewSubfileType)
+        Interlaced = 2              // GIF: чересстрочный кадр
+    };
+
+    quint32 width = 0;
+    quint32 height = 0;
+    quint16 compressionCode = 0;    // TIFF: тег Compression; у GIF всегда LZW, 0
+    quint16 delay = 0;              // GIF: задержка кадра, сотые доли секунды
+    quint8 depth = 0;               // бит на пиксель
+    quint8 flags = 0;
+};
+
+// Список страниц общий для всех копий записи: копирование ImageMetadata
+// остается дешевым, а у одностраничных файлов списка нет совсем
+struct PageList : public QSharedData {
+    QVector<PageInfo> pages;
+};
+
+// Компактная запись о файле: только числа, строки для отображения
+// формируются по запросу (при отрисовке ячейки или выводе деталей)
+struct ImageMetadata {
+    qint64 bytes = 0;
+    quint32 pathId = 0;             // номер пути в PathPool
+    quint32 width = 0;
+    quint32 height = 0;
+    quint32 dpiX = 0;
+    quint32 dpiY = 0;
+    quint32 paletteColors = 0;
+    quint8 depth = 0;               // бит на пиксель
+    ImageFormat format = ImageFormat::Unknown;
+    Compression compression = Compression::Unknown;
+    ImageError error = ImageError::None;
+    FormatDetails details;
+
+    // Содержимое пикселей - только в режиме глубокого анализа
+    enum ContentFlag : quint8 {
+        ContentAnalyzed = 1,
+        Grayscale = 2,              // R == G == B во всех пикселях
+        HasAlpha = 4,               // есть не полностью непрозрачные пиксели
+        PerceptualHashed = 8        // perceptualHash посчитан (поиск дубликатов)
+    };
+    quint32 uniqueColors = 0;
+    quint8 channelMin[3] = {};      // R, G, B
+    quint8 channelMax[3] = {};
+    quint8 channelMean[3] = {};
+    quint8 luminance[16] = {};      // доля пикселей в 16 полосах яркости, 1/255
+    quint8 contentFlags = 0;
+    quint64 perceptualHash = 0;     // dHash 9x8: похожие изображения отличаются в немногих битах
+
+    // Только у многостраничных файлов; размеры и глубина выше - первой страницы
+    QExplicitlySharedDataPointer<PageList> pageList;
+
+    bool hasError() const { return error != ImageError::None; }
+    bool hasContent() const { return contentFlags & ContentAnalyzed; }
+    bool isGrayscale() const { return contentFlags & Grayscale; }
+    bool hasPerceptualHash() const { return contentFlags & PerceptualHashed; }
+    quint64 pixels() const { return quint64(width) * height; }
+    int pageCount() const { return pageList ? pageList->pages.size() : 1; }
+
+    QString filename() const;
+    QString filepath() const;
+
+    QString sizeText() const;
+    QString resolutionText() const;
+    QString depthText() const;
+    QString compressionText() const;
+    QString formatText() const;
+    QString errorText() const;
+    QString fileSizeText() const;
+    QString formatDetailsText() const;  // по строке на свойство
+    QString pagesText(int maxPages) const;  // по строке на страницу, не больше maxPages
+
+    static QString formatName(ImageFormat format);
+    static QString compressionName(Compression compression);
+    static ImageFormat formatFromSuffix(const QString &suffix);
+    static QString formatFileSize(qint64 bytes);
+};
+
+Q_DECLARE_METATYPE(ImageMetadata)
+
+#endif // IMAGEMETADATA_H
@@ -0,0 +1,637 @@
+#include "imageprobe.h"
+#include "imagefilereader.h"
+#include "scancontroller.h"
+#include <QSet>
+#include <QtEndian>
+#include <cstring>
+
+// Байты файла по смещению: из окна в начале файла, за ним - кусками через
+// ImageFileReader. Указатель действителен до следующего обращения за окно.
+class ProbeCursor
+{
+public:
+    // За окном файл дочитывается кусками не меньше этого
+    static constexpr qint64 kReadChunk = 64 * 1024;
+    // Больше за одно обращение не читается: защита от мусорных длин (IFD - до 768 КБ)
+    static constexpr qint64 kMaxRead = 1024 * 1024;
+
+    ProbeCursor(const uchar *head, qint64 headSize, ImageFileReader *file)
+        : m_head(head), m_headSize(headSize), m_file(file) {}
+
+    // Размер файла; без ImageFileReader - только окно
+    qint64 size() const { return m_file ? qMax(m_file->fileSize(), m_headSize) : m_headSize; }
+
+    // length байт с позиции offset; nullptr - диапазон за концом файла
+    const uchar *at(qint64 offset, qint64 length)
+    {
+        if (offset < 0 || length < 0) return nullptr;
+        if (offset + length <= m_headSize) return m_head + offset;
+        if (offset >= m_chunkOffset && offset + length <= m_chunkOffset + m_chunk.size()) {
+            return reinterpret_cast<const uchar *>(m_chunk.constData()) + (offset - m_chunkOffset);
+        }
+        if (!m_file || length > kMaxRead) return nullptr;
+
+        m_chunk = m_file->read(offset, qMax(length, kReadChunk));
+        m_chunkOffset = offset;
+        return m_chunk.size() >= length ? reinterpret_cast<const uchar *>(m_chunk.constData()) : nullptr;
+    }
+
+private:
+    const uchar *m_head;
+    qint64 m_headSize;
+    ImageFileReader *m_file;
+    QByteArray m_chunk;
+    qint64 m_chunkOffset = 0;
+};
+
+namespace {
+
+// Окно в начале файла, где обычно находятся все заголовки
+const qint64 kHeaderWindow = 64 * 1024;
+
+
+// Больше страниц не запоминается: защита от зацикленной или мусорной цепочки
+const int kMaxPages = 65536;
+
+// Каждое обращение за пределы окна заголовка - это чтение с диска,
+// поэтому циклы по сегментам проверяют отмену на каждом шаге
+bool cancelled(const ScanController *controller)
+{
+    return controller && controller->isCancelled();
+}
+
+quint16 readU16(const uchar *p, bool bigEndian)
+{
+    return bigEndian ? qFromBigEndian<quint16>(p) : qFromLittleEndian<quint16>(p);
+}
+
+quint32 readU32(const uchar *p, bool bigEndian)
+{
+    return bigEndian ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p);
+}
+
+int dpiFromDotsPerMeter(qint64 dpm)
+{
+    return dpm > 0 ? qRound(dpm * 0.0254) : 0;
+}
+
+// Теги IFD, нужные для метаданных (TIFF и блок EXIF в JPEG)
+struct TiffIfd {
+    quint32 subfileType = 0;
+    quint32 width = 0;
+    quint32 height = 0;
+    int bitsPerSample = 0;
+    int samplesPerPixel = 0;
+    int compression = 1;
+    int photometric = -1;
+    double xResolution = 0;
+    double yResolution = 0;
+    int resolutionUnit = 2;
+};
+
+int tiffTypeSize(quint16 type)
+{
+    switch (type) {
+    case 1: case 2: case 6: case 7: return 1;   // BYTE, ASCII, SBYTE, UNDEFINED
+    case 3: case 8: return 2;                   // SHORT, SSHORT
+    case 4: case 9: case 11: return 4;          // LONG, SLONG, FLOAT
+    case 5: case 10: case 12: return 8;         // RATIONAL, SRATIONAL, DOUBLE
+    default: return 0;
+    }
+}
+
+// Указатель на значение записи IFD (внутри записи или по смещению)
+const uchar *tiffValue(ProbeCursor &file, bool bigEndian,
+                       const uchar *entry, quint16 type, quint32 count)
+{
+    qint64 bytes = qint64(tiffTypeSize(type)) * count;
+    if (bytes == 0) return nullptr;
+    if (bytes <= 4) return entry + 8;
+
+    return file.at(readU32(entry + 8, bigEndian), bytes);
+}
+
+quint32 tiffScalar(const uchar *p, quint16 type, bool bigEndian)
+{
+    switch (type) {
+    case 1: case 6: case 7: return p[0];
+    case 3: case 8: return readU16(p, bigEndian);
+    case 4: case 9: return readU32(p, bigEndian);
+    default: return 0;
+    }
+}
+
+double tiffRational(const uchar *p, bool bigEndian)
+{
+    quint32 numerator = readU32(p, bigEndian);
+    quint32 denominator = readU32(p + 4, bigEndian);
+    return denominator ? double(numerator) / denominator : 0.0;
+}
+
+// Смещения отсчитываются от заголовка TIFF ("II*\0" / "MM\0*") в начале file
+ImageProbe::Status parseTiffHeader(ProbeCursor &file, bool &bigEndian, quint32 &ifdOffset)
+{
+    const uchar *header = file.at(0, 8);
+    if (!header) return ImageProbe::Status::NeedMore;
+
+    if (header[0] == 'I' && header[1] == 'I') bigEndian = false;
+    else if (header[0] == 'M' && header[1] == 'M') bigEndian = true;
+    else return ImageProbe::Status::Failed;
+
+    if (readU16(header + 2, bigEndian) != 42) return ImageProbe::Status::Failed;
+
+    ifdOffset = readU32(header + 4, bigEndian);
+    return ImageProbe::Status::Ok;
+}
+
+// IFD по смещению ifdOffset; nextOffset - следующий IFD цепочки, 0 - этот последний
+ImageProbe::Status parseTiffIfd(ProbeCursor &file, bool bigEndian, quint32 ifdOffset,
+                                TiffIfd &ifd, quint32 &nextOffset)
+{
+    const uchar *countBytes = file.at(ifdOffset, 2);
+    if (!countBytes) return ImageProbe::Status::NeedMore;
+
+    quint16 entryCount = readU16(countBytes, bigEndian);
+    qint64 entriesEnd = qint64(ifdOffset) + 2 + qint64(entryCount) * 12;
+    const uchar *entryBytes = file.at(qint64(ifdOffset) + 2, qint64(entryCount) * 12);
+    if (!entryBytes) return ImageProbe::Status::NeedMore;
+
+    // Записи копируются: значения по смещениям могут дочитываться в тот же буфер
+    const QByteArray entries(reinterpret_cast<const char *>(entryBytes), entryCount * 12);
+
+    for (int i = 0; i < entryCount; ++i) {
+        const uchar *entry = reinterpret_cast<const uchar *>(entries.constData()) + i * 12;
+        quint16 tag = readU16(entry, bigEndian);
+        quint16 type = readU16(entry + 2, bigEndian);
+        quint32 count = readU32(entry + 4, bigEndian);
+
+        // Значения читаются только для нужных тегов: смещения полос, ICC, XMP
+        // и прочие большие блоки пропускаются без чтения
+        switch (tag) {
+        case 254: case 256: case 257: case 258: case 259:
+        case 262: case 277: case 282: case 283: case 296:
+            break;
+        default:
+            continue;
+        }
+        const uchar *value = tiffValue(file, bigEndian, entry, type, count);
+        if (!value) continue;
+
+        switch (tag) {
+        case 254: ifd.subfileType = tiffScalar(value, type, bigEndian); break;
+        case 256: ifd.width = tiffScalar(value, type, bigEndian); break;
+        case 257: ifd.height = tiffScalar(value, type, bigEndian); break;
+        case 258:
+            ifd.bitsPerSample = 0;
+            for (quint32 s = 0; s < count; ++s)
+                ifd.bitsPerSample += tiffScalar(value + s * tiffTypeSize(type), type, bigEndian);
+            if (ifd.samplesPerPixel == 0) ifd.samplesPerPixel = int(count);
+            break;
+        case 259: ifd.compression = tiffScalar(value, type, bigEndian); break;
+        case 262: ifd.photometric = tiffScalar(value, type, bigEndian); break;
+        case 277: ifd.samplesPerPixel = tiffScalar(value, type, bigEndian); break;
+        case 282: if (type == 5) ifd.xResolution = tiffRational(value, bigEndian); break;
+        case 283: if (type == 5) ifd.yResolution = tiffRational(value, bigEndian); break;
+        case 296: ifd.resolutionUnit = tiffScalar(value, type, bigEndian); break;
+        default: break;
+        }
+    }
+
+    // Смещение следующего IFD за записями; в оборванном файле цепочка кончается здесь
+    const uchar *next = file.at(entriesEnd, 4);
+    nextOffset = next ? readU32(next, bigEndian) : 0;
+    return ImageProbe::Status::Ok;
+}
+
+// Блок EXIF целиком в памяти: за его пределы разбор не выходит
+ImageProbe::Status parseTiffIfd0(const uchar *base, qint64 size, TiffIfd &ifd)
+{
+    ProbeCursor exif(base, size, nullptr);
+    bool bigEndian;
+    quint32 ifdOffset;
+    ImageProbe::Status status = parseTiffHeader(exif, bigEndian, ifdOffset);
+    if (status != ImageProbe::Status::Ok) return status;
+
+    quint32 nextOffset;
+    return parseTiffIfd(exif, bigEndian, ifdOffset, ifd, nextOffset);
+}
+
+PageInfo tiffPage(const TiffIfd &ifd)
+{
+    PageInfo page;
+    page.width = ifd.width;
+    page.height = ifd.height;
+    page.compressionCode = quint16(ifd.compression);
+    page.depth = quint8(ifd.bitsPerSample > 0 ? ifd.bitsPerSample : 1);
+    if (ifd.subfileType & 1) page.flags |= PageInfo::Reduced;
+    return page;
+}
+
+// Перевод разрешения TIFF/EXIF в DPI с учетом единиц (2 - дюйм, 3 - сантиметр)
+int tiffDpi(double resolution, int unit)
+{
+    if (resolution <= 0) return 0;
+    if (unit == 3) return qRound(resolution * 2.54);
+    if (unit == 2) return qRound(resolution);
+    return 0;
+}
+
+Compression tiffCompression(int compression)
+{
+    switch (compression) {
+    case 1: return Compression::None;
+    case 2: return Compression::CcittRle;
+    case 3: return Compression::CcittGroup3;
+    case 4: return Compression::CcittGroup4;
+    case 5: return Compression::Lzw;
+    case 6: case 7: return Compression::Jpeg;
+    case 8: case 32946: return Compression::Deflate;
+    case 32773: return Compression::PackBits;
+    default: return Compression::Other;
+    }
+}
+
+// Отметка вспомогательного чанка PNG по его типу
+quint16 pngChunkBit(const uchar *type)
+{
+    if (std::memcmp(type, "zTXt", 4) == 0 || std::memcmp(type, "iTXt", 4) == 0) return FormatDetails::ChunkText;
+    for (int bit = 0; bit < FormatDetails::PngChunkCount; ++bit) {
+        if (std::memcmp(type, FormatDetails::chunkName(bit), 4) == 0) return quint16(1 << bit);
+    }
+    return 0;
+}
+
+} // namespace
+
+bool ImageProbe::probe(const QString &filePath, ProbeInfo &info,
+                       const ScanController *controller)
+{
+    if (cancelled(controller)) return false;
+
+    ImageFileReader file(filePath);
+    if (!file.isOpen()) return false;
+
+    // Заголовки лежат в начале: окно читается одним обращением.
+    // Остальное (например, IFD в конце TIFF) дочитывается по необходимости.
+    const QByteArray head = file.read(0, kHeaderWindow);
+    return probeData(reinterpret_cast<const uchar *>(head.constData()), head.size(), info, controller, &file) == Status::Ok;
+}
+
+ImageProbe::Status ImageProbe::probeData(const uchar *data, qint64 size, ProbeInfo &info,
+                                         const ScanController *controller, ImageFileReader *reader)
+{
+    if (size < 4) return Status::Failed;
+    ProbeCursor file(data, size, reader);
+
+    // Формат определяется по сигнатуре, а не по расширению
+    if (data[0] == 0xFF && data[1] == 0xD8) {
+        info.format = ImageFormat::Jpeg;
+        return probeJpeg(file, info, controller);
+    }
+    if (size >= 8 && std::memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0) {
+        info.format = ImageFormat::Png;
+        return probePng(file, info, controller);
+    }
+    if (std::memcmp(data, "GIF8", 4) == 0) {
+        info.format = ImageFormat::Gif;
+        return probeGif(file, info, controller);
+    }
+    if (data[0] == 'B' && data[1] == 'M') {
+        info.format = ImageFormat::Bmp;
+        return probeBmp(file, info);
+    }
+    if ((data[0] == 'I' && data[1] == 'I') || (data[0] == 'M' && data[1] == 'M')) {
+        info.format = ImageFormat::Tiff;
+        return probeTiff(file, info, controller);
+    }
+    if (data[0] == 0x0A && data[2] == 1) {
+        info.format = ImageFormat::Pcx;
+        return probePcx(file, info);
+    }
+
+    return Status::Failed;
+}
+
+ImageProbe::Status ImageProbe::probeJpeg(ProbeCursor &file, ProbeInfo &info,
+                                         const ScanController *controller)
+{
+    int jfifDpiX = 0, jfifDpiY = 0;
+    int exifDpiX = 0, exifDpiY = 0;
+    qint64 pos = 2;
+
+    while (const uchar *segment = file.at(pos, 4)) {
+        if (cancelled(controller)) return Status::Cancelled;
+        if (segment[0] != 0xFF) return Status::Failed;
+
+        uchar marker = segment[1];
+        if (marker == 0xFF) { pos++; continue; }     // байты-заполнители
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) { pos += 2; continue; }
+        if (marker == 0xD9 || marker == 0xDA) return Status::Failed; // данные без SOF
+
+        quint16 length = qFromBigEndian<quint16>(segment + 2);
+        if (length < 2) return Status::Failed;
+
+        qint64 payloadSize = length - 2;
+        if (pos + 4 + payloadSize > file.size()) return Status::NeedMore;
+
+        // Остальные сегменты (миниатюры, ICC, XMP) пропускаются без чтения
+        const bool sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (marker != 0xE0 && marker != 0xE1 && !sof) {
+            pos += 2 + length;
+            continue;
+        }
+        const uchar *payload = file.at(pos + 4, payloadSize);
+        if (!payload) return Status::NeedMore;
+
+        // APP0 JFIF: единицы плотности и плотность по осям
+        if (marker == 0xE0 && payloadSize >= 12 && std::memcmp(payload, "JFIF\0", 5) == 0) {
+            uchar units = payload[7];
+            int densityX = qFromBigEndian<quint16>(payload + 8);
+            int densityY = qFromBigEndian<quint16>(payload + 10);
+            if (units == 1) { jfifDpiX = densityX; jfifDpiY = densityY; }
+            else if (units == 2) { jfifDpiX = qRound(densityX * 2.54); jfifDpiY = qRound(densityY * 2.54); }
+        }
+
+        // APP1 EXIF: внутри обычная структура TIFF
+        if (marker == 0xE1 && payloadSize > 14 && std::memcmp(payload, "Exif\0\0", 6) == 0) {
+            TiffIfd ifd;
+            if (parseTiffIfd0(payload + 6, payloadSize - 6, ifd) == Status::Ok) {
+                exifDpiX = tiffDpi(ifd.xResolution, ifd.resolutionUnit);
+                exifDpiY = tiffDpi(ifd.yResolution, ifd.resolutionUnit);
+            }
+        }
+
+        // SOFn (кроме DHT, JPG и DAC, которые делят тот же диапазон)
+        if (sof) {
+            if (payloadSize < 6) return Status::Failed;
+
+            int precision = payload[0];
+            int components = payload[5];
+            info.height = qFromBigEndian<quint16>(payload + 1);
+            info.width = qFromBigEndian<quint16>(payload + 3);
+            info.depth = precision * components;
+            info.details.colorModel = quint8(components);
+            info.details.sampleBits = quint8(precision);
+
+            // Компоненты: идентификатор, H << 4 | V, таблица квантования.
+            // Субдискретизация определена, когда оба цветовых канала 1x1.
+            if (components == 3 && payloadSize >= 15 && payload[10] == 0x11 && payload[13] == 0x11) {
+                info.details.sampling = payload[7];
+            }
+
+            if (marker == 0xC2 || marker == 0xC6 || marker == 0xCA) {
+                info.compression = Compression::JpegProgressive;
+                info.details.flags |= FormatDetails::Progressive;
+            } else if (marker == 0xC3 || marker == 0xC7 || marker == 0xCB) info.compression = Compression::JpegLossless;
+            else info.compression = Compression::Jpeg;
+
+            info.dpiX = jfifDpiX > 0 ? jfifDpiX : exifDpiX;
+            info.dpiY = jfifDpiY > 0 ? jfifDpiY : exifDpiY;
+            return info.width > 0 && info.height > 0 ? Status::Ok : Status::Failed;
+        }
+
+        pos += 2 + length;
+    }
+
+    return Status::NeedMore;
+}
+
+ImageProbe::Status ImageProbe::probePng(ProbeCursor &file, ProbeInfo &info,
+                                        const ScanController *controller)
+{
+    const uchar *data = file.at(0, 33);
+    if (!data) return Status::NeedMore;
+    if (std::memcmp(data + 12, "IHDR", 4) != 0) return Status::Failed;
+
+    info.width = qFromBigEndian<quint32>(data + 16);
+    info.height = qFromBigEndian<quint32>(data + 20);
+
+    int bitDepth = data[24];
+    int colorType = data[25];
+    int channels;
+    switch (colorType) {
+    case 0: channels = 1; break;    // оттенки серого
+    case 2: channels = 3; break;    // RGB
+    case 3: channels = 1; break;    // палитра
+    case 4: channels = 2; break;    // серый + альфа
+    case 6: channels = 4; break;    // RGBA
+    default: return Status::Failed;
+    }
+    info.depth = bitDepth * channels;
+    info.compression = Compression::Deflate;
+    info.details.colorModel = quint8(colorType);
+    info.details.sampleBits = quint8(bitDepth);
+    if (data[28] == 1) info.details.flags |= FormatDetails::Interlaced;
+
+    // pHYs, PLTE и большинство вспомогательных чанков идут до IDAT, дальше читать незачем
+    qint64 pos = 8;
+    while (const uchar *header = file.at(pos, 8)) {
+        if (cancelled(controller)) return Status::Cancelled;
+        quint32 length = qFromBigEndian<quint32>(header);
+        uchar type[4];
+        std::memcpy(type, header + 4, 4);
+        if (std::memcmp(type, "IDAT", 4) == 0 || std::memcmp(type, "IEND", 4) == 0) break;
+        if (pos + 12 + qint64(length) > file.size()) break;
+
+        // Из данных чанков нужны только несколько байт pHYs и acTL
+        const uchar *chunk = nullptr;
+        if (std::memcmp(type, "pHYs", 4) == 0 && length >= 9 && (chunk = file.at(pos + 8, 9)) && chunk[8] == 1) {
+            info.dpiX = dpiFromDotsPerMeter(qFromBigEndian<quint32>(chunk));
+            info.dpiY = dpiFromDotsPerMeter(qFromBigEndian<quint32>(chunk + 4));
+        } else if (std::memcmp(type, "PLTE", 4) == 0) {
+            info.paletteColors = int(length / 3);
+        } else if (std::memcmp(type, "acTL", 4) == 0 && length >= 8 && (chunk = file.at(pos + 8, 4))) {
+            info.details.frames = qFromBigEndian<quint32>(chunk);
+        }
+        info.details.chunks |= pngChunkBit(type);
+
+        pos += 12 + qint64(length);
+    }
+
+    return info.width > 0 && info.height > 0 ? Status::Ok : Status::Failed;
+}
+
+ImageProbe::Status ImageProbe::probeGif(ProbeCursor &file, ProbeInfo &info,
+                                        const ScanController *controller)
+{
+    const uchar *data = file.at(0, 13);
+    if (!data) return Status::NeedMore;
+    if (data[4] != '7' && data[4] != '9') return Status::Failed;
+
+    // Логический дескриптор экрана
+    info.width = qFromLittleEndian<quint16>(data + 6);
+    info.height = qFromLittleEndian<quint16>(data + 8);
+
+    uchar packed = data[10];
+    int bits = (packed & 0x07) + 1;
+    info.depth = (packed & 0x80) ? bits : ((packed >> 4) & 0x07) + 1;
+    if (packed & 0x80) info.paletteColors = 1 << bits;
+    info.compression = Compression::Lzw;
+    if (info.width <= 0 || info.height <= 0) return Status::Failed;
+
+    // Кадры считаются обходом блоков: данные пропускаются по длинам, без распаковки.
+    // Задержка кадра - в расширении управления графикой перед его дескриптором.
+    // Файл читается подряд кусками ProbeCursor::kReadChunk.
+    quint16 delay = 0;
+    qint64 pos = 13;
+    if (packed & 0x80) pos += 3 * (1 << bits);
+    while (const uchar *block = file.at(pos, 1)) {
+        if (block[0] == 0x21) {
+            const uchar *extension = file.at(pos, 6);
+            if (extension && extension[1] == 0xF9 && extension[2] >= 4) {
+                delay = qFromLittleEndian<quint16>(extension + 4);
+            }
+            pos += 2;                           // метка расширения
+        } else if (block[0] == 0x2C) {
+            const uchar *descriptor = file.at(pos, 10);
+            if (!descriptor) break;
+            if (cancelled(controller)) return Status::Cancelled;
+
+            uchar imagePacked = descriptor[9];
+            if (imagePacked & 0x40) info.details.flags |= FormatDetails::Interlaced;
+            info.details.frames++;
+
+            if (info.pages.size() < kMaxPages) {
+                PageInfo page;
+                page.width = qFromLittleEndian<quint16>(descriptor + 5);
+                page.height = qFromLittleEndian<quint16>(descriptor + 7);
+                page.depth = quint8((imagePacked & 0x80) ? (imagePacked & 0x07) + 1 : info.depth);
+                page.delay = delay;
+                if (imagePacked & 0x40) page.flags |= PageInfo::Interlaced;
+                info.pages.append(page);
+            }
+            delay = 0;
+
+            pos += 10;
+            if (imagePacked & 0x80) pos += 3 * (1 << ((imagePacked & 0x07) + 1));
+            pos += 1;                           // минимальный размер кода LZW
+        } else {
+            break;                              // 0x3B - конец файла, иначе файл поврежден
+        }
+
+        // Подблоки: байт длины и данные, пустой подблок завершает цепочку
+        const uchar *length;
+        while ((length = file.at(pos, 1)) && length[0] != 0) pos += 1 + length[0];
+        pos++;
+    }
+
+    return Status::Ok;
+}
+
+ImageProbe::Status ImageProbe::probeBmp(ProbeCursor &file, ProbeInfo &info)
+{
+    const uchar *data = file.at(0, 26);
+    if (!data) return Status::NeedMore;
+
+    quint32 headerSize = qFromLittleEndian<quint32>(data + 14);
+    info.details.headerSize = quint16(qMin<quint32>(headerSize, 0xFFFF));
+    info.details.dataOffset = qFromLittleEndian<quint32>(data + 10);
+    int compression = 0;
+    quint32 colorsUsed = 0;
+
+    if (headerSize == 12) {
+        // BITMAPCOREHEADER (OS/2 1.x)
+        info.width = qFromLittleEndian<quint16>(data + 18);
+        info.height = qFromLittleEndian<quint16>(data + 20);
+        info.depth = qFromLittleEndian<quint16>(data + 24);
+    } else if (headerSize >= 40) {
+        data = file.at(0, 54);
+        if (!data) return Status::NeedMore;
+        // BITMAPINFOHEADER и его расширения V4/V5
+        info.width = qAbs(qFromLittleEndian<qint32>(data + 18));
+        info.height = qAbs(qFromLittleEndian<qint32>(data + 22));
+        info.depth = qFromLittleEndian<quint16>(data + 28);
+        compression = int(qFromLittleEndian<quint32>(data + 30));
+        info.dpiX = dpiFromDotsPerMeter(qFromLittleEndian<qint32>(data + 38));
+        info.dpiY = dpiFromDotsPerMeter(qFromLittleEndian<qint32>(data + 42));
+        colorsUsed = qFromLittleEndian<quint32>(data + 46);
+    } else {
+        return Status::Failed;
+    }
+
+    info.details.compressionCode = quint16(compression);
+    switch (compression) {
+    case 0: info.compression = Compression::None; break;
+    case 1: info.compression = Compression::Rle8; break;
+    case 2: info.compression = Compression::Rle4; break;
+    case 3: case 6: info.compression = Compression::Bitfields; break;
+    case 4: info.compression = Compression::Jpeg; break;
+    case 5: info.compression = Compression::Png; break;
+    default: info.compression = Compression::Other;
+    }
+
+    if (colorsUsed > 0) info.paletteColors = int(colorsUsed);
+    else if (info.depth > 0 && info.depth <= 8) info.paletteColors = 1 << info.depth;
+
+    return info.width > 0 && info.height > 0 ? Status::Ok : Status::Failed;
+}
+
+ImageProbe::Status ImageProbe::probeTiff(ProbeCursor &file, ProbeInfo &info,
+                                         const ScanController *controller)
+{
+    bool bigEndian;
+    quint32 ifdOffset;
+    Status status = parseTiffHeader(file, bigEndian, ifdOffset);
+    if (status != Status::Ok) return status;
+
+    TiffIfd ifd;
+    quint32 nextOffset = 0;
+    status = parseTiffIfd(file, bigEndian, ifdOffset, ifd, nextOffset);
+    if (status != Status::Ok) return status;
+
+    info.width = int(ifd.width);
+    info.height = int(ifd.height);
+    info.depth = ifd.bitsPerSample > 0 ? ifd.bitsPerSample : 1;     // по умолчанию 1 бит
+    info.dpiX = tiffDpi(ifd.xResolution, ifd.resolutionUnit);
+    info.dpiY = tiffDpi(ifd.yResolution, ifd.resolutionUnit);
+    info.compression = tiffCompression(ifd.compression);
+    info.details.compressionCode = quint16(ifd.compression);
+    info.details.colorModel = ifd.photometric >= 0 && ifd.photometric < 0xFF ? quint8(ifd.photometric) : 0xFF;
+    if (ifd.samplesPerPixel > 0) info.details.sampleBits = quint8(info.depth / ifd.samplesPerPixel);
+    if (ifd.photometric == 3 && info.depth <= 16) info.paletteColors = 1 << info.depth;
+
+    // Остальные страницы: IFD невелики, но могут быть разбросаны по всему файлу,
+    // и каждый - отдельное чтение с диска. Размеры и глубина - первой страницы.
+    info.pages.append(tiffPage(ifd));
+    QSet<quint32> visited;
+    visited.insert(ifdOffset);
+    while (nextOffset != 0 && info.pages.size() < kMaxPages && !visited.contains(nextOffset)) {
+        if (cancelled(controller)) return Status::Cancelled;
+        visited.insert(nextOffset);
+
+        TiffIfd page;
+        quint32 following = 0;
+        if (parseTiffIfd(file, bigEndian, nextOffset, page, following) != Status::Ok) break;
+        info.pages.append(tiffPage(page));
+        nextOffset = following;
+    }
+    info.details.frames = quint32(info.pages.size());
+
+    return info.width > 0 && info.height > 0 ? Status::Ok : Status::Failed;
+}
+
+ImageProbe::Status ImageProbe::probePcx(ProbeCursor &file, ProbeInfo &info)
+{
+    const uchar *data = file.at(0, 128);
+    if (!data) return Status::NeedMore;
+
+    // Фиксированный 128-байтовый заголовок
+    int bitsPerPixel = data[3];
+    int xMin = qFromLittleEndian<quint16>(data + 4);
+    int yMin = qFromLittleEndian<quint16>(data + 6);
+    int xMax = qFromLittleEndian<quint16>(data + 8);
+    int yMax = qFromLittleEndian<quint16>(data + 10);
+    int planes = data[65];
+
+    info.width = xMax - xMin + 1;
+    info.height = yMax - yMin + 1;
+    info.depth = bitsPerPixel * planes;
+    info.dpiX = qFromLittleEndian<quint16>(data + 12);
+    info.dpiY = qFromLittleEndian<quint16>(data + 14);
+    info.compression = Compression::Rle;
+
+    if (info.depth == 8) info.paletteColors = 256;   // палитра VGA в конце файла
+    else if (info.depth <= 4) info.paletteColors = 1 << info.depth;
+
+    return info.width > 0 && info.height > 0 ? Status::Ok : Status::Failed;
+}
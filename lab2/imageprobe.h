@@ -0,0 +1,53 @@
+#ifndef IMAGEPROBE_H
+#define IMAGEPROBE_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+#include "imagemetadata.h"
+
+class ImageFileReader;
+class ProbeCursor;
+class ScanController;
+
+// Сведения, извлеченные из заголовка файла без декодирования пикселей
+struct ProbeInfo {
+    ImageFormat format = ImageFormat::Unknown;
+    int width = 0;
+    int height = 0;
+    int depth = 0;          // бит на пиксель
+    int dpiX = 0;
+    int dpiY = 0;
+    int paletteColors = 0;
+    Compression compression = Compression::Unknown;
+    FormatDetails details;
+    QVector<PageInfo> pages;    // TIFF: по IFD цепочки, GIF: по кадру
+};
+
+class ImageProbe
+{
+public:
+    // Читает окно в начале файла и дочитывает только нужные участки
+    // (IFD страниц TIFF, блоки кадров GIF). false - формат не распознан
+    // или заголовок поврежден, тогда нужно полное декодирование.
+    // При отмене через controller тоже false.
+    static bool probe(const QString &filePath, ProbeInfo &info,
+                      const ScanController *controller = nullptr);
+
+    // Разбор уже прочитанного начала файла; за его пределами данные
+    // дочитываются через reader, без него разбор ограничен data
+    enum class Status { Ok, NeedMore, Failed, Cancelled };
+    static Status probeData(const uchar *data, qint64 size, ProbeInfo &info,
+                            const ScanController *controller = nullptr,
+                            ImageFileReader *reader = nullptr);
+
+private:
+    static Status probeJpeg(ProbeCursor &file, ProbeInfo &info, const ScanController *controller);
+    static Status probePng(ProbeCursor &file, ProbeInfo &info, const ScanController *controller);
+    static Status probeGif(ProbeCursor &file, ProbeInfo &info, const ScanController *controller);
+    static Status probeBmp(ProbeCursor &file, ProbeInfo &info);
+    static Status probeTiff(ProbeCursor &file, ProbeInfo &info, const ScanController *controller);
+    static Status probePcx(ProbeCursor &file, ProbeInfo &info);
+};
+
+#endif // IMAGEPROBE_H
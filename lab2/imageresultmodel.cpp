@@ -0,0 +1,221 @@
+#include "imageresultmodel.h"
+#include "pathpool.h"
+#include "thumbnailcache.h"
+#include <QColor>
+#include <QBrush>
+#include <algorithm>
+#include <functional>
+
+ImageResultModel::ImageResultModel(QObject *parent) : QAbstractTableModel(parent) {}
+
+void ImageResultModel::setThumbnailCache(ThumbnailCache *thumbnails)
+{
+    m_thumbnails = thumbnails;
+    connect(thumbnails, &ThumbnailCache::iconReady, this, &ImageResultModel::thumbnailReady);
+}
+
+void ImageResultModel::thumbnailReady(const QString &filePath)
+{
+    quint32 pathId;
+    if (!PathPool::instance().find(filePath, pathId)) return;
+
+    int row = rowOf(pathId);
+    if (row < 0) return;
+    QModelIndex cell = index(row, ThumbnailColumn);
+    emit dataChanged(cell, cell, {Qt::DecorationRole});
+}
+
+int ImageResultModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_results.size();
+}
+
+int ImageResultModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ImageResultModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_results.size()) return QVariant();
+
+    const ImageMetadata &metadata = m_results.at(index.row());
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case FileColumn: return metadata.filename();
+        case SizeColumn: return metadata.sizeText();
+        case ResolutionColumn: return metadata.resolutionText();
+        case DepthColumn: return metadata.depthText();
+        case CompressionColumn: return metadata.compressionText();
+        case FormatColumn: return metadata.formatText();
+        default: return QVariant();
+        }
+    case SortRole:
+        switch (index.column()) {
+        case FileColumn: return metadata.filename();
+        case SizeColumn: return metadata.pixels();
+        case ResolutionColumn: return metadata.dpiX;
+        case DepthColumn: return int(metadata.depth);
+        case CompressionColumn: return metadata.compressionText();
+        case FormatColumn: return metadata.formatText();
+        default: return QVariant();
+        }
+    case Qt::DecorationRole:
+        if (index.column() == ThumbnailColumn && m_thumbnails && !metadata.hasError()) {
+            QPixmap icon = m_thumbnails->icon(metadata.filepath());
+            if (!icon.isNull()) return icon;
+        }
+        return QVariant();
+    case Qt::ForegroundRole:
+        return QBrush(Qt::black);
+    case Qt::BackgroundRole:
+        if (metadata.hasError()) return QBrush(QColor(255, 200, 200));
+        return QVariant();
+    case Qt::ToolTipRole:
+        if (metadata.hasError()) return metadata.errorText();
+        return QVariant();
+    default:
+        return QVariant();
+    }
+}
+
+QVariant ImageResultModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section) {
+    case ThumbnailColumn: return QString();
+    case FileColumn: return QString("Имя файла");
+    case SizeColumn: return QString("Размер (пиксели)");
+    case ResolutionColumn: return QString("Разрешение (DPI)");
+    case DepthColumn: return QString("Глубина цвета");
+    case CompressionColumn: return QString("Сжатие");
+    case FormatColumn: return QString("Формат");
+    default: return QVariant();
+    }
+}
+
+void ImageResultModel::appendResults(const QVector<ImageMetadata> &batch)
+{
+    if (batch.isEmpty()) return;
+
+    int first = m_results.size();
+    beginInsertRows(QModelIndex(), first, first + batch.size() - 1);
+    m_results.append(batch);
+    for (int i = 0; i < batch.size(); ++i) {
+        setRow(batch.at(i).pathId, first + i);
+    }
+    m_index.append(batch);
+    endInsertRows();
+}
+
+void ImageResultModel::applyChanges(const QVector<ImageMetadata> &changed,
+                                    const QVector<quint32> &removedPathIds)
+{
+    // Удаление снизу вверх: на место строки переносится последняя, поэтому
+    // работа пропорциональна числу изменений, а не размеру таблицы.
+    // Порядок строк модели не важен - его задает сортировка представления.
+    QVector<int> removedRows;
+    for (quint32 pathId : removedPathIds) {
+        int row = rowOf(pathId);
+        if (row >= 0) removedRows.append(row);
+    }
+    std::sort(removedRows.begin(), removedRows.end(), std::greater<int>());
+    removedRows.erase(std::unique(removedRows.begin(), removedRows.end()), removedRows.end());
+
+    for (int row : removedRows) {
+        const int last = m_results.size() - 1;
+        setRow(m_results.at(row).pathId, -1);
+        m_index.remove(row);
+        if (row != last) {
+            m_results[row] = m_results.at(last);
+            setRow(m_results.at(row).pathId, row);
+            emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+        }
+        beginRemoveRows(QModelIndex(), last, last);
+        m_results.removeLast();
+        endRemoveRows();
+    }
+
+    QVector<int> updatedRows;
+    QVector<ImageMetadata> added;
+    for (const ImageMetadata &metadata : changed) {
+        int row = rowOf(metadata.pathId);
+        if (row >= 0) {
+            m_results[row] = metadata;
+            m_index.update(row, metadata);
+            updatedRows.append(row);
+        } else {
+            added.append(metadata);
+        }
+    }
+
+    for (int row : updatedRows) {
+        emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+    }
+    appendResults(added);
+}
+
+void ImageResultModel::setRow(quint32 pathId, int row)
+{
+    if (pathId >= quint32(m_rows.size())) {
+        // Рост с запасом: номера выдаются подряд по мере анализа
+        int oldSize = m_rows.size();
+        m_rows.resize(qMax(int(pathId) + 1, oldSize * 2));
+        std::fill(m_rows.begin() + oldSize, m_rows.end(), -1);
+    }
+    m_rows[int(pathId)] = row;
+}
+
+void ImageResultModel::clear()
+{
+    beginResetModel();
+    m_results.clear();
+    m_results.squeeze();
+    m_rows.clear();
+    m_rows.squeeze();
+    m_index.clear();
+    endResetModel();
+}
+
+ImageFilterProxyModel::ImageFilterProxyModel(QObject *parent) : QSortFilterProxyModel(parent)
+{
+    setSortRole(ImageResultModel::SortRole);
+}
+
+void ImageFilterProxyModel::setSearchResult(const SearchIndex::Result &result)
+{
+    m_query = result.query;
+    m_generation = result.generation;
+    m_accepted = QBitArray(result.rowCount);
+    for (int row : result.rows) {
+        m_accepted.setBit(row);
+    }
+    invalidateFilter();
+}
+
+void ImageFilterProxyModel::clearSearch()
+{
+    m_query = FilterQuery();
+    m_accepted.clear();
+    invalidateFilter();
+}
+
+bool ImageFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_UNUSED(sourceParent)
+    if (m_query.isEmpty()) return true;
+
+    // Строки, добавленные после поиска, и все строки после перестройки
+    // индекса (до прихода нового результата) проверяются по одной
+    const ImageResultModel *model = static_cast<const ImageResultModel *>(sourceModel());
+    const SearchIndex &index = model->searchIndex();
+    if (sourceRow < m_accepted.size() && m_generation == index.generation()) {
+        return m_accepted.testBit(sourceRow);
+    }
+    return index.matches(sourceRow, m_query);
+}
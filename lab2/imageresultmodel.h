@@ -0,0 +1,92 @@
+#ifndef IMAGERESULTMODEL_H
+#define IMAGERESULTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QSortFilterProxyModel>
+#include <QBitArray>
+#include <QVector>
+#include "imageanalyzer.h"
+#include "searchindex.h"
+
+class ThumbnailCache;
+
+// Таблица результатов поверх непрерывного массива записей.
+// Новые результаты дописываются в конец; при наблюдении за папкой
+// записи также заменяются и удаляются.
+class ImageResultModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        ThumbnailColumn,
+        FileColumn,
+        SizeColumn,
+        ResolutionColumn,
+        DepthColumn,
+        CompressionColumn,
+        FormatColumn,
+        ColumnCount
+    };
+
+    // Числовое значение ячейки для сортировки
+    static const int SortRole = Qt::UserRole + 1;
+
+    explicit ImageResultModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // Значки в первом столбце; запрашиваются только для отрисовываемых строк
+    void setThumbnailCache(ThumbnailCache *thumbnails);
+
+    void appendResults(const QVector<ImageMetadata> &batch);
+    void clear();
+
+    // Изменения в папке: записи с известным путем заменяются, новые
+    // дописываются, удаленные убираются (на их место переносятся последние
+    // строки). Индекс поиска меняется по тем же строкам.
+    void applyChanges(const QVector<ImageMetadata> &changed, const QVector<quint32> &removedPathIds);
+
+    // Строка записи с данным путем, -1 - нет такой
+    int rowOf(quint32 pathId) const { return pathId < quint32(m_rows.size()) ? m_rows.at(int(pathId)) : -1; }
+
+    const ImageMetadata &result(int row) const { return m_results.at(row); }
+    const QVector<ImageMetadata> &results() const { return m_results; }
+    const SearchIndex &searchIndex() const { return m_index; }
+
+private:
+    void thumbnailReady(const QString &filePath);
+    void setRow(quint32 pathId, int row);
+
+    QVector<ImageMetadata> m_results;
+    QVector<int> m_rows;            // номер пути -> строка, -1 - нет; номера путей плотные
+    SearchIndex m_index;
+    ThumbnailCache *m_thumbnails = nullptr;
+};
+
+// Сортировка и фильтр по готовому результату поиска: хранит только
+// отметки строк, сам поиск выполняется заранее (в фоновом потоке)
+class ImageFilterProxyModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit ImageFilterProxyModel(QObject *parent = nullptr);
+
+    void setSearchResult(const SearchIndex::Result &result);
+    void clearSearch();
+    QString searchText() const { return m_query.text(); }
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    FilterQuery m_query;
+    QBitArray m_accepted;   // строки, вошедшие в результат поиска
+    quint64 m_generation = 0;
+};
+
+#endif // IMAGERESULTMODEL_H
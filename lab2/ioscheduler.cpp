@@ -0,0 +1,222 @@
+#include "ioscheduler.h"
+#include <QFile>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace {
+
+// Интервал подбора числа потоков и наименьшая выборка за интервал
+const qint64 kAdjustIntervalMs = 500;
+const int kMinSampleFiles = 16;
+
+// Заголовок читается быстрее: очереди к устройству нет, добавлять потоки выгодно
+const qint64 kFastLatencyUs = 1000;
+
+// Изменение скорости меньше этой доли считается шумом
+const double kThroughputTolerance = 0.05;
+
+// Начальное число потоков при подборе: с HDD начинать с большего вредно
+const int kInitialAdaptiveThreads = 4;
+
+struct SortKey {
+    int index = 0;
+    quint64 device = 0;
+    int rank = 2;           // 0 - физическое смещение, 1 - inode, 2 - stat не удался
+    quint64 position = 0;
+};
+
+#ifdef Q_OS_LINUX
+// Физическое смещение первого экстента; false - ФС не поддерживает FIEMAP
+bool physicalOffset(int fd, quint64 &offset)
+{
+    // Заголовок запроса и место под один экстент
+    alignas(struct fiemap) char buffer[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    std::memset(buffer, 0, sizeof(buffer));
+    struct fiemap *map = reinterpret_cast<struct fiemap *>(buffer);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+
+    if (::ioctl(fd, FS_IOC_FIEMAP, map) != 0 || map->fm_mapped_extents == 0) return false;
+    // Данные внутри inode или еще не размещены: смещения нет
+    const struct fiemap_extent &extent = map->fm_extents[0];
+    if (extent.fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE)) return false;
+
+    offset = extent.fe_physical;
+    return true;
+}
+#endif
+
+#ifdef Q_OS_UNIX
+void readSortKey(const QString &path, bool physical, SortKey &key)
+{
+    const QByteArray name = QFile::encodeName(path);
+    struct stat st;
+#ifdef Q_OS_LINUX
+    if (physical) {
+        int fd = ::open(name.constData(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        if (::fstat(fd, &st) == 0) {
+            key.device = quint64(st.st_dev);
+            key.rank = 1;
+            key.position = quint64(st.st_ino);
+            quint64 offset;
+            if (physicalOffset(fd, offset)) {
+                key.rank = 0;
+                key.position = offset;
+            }
+        }
+        ::close(fd);
+        return;
+    }
+#else
+    Q_UNUSED(physical)
+#endif
+    if (::stat(name.constData(), &st) == 0) {
+        key.device = quint64(st.st_dev);
+        key.rank = 1;
+        key.position = quint64(st.st_ino);
+    }
+}
+#endif
+
+} // namespace
+
+IoScheduler::IoScheduler(IoOrder order, int prefetchWindow, qint64 prefetchBytes, int maxThreads, bool adaptive)
+    : m_order(order)
+    , m_prefetchWindow(qMax(0, prefetchWindow))
+    , m_prefetchBytes(qMax<qint64>(0, prefetchBytes))
+    , m_maxThreads(qMax(1, maxThreads))
+    , m_adaptive(adaptive)
+{
+    m_activeThreads = adaptive ? qMin(m_maxThreads, kInitialAdaptiveThreads) : m_maxThreads;
+    m_interval.start();
+}
+
+QVector<int> IoScheduler::order(const QVector<QString> &paths) const
+{
+    QVector<int> result(paths.size());
+    for (int i = 0; i < paths.size(); ++i) result[i] = i;
+    if (m_order == IoOrder::Listing || paths.size() < 2) return result;
+
+#ifdef Q_OS_UNIX
+    QVector<SortKey> keys(paths.size());
+    for (int i = 0; i < paths.size(); ++i) keys[i].index = i;
+
+    // stat и FIEMAP ждут чтения inode с диска: запросы идут из нескольких
+    // потоков, иначе обход стоит на каждом файле пачки, а устройство
+    // получает по одному запросу
+    const bool physical = m_order == IoOrder::Physical;
+    QtConcurrent::blockingMap(keys, [&paths, physical](SortKey &key) {
+        readSortKey(paths.at(key.index), physical, key);
+    });
+
+    // Файлы одного устройства подряд; при равных ключах - порядок обхода
+    std::stable_sort(keys.begin(), keys.end(), [](const SortKey &a, const SortKey &b) {
+        if (a.rank == 2 || b.rank == 2) return a.rank < b.rank;
+        if (a.device != b.device) return a.device < b.device;
+        if (a.rank != b.rank) return a.rank < b.rank;
+        return a.position < b.position;
+    });
+    for (int i = 0; i < keys.size(); ++i) result[i] = keys.at(i).index;
+#endif
+    return result;
+}
+
+void IoScheduler::dispatched(const QString &path)
+{
+    if (m_prefetchWindow == 0) return;
+
+    QMutexLocker locker(&m_aheadMutex);
+    m_ahead.enqueue(path);
+}
+
+void IoScheduler::started()
+{
+    qint64 started = ++m_startedCount;
+    if (m_prefetchWindow == 0) return;
+
+    // Подкачка - вне мьютекса: open на сетевом диске может быть долгим
+    QVector<QString> batch;
+    {
+        QMutexLocker locker(&m_aheadMutex);
+        while (!m_ahead.isEmpty() && m_prefetchedCount < started + m_prefetchWindow) {
+            batch.append(m_ahead.dequeue());
+            m_prefetchedCount++;
+        }
+    }
+    for (const QString &path : batch) {
+        prefetch(path);
+    }
+}
+
+void IoScheduler::prefetch(const QString &path)
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_DARWIN)
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    // Чтение с диска идет в фоне, open и fadvise не ждут его
+    ::posix_fadvise(fd, 0, off_t(m_prefetchBytes), POSIX_FADV_WILLNEED);
+    ::close(fd);
+    m_prefetchedFiles.fetch_add(1, std::memory_order_relaxed);
+#else
+    Q_UNUSED(path)
+#endif
+}
+
+void IoScheduler::recordIo(qint64 ns)
+{
+    m_ioNs.fetch_add(ns, std::memory_order_relaxed);
+    m_ioCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IoScheduler::adjust(int completed)
+{
+    if (m_interval.elapsed() < kAdjustIntervalMs || completed - m_intervalStart < kMinSampleFiles) return;
+
+    const double seconds = m_interval.restart() / 1000.0;
+    const double throughput = (completed - m_intervalStart) / seconds;
+    m_intervalStart = completed;
+
+    const int ioCount = m_ioCount.exchange(0, std::memory_order_relaxed);
+    const qint64 ioNs = m_ioNs.exchange(0, std::memory_order_relaxed);
+    const qint64 latencyUs = ioCount > 0 ? ioNs / ioCount / 1000 : 0;
+    m_lastLatencyUs = latencyUs;
+
+    if (!m_adaptive) return;
+
+    // Быстрое устройство (или файлы в кэше ОС) - все потоки. Иначе подъем
+    // по скорости: лучше - дальше в ту же сторону, хуже - обратно, без
+    // изменений - на поток меньше: на HDD лишние потоки только добавляют
+    // перемещения головок
+    int threads = activeThreads();
+    if (latencyUs < kFastLatencyUs) {
+        threads = m_maxThreads;
+        m_direction = -1;
+    } else if (m_lastThroughput <= 0) {
+        m_direction = 1;
+        threads += m_direction;
+    } else if (throughput > m_lastThroughput * (1 + kThroughputTolerance)) {
+        threads += m_direction;
+    } else if (throughput < m_lastThroughput * (1 - kThroughputTolerance)) {
+        m_direction = -m_direction;
+        threads += m_direction;
+    } else {
+        m_direction = -1;
+        threads--;
+    }
+    m_lastThroughput = throughput;
+    m_activeThreads = qBound(1, threads, m_maxThreads);
+}
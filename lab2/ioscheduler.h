@@ -0,0 +1,78 @@
+#ifndef IOSCHEDULER_H
+#define IOSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+// Порядок чтения найденных файлов
+enum class IoOrder : quint8 {
+    Listing,    // как их выдал обход каталога
+    Inode,      // по устройству и номеру inode: на ext4/XFS близко к порядку на диске
+    Physical    // по физическому смещению начала файла (FIEMAP, Linux), без него - по inode
+};
+
+// Планировщик чтения для сканирования папки: переставляет пачки путей
+// по расположению на диске, заранее подкачивает файлы на окно вперед
+// (posix_fadvise WILLNEED) и подбирает число читающих потоков по
+// измеренной задержке и скорости: на HDD остается мало потоков, на NVMe - много.
+// Порядок выдачи результатов не меняется: его задает номер пути в обходе.
+class IoScheduler
+{
+public:
+    // adaptive - число потоков подбирается в пределах [1, maxThreads],
+    // иначе работают все maxThreads. prefetchBytes 0 - файл целиком.
+    IoScheduler(IoOrder order, int prefetchWindow, qint64 prefetchBytes, int maxThreads, bool adaptive);
+
+    // Порядок чтения пачки: номера в paths. Каждый путь проверяется stat,
+    // при IoOrder::Physical еще и FIEMAP, в общем пуле потоков;
+    // недоступные файлы идут в конец
+    QVector<int> order(const QVector<QString> &paths) const;
+
+    // Путь отправлен в очередь анализа (вызывает обход)
+    void dispatched(const QString &path);
+    // Поток взял путь из очереди: подкачиваются пути на окно вперед
+    void started();
+
+    int activeThreads() const { return m_activeThreads.load(std::memory_order_relaxed); }
+    int maxThreads() const { return m_maxThreads; }
+
+    // Время stat и разбора заголовка одного файла
+    void recordIo(qint64 ns);
+    // Раз в интервал пересчитывает число потоков; completed - всего обработано файлов
+    void adjust(int completed);
+
+    qint64 ioLatencyUs() const { return m_lastLatencyUs.load(std::memory_order_relaxed); }
+    int prefetchedFiles() const { return m_prefetchedFiles.load(std::memory_order_relaxed); }
+
+private:
+    void prefetch(const QString &path);
+
+    const IoOrder m_order;
+    const int m_prefetchWindow;
+    const qint64 m_prefetchBytes;
+    const int m_maxThreads;
+    const bool m_adaptive;
+
+    // Пути, отправленные в очередь, но еще не подкачанные
+    QMutex m_aheadMutex;
+    QQueue<QString> m_ahead;
+    qint64 m_prefetchedCount = 0;   // номер первого пути в m_ahead
+    std::atomic<qint64> m_startedCount{0};
+    std::atomic<int> m_prefetchedFiles{0};
+
+    // Подбор числа потоков: замеры за текущий интервал
+    std::atomic<int> m_activeThreads{1};
+    std::atomic<qint64> m_ioNs{0};
+    std::atomic<int> m_ioCount{0};
+    std::atomic<qint64> m_lastLatencyUs{0};
+    QElapsedTimer m_interval;
+    int m_intervalStart = 0;        // обработано файлов к началу интервала
+    double m_lastThroughput = 0;
+    int m_direction = 1;
+};
+
+#endif // IOSCHEDULER_H
@@ -0,0 +1,83 @@
+#include "latencyhistogram.h"
+#include <QtAlgorithms>
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+int LatencyHistogram::bucketIndex(quint64 value)
+{
+    if (value < quint64(kSubBuckets)) return int(value);
+
+    // Номер старшего бита задает степень двойки, следующие 3 бита - корзину внутри нее
+    int msb = 63 - int(qCountLeadingZeroBits(value));
+    int shift = msb - 3;
+    int sub = int((value >> shift) & (kSubBuckets - 1));
+    return (msb - 2) * kSubBuckets + sub;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < kSubBuckets) return quint64(index);
+
+    int msb = index / kSubBuckets + 2;
+    int sub = index % kSubBuckets;
+    int shift = msb - 3;
+    quint64 lower = quint64(kSubBuckets + sub) << shift;
+    return lower + (quint64(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(qint64 nanoseconds)
+{
+    quint64 value = nanoseconds > 0 ? quint64(nanoseconds) : 0;
+
+    m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(value, std::memory_order_relaxed);
+
+    quint64 current = m_max.load(std::memory_order_relaxed);
+    while (value > current && !m_max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (int i = 0; i < kBuckets; ++i) {
+        quint64 n = other.m_buckets[i].load(std::memory_order_relaxed);
+        if (n) m_buckets[i].fetch_add(n, std::memory_order_relaxed);
+    }
+    m_count.fetch_add(other.count(), std::memory_order_relaxed);
+    m_total.fetch_add(quint64(other.total()), std::memory_order_relaxed);
+
+    quint64 otherMax = quint64(other.max());
+    quint64 current = m_max.load(std::memory_order_relaxed);
+    while (otherMax > current && !m_max.compare_exchange_weak(current, otherMax, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < kBuckets; ++i) {
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_total.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+qint64 LatencyHistogram::percentile(double p) const
+{
+    quint64 total = count();
+    if (total == 0) return 0;
+
+    quint64 rank = quint64(qBound(0.0, p, 100.0) / 100.0 * double(total));
+    if (rank == 0) rank = 1;
+
+    quint64 seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return qint64(qMin(bucketUpperBound(i), quint64(max())));
+    }
+    return max();
+}
@@ -0,0 +1,39 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+#include <atomic>
+
+// Гистограмма задержек с логарифмическими корзинами (8 корзин на
+// каждую степень двойки, погрешность процентилей не больше 12.5%).
+// Запись без блокировок, можно вызывать из любых потоков.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(qint64 nanoseconds);
+    void merge(const LatencyHistogram &other);
+    void reset();
+
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    qint64 total() const { return qint64(m_total.load(std::memory_order_relaxed)); }
+    qint64 max() const { return qint64(m_max.load(std::memory_order_relaxed)); }
+
+    // Верхняя граница корзины, в которую попал p-й процентиль (0..100), нс
+    qint64 percentile(double p) const;
+
+private:
+    static const int kSubBuckets = 8;
+    static const int kBuckets = 64 * kSubBuckets;
+
+    static int bucketIndex(quint64 value);
+    static quint64 bucketUpperBound(int index);
+
+    std::atomic<quint64> m_buckets[kBuckets];
+    std::atomic<quint64> m_count;
+    std::atomic<quint64> m_total;
+    std::atomic<quint64> m_max;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -7,6 +7,24 @@
 #include <QTextStream>
 #include <QtConcurrent>
 #include <QLabel>
+#include <QThread>
+#include <QTreeWidgetItem>
+#include <QStandardPaths>
+#include <algorithm>
+#include "pathpool.h"
+
+namespace {
+
+// Результатов за один проход цикла событий: остальные - следующим проходом
+const int kDrainBatch = 2000;
+
+// Групп дубликатов в дереве: крупнейшие по освобождаемому месту
+const int kMaxDuplicateGroups = 2000;
+
+// Больше строк о страницах панель деталей не показывает
+const int kMaxDetailPages = 200;
+
+} // namespace
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -18,25 +36,59 @@ MainWindow::MainWindow(QWidget *parent)
     loadStyles();
 
     // Настройка таблицы
-    QStringList headers = {
-        "Имя файла",
-        "Размер (пиксели)",
-        "Разрешение (DPI)",
-        "Глубина цвета",
-        "Сжатие",
-        "Формат"
-    };
-    ui->tableWidget->setColumnCount(headers.size());
-    ui->tableWidget->setHorizontalHeaderLabels(headers);
-    ui->tableWidget->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
-    ui->tableWidget->setSortingEnabled(true);
-    ui->tableWidget->setAlternatingRowColors(true);
-    ui->tableWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
-    ui->tableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_model = new ImageResultModel(this);
+    m_proxyModel = new ImageFilterProxyModel(this);
+    m_proxyModel->setSourceModel(m_model);
+
+    ui->tableView->setModel(m_proxyModel);
+    ui->tableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+
+    // Миниатюры: строки по высоте значка, столбец значков фиксированной ширины
+    m_model->setThumbnailCache(&m_thumbnails);
+    ui->tableView->setIconSize(QSize(ThumbnailCache::kIconSide, ThumbnailCache::kIconSide));
+    ui->tableView->verticalHeader()->setDefaultSectionSize(ThumbnailCache::kIconSide + 4);
+    ui->tableView->horizontalHeader()->setSectionResizeMode(ImageResultModel::ThumbnailColumn, QHeaderView::Fixed);
+    ui->tableView->horizontalHeader()->resizeSection(ImageResultModel::ThumbnailColumn, ThumbnailCache::kIconSide + 8);
+    ui->tableView->horizontalHeader()->setSortIndicator(ImageResultModel::FileColumn,
+                                                        ui->tableView->horizontalHeader()->sortIndicatorOrder());
+    connect(&m_thumbnails, &ThumbnailCache::previewReady, this, &MainWindow::previewReady);
+
+    ui->tableView->setSortingEnabled(true);
+    ui->tableView->setAlternatingRowColors(true);
+    ui->tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ui->tableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
 
     ui->stopButton->setObjectName("stopButton");
     ui->statusLabel->setText("Готов к работе");
 
+    m_statisticsTimer.setSingleShot(true);
+    m_statisticsTimer.setInterval(250);
+    connect(&m_statisticsTimer, &QTimer::timeout, this, &MainWindow::updateStatistics);
+
+    // Поиск запускается после паузы в наборе текста и выполняется в фоне
+    m_searchTimer.setSingleShot(true);
+    m_searchTimer.setInterval(150);
+    connect(&m_searchTimer, &QTimer::timeout, this, [this]() { applyFilter(ui->searchText->text()); });
+    connect(&m_searchWatcher, &QFutureWatcher<SearchIndex::Result>::finished,
+            this, &MainWindow::searchFinished);
+
+    connect(&m_folderWatcher, &FolderWatcher::changesDetected, this, &MainWindow::watchChanges);
+    connect(&m_watchAnalysis, &QFutureWatcher<QVector<ImageMetadata>>::finished,
+            this, &MainWindow::watchAnalysisFinished);
+
+    ui->duplicatesTree->header()->setStretchLastSection(false);
+    ui->duplicatesTree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    for (int column = 1; column < ui->duplicatesTree->columnCount(); ++column) {
+        ui->duplicatesTree->header()->setSectionResizeMode(column, QHeaderView::ResizeToContents);
+    }
+    connect(&m_duplicatesWatcher, &QFutureWatcher<DuplicateReport>::finished,
+            this, &MainWindow::duplicatesFound);
+
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    m_resultsFile = QDir(cacheDir).filePath("last-scan.imgres");
+    connect(&m_loadWatcher, &QFutureWatcher<LoadedResults>::finished, this, &MainWindow::resultsLoaded);
+    connect(&m_resultsFileWatcher, &QFutureWatcher<QString>::finished, this, &MainWindow::resultsFileSaved);
+
     // ДОБАВИТЬ ЭТУ СТРОКУ - соединение для завершения анализа
     connect(&m_futureWatcher, &QFutureWatcher<void>::finished,
             this, &MainWindow::analysisFinished);
@@ -44,6 +96,22 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // Анализ должен закончиться раньше, чем исчезнут буфер и кэш;
+    // буфер вычитывается, чтобы потоки не ждали места в нем
+    m_controller.cancel();
+    stopWatching();
+    QVector<ImageMetadata> discarded;
+    while (m_futureWatcher.isRunning()) {
+        discarded.clear();
+        if (m_resultRing.popBatch(discarded, kDrainBatch) == 0) QThread::msleep(1);
+    }
+    delete m_checkpoint;
+
+    m_searchWatcher.waitForFinished();
+    m_duplicatesWatcher.waitForFinished();
+    m_loadWatcher.waitForFinished();
+    m_resultsFileWatcher.waitForFinished();
+    m_cacheSave.waitForFinished();
     delete ui;
 }
 
@@ -80,26 +148,133 @@ void MainWindow::on_analyzeButton_clicked()
         return;
     }
 
-    m_stopRequested = false;
-    m_results.clear();
-    m_filteredResults.clear();
-    ui->tableWidget->setRowCount(0);
+    // Журнал прерванного анализа этой папки: можно продолжить с места остановки
+    bool recursive = ui->recursiveCheckBox->isChecked();
+    const int shardCount = ui->processesSpinBox->value();
+    QString workerProgram;
+    if (shardCount > 1) {
+        workerProgram = ShardCoordinator::defaultWorkerProgram();
+        if (workerProgram.isEmpty()) {
+            QMessageBox::warning(this, "Анализ процессами",
+                                 "Не найдена консольная версия imageanalyzer-cli рядом с программой.\n"
+                                 "Соберите ее или выберите один процесс.");
+            return;
+        }
+    }
+
+    // Анализ процессами не ведет журнал: результаты приходят без общего порядка
+    ScanCheckpoint *checkpoint = shardCount > 1 ? nullptr : new ScanCheckpoint(folder, recursive);
+    bool resume = false;
+    if (checkpoint && checkpoint->exists()) {
+        QMessageBox::StandardButton answer = QMessageBox::question(
+            this, "Прерванный анализ",
+            "Анализ этой папки был прерван. Продолжить с места остановки?\n"
+            "Уже обработанные файлы не будут читаться заново.",
+            QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
+        if (answer == QMessageBox::Cancel) {
+            delete checkpoint;
+            return;
+        }
+        resume = answer == QMessageBox::Yes;
+    }
+
+    // Сохраняемый или выгружаемый файл результатов перезаписывается новым анализом
+    if (m_resultsFileWatcher.isRunning() || m_loadWatcher.isRunning()) {
+        QMessageBox::information(this, "Подождите", "Идет загрузка или сохранение результатов, анализ можно будет начать после них.");
+        delete checkpoint;
+        return;
+    }
+
+    stopWatching();
+    m_scanFolder = folder;
+    m_scanRecursive = recursive;
+
+    m_controller.reset();
+    m_model->clear();
+    m_proxyModel->clearSearch();
+    m_lastSearch = SearchIndex::Result();
+    m_statistics.clear();
+    PathPool::instance().clear();
+
+    // Поиск дубликатов по прошлому анализу, если еще идет, будет отброшен
+    m_scanGeneration++;
+    m_duplicatesPending = false;
+    m_scanHashes = ui->duplicatesCheckBox->isChecked();
+    ui->duplicatesTree->clear();
+    ui->duplicatesLabel->setText(m_scanHashes
+                                     ? "Похожие изображения будут найдены после анализа"
+                                     : "Включите \"Дубликаты\" перед анализом, чтобы найти похожие изображения");
+
     ui->analyzeButton->setEnabled(false);
     ui->stopButton->setEnabled(true);
+    ui->pauseButton->setEnabled(true);
+    ui->pauseButton->setText("Пауза");
     ui->progressBar->setVisible(true);
     ui->progressBar->setValue(0);
     ui->searchText->clear();
 
+    QDir().mkpath(QFileInfo(m_resultsFile).absolutePath());
+    // Без файла результаты сохраняются из памяти по кнопке
+    m_resultsFileCurrent = false;
+    m_resultStore.open(m_resultsFile);
+    ui->openResultsButton->setEnabled(false);
+    ui->saveResultsButton->setEnabled(false);
+    ui->exportButton->setEnabled(false);
+
     m_timer.start();
+    m_scanElapsedMs = -1;
     ui->statusLabel->setText("Анализ изображений запущен...");
 
+    m_cache.resetCounters();
+    m_profiler.reset();
+    ui->saveTraceButton->setEnabled(false);
+
+    // Предыдущий анализатор живет до нового запуска: его метрики видны в статистике
+    delete m_analyzer;
+    delete m_shards;
+    m_shards = nullptr;
+    delete m_checkpoint;
+    m_checkpoint = checkpoint;
+    m_resultRing.reset();
+
     ImageAnalyzer *analyzer = new ImageAnalyzer(this);
+    analyzer->setCache(&m_cache);
+    analyzer->setProfiler(&m_profiler);
+    analyzer->setResultRing(&m_resultRing);
+    analyzer->setCheckpoint(checkpoint);
     connect(analyzer, &ImageAnalyzer::progressUpdated, this, &MainWindow::progressUpdated);
-    connect(analyzer, &ImageAnalyzer::resultReady, this, &MainWindow::resultReady);
-    connect(analyzer, &ImageAnalyzer::finished, analyzer, &ImageAnalyzer::deleteLater);
+    connect(analyzer, &ImageAnalyzer::resultsAvailable, this, &MainWindow::drainResults);
+    m_analyzer = analyzer;
+
+    ScanOptions options;
+    options.threadCount = ui->threadsSpinBox->value();
+    options.recursive = recursive;
+    options.orderedResults = ui->orderedCheckBox->isChecked();
+    options.deepAnalysis = ui->deepCheckBox->isChecked();
+    options.perceptualHash = m_scanHashes;
+
+    // Файлы разбирают процессы консольной версии; анализатор в этом
+    // процессе нужен только для наблюдения за папкой
+    ShardCoordinator *shards = nullptr;
+    if (shardCount > 1) {
+        analyzer->setAnalysisMode(options);
+        shards = new ShardCoordinator(this);
+        shards->setWorkerProgram(workerProgram);
+        shards->setResultRing(&m_resultRing);
+        connect(shards, &ShardCoordinator::progressUpdated, this, &MainWindow::progressUpdated);
+        connect(shards, &ShardCoordinator::resultsAvailable, this, &MainWindow::drainResults);
+        m_shards = shards;
+    }
 
-    QFuture<void> future = QtConcurrent::run([this, analyzer, folder]() {
-        analyzer->analyzeFolder(folder, &m_stopRequested);
+    QFuture<void> future = QtConcurrent::run([this, analyzer, shards, shardCount, checkpoint, resume, folder, options]() {
+        m_cache.load();
+        if (shards) {
+            shards->analyzeFolder(folder, &m_controller, options, shardCount);
+            return;
+        }
+        if (resume) checkpoint->load();
+        checkpoint->begin(resume);
+        analyzer->analyzeFolder(folder, &m_controller, options);
     });
 
     m_futureWatcher.setFuture(future);
@@ -107,216 +282,314 @@ void MainWindow::on_analyzeButton_clicked()
 
 void MainWindow::on_stopButton_clicked()
 {
-    m_stopRequested = true;
+    m_controller.cancel();
     ui->stopButton->setEnabled(false);
+    ui->pauseButton->setEnabled(false);
     ui->statusLabel->setText("Остановка анализа...");
 }
 
+void MainWindow::on_pauseButton_clicked()
+{
+    if (m_controller.isPaused()) {
+        m_controller.resume();
+        ui->pauseButton->setText("Пауза");
+        ui->statusLabel->setText("Анализ продолжается...");
+    } else {
+        m_controller.pause();
+        ui->pauseButton->setText("Продолжить");
+        ui->statusLabel->setText("Пауза");
+    }
+}
+
 void MainWindow::on_searchText_textChanged(const QString &text)
 {
-    applyFilter(text);
+    Q_UNUSED(text)
+    m_searchTimer.start();
 }
 
 void MainWindow::progressUpdated(int value, const QString &status)
 {
     ui->progressBar->setValue(value);
-    ui->statusLabel->setText(status);
+    if (!m_controller.isPaused()) ui->statusLabel->setText(status);
 }
 
 
-void MainWindow::on_tableWidget_cellDoubleClicked(int row, int column)
+void MainWindow::on_tableView_doubleClicked(const QModelIndex &index)
 {
-    Q_UNUSED(column)
-    showDetails(row);
+    showDetails(index);
 }
 
-void MainWindow::updateTable()
+void MainWindow::showDetails(const QModelIndex &index)
 {
-    ui->tableWidget->setSortingEnabled(false);
-    ui->tableWidget->setRowCount(m_filteredResults.size());
+    QModelIndex sourceIndex = m_proxyModel->mapToSource(index);
+    if (!sourceIndex.isValid()) return;
 
-    int row = 0;
-    for (auto it = m_filteredResults.constBegin(); it != m_filteredResults.constEnd(); ++it) {
-        const ImageMetadata &metadata = it.value();
+    const ImageMetadata &metadata = m_model->result(sourceIndex.row());
 
-        QTableWidgetItem *fileItem = new QTableWidgetItem(metadata.filename);
-        QTableWidgetItem *sizeItem = new QTableWidgetItem(metadata.size);
-        QTableWidgetItem *resolutionItem = new QTableWidgetItem(metadata.resolution);
-        QTableWidgetItem *colorItem = new QTableWidgetItem(metadata.colorDepth);
-        QTableWidgetItem *compressionItem = new QTableWidgetItem(metadata.compression);
-        QTableWidgetItem *formatItem = new QTableWidgetItem(metadata.format);
+    QString details = "МЕТАДАННЫЕ ИЗОБРАЖЕНИЯ\n\n";
 
-        for (QTableWidgetItem* item : {fileItem, sizeItem, resolutionItem, colorItem, compressionItem, formatItem}) {
-            item->setForeground(Qt::black);
-            if (!metadata.error.isEmpty()) {
-                item->setBackground(QColor(255, 200, 200));
-                item->setToolTip(metadata.error);
-            }
+    details += "ОСНОВНАЯ ИНФОРМАЦИЯ:\n";
+    details += "Файл: " + metadata.filename() + "\n";
+    details += "Размер: " + metadata.sizeText() + " пикселей\n";
+    details += "Разрешение: " + metadata.resolutionText() + "\n";
+    details += "Глубина цвета: " + metadata.depthText() + "\n";
+    details += "Сжатие: " + metadata.compressionText() + "\n";
+    details += "Формат: " + metadata.formatText() + "\n";
+    details += "Размер файла: " + metadata.fileSizeText() + "\n";
+    if (metadata.paletteColors > 0) {
+        details += QString("Цветов в палитре: %1\n").arg(metadata.paletteColors);
+    }
+    details += "\n";
+
+    if (metadata.hasContent()) {
+        static const char *channelNames[3] = {"R", "G", "B"};
+
+        details += "СОДЕРЖИМОЕ:\n";
+        details += QString("Различных цветов: %1\n").arg(metadata.uniqueColors);
+        details += QString("Оттенки серого: %1\n").arg(metadata.isGrayscale() ? "да" : "нет");
+        if (metadata.contentFlags & ImageMetadata::HasAlpha) details += "Есть прозрачные пиксели\n";
+        for (int c = 0; c < 3; ++c) {
+            details += QString("%1: мин. %2, макс. %3, среднее %4\n")
+                           .arg(channelNames[c])
+                           .arg(metadata.channelMin[c])
+                           .arg(metadata.channelMax[c])
+                           .arg(metadata.channelMean[c]);
         }
 
-        ui->tableWidget->setItem(row, 0, fileItem);
-        ui->tableWidget->setItem(row, 1, sizeItem);
-        ui->tableWidget->setItem(row, 2, resolutionItem);
-        ui->tableWidget->setItem(row, 3, colorItem);
-        ui->tableWidget->setItem(row, 4, compressionItem);
-        ui->tableWidget->setItem(row, 5, formatItem);
-
-        row++;
+        details += "Гистограмма яркости:\n";
+        for (int band = 0; band < 16; ++band) {
+            int share = metadata.luminance[band];
+            details += QString("%1-%2 %3 %4%\n")
+                           .arg(band * 16, 3)
+                           .arg(band * 16 + 15, 3)
+                           .arg(QString(qRound(share * 40 / 255.0), QChar(0x2588)), -40)
+                           .arg(share * 100.0 / 255.0, 0, 'f', 1);
+        }
+        details += "\n";
     }
 
-    ui->tableWidget->setSortingEnabled(true);
-}
-
-void MainWindow::showDetails(int row)
-{
-    if (row < 0 || row >= ui->tableWidget->rowCount()) return;
-
-    QString filename = ui->tableWidget->item(row, 0)->text();
-    if (!m_filteredResults.contains(filename)) return;
-
-    const ImageMetadata &metadata = m_filteredResults[filename];
-
-    QString details = "МЕТАДАННЫЕ ИЗОБРАЖЕНИЯ\n\n";
-
-    details += "ОСНОВНАЯ ИНФОРМАЦИЯ:\n";
-    details += "Файл: " + metadata.filename + "\n";
-    details += "Размер: " + metadata.size + " пикселей\n";
-    details += "Разрешение: " + metadata.resolution + "\n";
-    details += "Глубина цвета: " + metadata.colorDepth + "\n";
-    details += "Сжатие: " + metadata.compression + "\n";
-    details += "Формат: " + metadata.format + "\n\n";
-
-    QString formatInfo = getAdditionalInfo(metadata.format, metadata.filepath);
+    // Подробности разобраны при анализе вместе с заголовком: файл не читается
+    QString formatInfo = metadata.formatDetailsText();
     if (!formatInfo.isEmpty()) {
         details += "ДОПОЛНИТЕЛЬНАЯ ИНФОРМАЦИЯ О ФОРМАТЕ:\n";
         details += formatInfo + "\n\n";
     }
 
-    if (!metadata.error.isEmpty()) {
+    if (metadata.pageList) {
+        details += metadata.format == ImageFormat::Gif ? "КАДРЫ:\n" : "СТРАНИЦЫ:\n";
+        details += metadata.pagesText(kMaxDetailPages) + "\n\n";
+    }
+
+    if (metadata.hasError()) {
         details += "ОШИБКА:\n";
-        details += metadata.error + "\n";
+        details += metadata.errorText() + "\n";
     }
 
     ui->detailsTextEdit->setPlainText(details);
+
+    // Миниатюра читается в фоне, панель обновится по previewReady
+    m_detailsPath = metadata.filepath();
+    ui->previewLabel->setPixmap(QPixmap());
+    if (metadata.hasError()) {
+        ui->previewLabel->setText("Нет миниатюры");
+    } else {
+        ui->previewLabel->setText("Загрузка миниатюры...");
+        m_thumbnails.requestPreview(m_detailsPath);
+    }
 }
 
-void MainWindow::applyFilter(const QString &filter)
+void MainWindow::previewReady(const QString &filePath, const QPixmap &preview)
 {
-    m_filteredResults.clear();
+    if (filePath != m_detailsPath) return;
 
-    if (filter.isEmpty()) {
-        m_filteredResults = m_results;
+    if (preview.isNull()) {
+        ui->previewLabel->setText("Нет миниатюры");
     } else {
-        for (auto it = m_results.constBegin(); it != m_results.constEnd(); ++it) {
-            if (it.key().contains(filter, Qt::CaseInsensitive) ||
-                it.value().format.contains(filter, Qt::CaseInsensitive)) {
-                m_filteredResults[it.key()] = it.value();
-            }
-        }
+        ui->previewLabel->setPixmap(preview);
+    }
+}
+
+void MainWindow::applyFilter(const QString &filter)
+{
+    QString error;
+    FilterQuery query = FilterQuery::parse(filter, &error);
+    if (!query.isValid()) {
+        ui->statusLabel->setText("Ошибка в запросе: " + error);
+        return;
+    }
+
+    if (query.isEmpty()) {
+        m_proxyModel->clearSearch();
+        m_lastSearch = SearchIndex::Result();
+        ui->statusLabel->setText(QString("Найдено: %1 файлов").arg(m_proxyModel->rowCount()));
+        return;
     }
 
-    updateTable();
-    ui->statusLabel->setText(QString("Найдено: %1 файлов").arg(m_filteredResults.size()));
+    // Предыдущий результат позволяет сузить поиск, если запрос дописывается
+    const SearchIndex *index = &m_model->searchIndex();
+    SearchIndex::Result previous = m_lastSearch;
+    m_searchWatcher.setFuture(QtConcurrent::run([index, query, previous]() {
+        return index->search(query, previous);
+    }));
+}
+
+void MainWindow::searchFinished()
+{
+    SearchIndex::Result result = m_searchWatcher.result();
+
+    // Пока шел поиск, запрос изменился или таблица очищена
+    if (result.query.text() != ui->searchText->text() || result.generation != m_model->searchIndex().generation()) return;
+
+    m_proxyModel->setSearchResult(result);
+    m_lastSearch = result;
+    ui->statusLabel->setText(QString("Найдено: %1 файлов").arg(m_proxyModel->rowCount()));
 }
 
 void MainWindow::updateStatistics()
 {
     QString statsText;
 
-    if (m_results.isEmpty()) {
+    // При анализе процессами статистика складывается из их частей
+    if (m_shards && m_futureWatcher.isRunning()) m_statistics = m_shards->statistics();
+
+    // Удалено самое большое изображение или исчерпан запас топа: пересчет по
+    // всем записям - только здесь, перед показом, один раз на серию изменений
+    if (m_statistics.needsRebuild()) {
+        m_statistics.clear();
+        for (const ImageMetadata &metadata : m_model->results()) {
+            m_statistics.add(metadata);
+        }
+    }
+
+    if (m_statistics.fileCount() == 0) {
         statsText = "Статистика будет отображена после анализа";
     } else {
         statsText = "📊 ДЕТАЛЬНАЯ СТАТИСТИКА АНАЛИЗА\n";
         statsText += "═══════════════════════════════════════════\n\n";
 
-        // Основная статистика
-        QMap<QString, int> formatStats;
-        QMap<QString, qint64> formatSizes;
-        qint64 totalSize = 0;
-        QVector<QString> largestFiles;
-        QVector<qint64> largestSizes;
-
-        for (const ImageMetadata &metadata : m_results) {
-            formatStats[metadata.format]++;
-            QFileInfo fileInfo(metadata.filepath);
-            qint64 fileSize = fileInfo.size();
-            totalSize += fileSize;
-            formatSizes[metadata.format] += fileSize;
-
-            // Собираем топ-5 самых больших файлов
-            largestFiles.append(metadata.filename);
-            largestSizes.append(fileSize);
-        }
-
-        // Сортируем по размеру (самые большие первые)
-        for (int i = 0; i < largestSizes.size() - 1; ++i) {
-            for (int j = i + 1; j < largestSizes.size(); ++j) {
-                if (largestSizes[j] > largestSizes[i]) {
-                    std::swap(largestSizes[i], largestSizes[j]);
-                    std::swap(largestFiles[i], largestFiles[j]);
-                }
-            }
-        }
+        int fileCount = m_statistics.fileCount();
+        qint64 totalSize = m_statistics.totalBytes();
 
         statsText += QString("📁 ОБЩАЯ ИНФОРМАЦИЯ:\n");
-        statsText += QString("• Всего файлов: %1\n").arg(m_results.size());
+        statsText += QString("• Всего файлов: %1\n").arg(fileCount);
         statsText += QString("• Общий размер: %1\n").arg(formatFileSize(totalSize));
-        statsText += QString("• Средний размер файла: %1\n\n").arg(formatFileSize(totalSize / m_results.size()));
+        statsText += QString("• Средний размер файла: %1\n").arg(formatFileSize(totalSize / fileCount));
+        if (m_statistics.multiPageFiles() > 0) {
+            statsText += QString("• Многостраничных (TIFF, анимация GIF): %1, страниц и кадров всего: %2\n")
+                             .arg(m_statistics.multiPageFiles())
+                             .arg(m_statistics.totalPages());
+        }
+        statsText += "\n";
 
         // Статистика по форматам с размерами
         statsText += QString("📈 СТАТИСТИКА ПО ФОРМАТАМ:\n");
-        for (auto it = formatStats.constBegin(); it != formatStats.constEnd(); ++it) {
-            double percentage = (it.value() * 100.0) / m_results.size();
-            double sizePercentage = (formatSizes[it.key()] * 100.0) / totalSize;
+        for (int i = 0; i < int(ImageFormat::Count); ++i) {
+            const ScanStatistics::FormatTotals &totals = m_statistics.format(ImageFormat(i));
+            if (totals.files == 0) continue;
+
+            double percentage = (totals.files * 100.0) / fileCount;
+            double sizePercentage = totalSize > 0 ? (totals.bytes * 100.0) / totalSize : 0.0;
             statsText += QString("• %1: %2 файлов (%3%) - %4 (%5%)\n")
-                             .arg(it.key())
-                             .arg(it.value())
+                             .arg(ImageMetadata::formatName(ImageFormat(i)))
+                             .arg(totals.files)
                              .arg(percentage, 0, 'f', 1)
-                             .arg(formatFileSize(formatSizes[it.key()]))
+                             .arg(formatFileSize(totals.bytes))
                              .arg(sizePercentage, 0, 'f', 1);
         }
 
         // Статистика по размерам изображений
-        int smallImages = 0, mediumImages = 0, largeImages = 0, hugeImages = 0;
-        int maxWidth = 0, maxHeight = 0;
-        QString largestImage;
-
-        for (const ImageMetadata &metadata : m_results) {
-            QStringList dimensions = metadata.size.split(" × ");
-            if (dimensions.size() == 2) {
-                int width = dimensions[0].toInt();
-                int height = dimensions[1].toInt();
-                int totalPixels = width * height;
-
-                if (totalPixels < 100000) smallImages++;
-                else if (totalPixels < 1000000) mediumImages++;
-                else if (totalPixels < 10000000) largeImages++;
-                else hugeImages++;
-
-                // Самое большое изображение
-                if (width * height > maxWidth * maxHeight) {
-                    maxWidth = width;
-                    maxHeight = height;
-                    largestImage = metadata.filename;
-                }
+        statsText += QString("\n🖼️  СТАТИСТИКА ПО РАЗМЕРАМ:\n");
+        statsText += QString("• Малые (< 100K пикселей): %1 файлов\n").arg(m_statistics.bucketCount(ScanStatistics::SmallImages));
+        statsText += QString("• Средние (100K-1M пикселей): %1 файлов\n").arg(m_statistics.bucketCount(ScanStatistics::MediumImages));
+        statsText += QString("• Большие (1M-10M пикселей): %1 файлов\n").arg(m_statistics.bucketCount(ScanStatistics::LargeImages));
+        statsText += QString("• Огромные (> 10M пикселей): %1 файлов\n").arg(m_statistics.bucketCount(ScanStatistics::HugeImages));
+        statsText += QString("• Самое большое: %1 (%2 × %3 пикселей)\n")
+                         .arg(PathPool::instance().fileName(m_statistics.largestImage()))
+                         .arg(m_statistics.maxWidth())
+                         .arg(m_statistics.maxHeight());
+
+        statsText += QString("\n📦 САМЫЕ БОЛЬШИЕ ФАЙЛЫ:\n");
+        for (const ScanStatistics::FileEntry &entry : m_statistics.largestFiles()) {
+            statsText += QString("• %1 - %2\n").arg(PathPool::instance().fileName(entry.pathId)).arg(formatFileSize(entry.bytes));
+        }
+
+        MetadataCache::Counters cache = m_cache.counters();
+        statsText += QString("\n💾 КЭШ МЕТАДАННЫХ:\n");
+        statsText += QString("• Попаданий: %1, промахов: %2\n").arg(cache.hits).arg(cache.misses);
+        statsText += QString("• Устаревших записей (файл изменен): %1\n").arg(cache.invalidations);
+        statsText += QString("• Вытеснено: %1, записей в кэше: %2\n").arg(cache.evictions).arg(cache.entries);
+
+        // Время по этапам: где именно тратится время сканирования
+        statsText += QString("\n⏱️  ЭТАПЫ ОБРАБОТКИ:\n");
+        for (int i = 0; i < ScanProfiler::StageCount; ++i) {
+            ScanProfiler::StageTotals stage = m_profiler.stage(ScanProfiler::Stage(i));
+            if (stage.count == 0) continue;
+
+            statsText += QString("• %1: %2 раз, всего %3 мс, p50 %4 мкс, p99 %5 мкс, макс. %6 мкс\n")
+                             .arg(ScanProfiler::stageName(ScanProfiler::Stage(i)))
+                             .arg(stage.count)
+                             .arg(stage.totalNs / 1e6, 0, 'f', 1)
+                             .arg(stage.p50Ns / 1e3, 0, 'f', 1)
+                             .arg(stage.p99Ns / 1e3, 0, 'f', 1)
+                             .arg(stage.maxNs / 1e3, 0, 'f', 1);
+        }
+
+        if (m_shards) {
+            statsText += QString("\n🧩 ПРОЦЕССЫ АНАЛИЗА:\n");
+            statsText += QString("• Процессов: %1, перезапусков: %2, файлов со сбоем разбора: %3\n")
+                             .arg(m_shards->shardCount())
+                             .arg(m_shards->restarts())
+                             .arg(m_shards->crashedFiles());
+            if (!m_shards->errorString().isEmpty()) {
+                statsText += QString("• %1\n").arg(m_shards->errorString());
+            }
+        } else if (m_analyzer) {
+            PipelineMetrics pipeline = m_analyzer->pipelineMetrics();
+            statsText += QString("\n🚰 КОНВЕЙЕР:\n");
+            statsText += QString("• Очередь путей: %1 из %2 (пик %3), обход ждал %4 мс\n")
+                             .arg(pipeline.pathQueueDepth)
+                             .arg(pipeline.pathQueueCapacity)
+                             .arg(pipeline.pathQueuePeak)
+                             .arg(pipeline.walkerBlockedMs);
+            statsText += QString("• Буфер результатов: %1 из %2 (пик %3), анализ ждал интерфейс %4 мс\n")
+                             .arg(pipeline.resultDepth)
+                             .arg(pipeline.resultCapacity)
+                             .arg(pipeline.resultPeak)
+                             .arg(pipeline.deliveryBlockedMs);
+            if (pipeline.pendingPeak > 0) {
+                statsText += QString("• Ожидали выдачи по порядку (пик): %1\n").arg(pipeline.pendingPeak);
             }
+            statsText += QString("• Потоков чтения: %1 из %2%3, задержка stat и заголовка: %4 мкс, подкачано файлов: %5\n")
+                             .arg(pipeline.activeThreads)
+                             .arg(pipeline.maxThreads)
+                             .arg(pipeline.adaptiveThreads ? QString(" (подбор)") : QString())
+                             .arg(pipeline.ioLatencyUs)
+                             .arg(pipeline.prefetchedFiles);
+            statsText += QString("• Реестр путей: %1 путей, %2 в памяти\n")
+                             .arg(PathPool::instance().size())
+                             .arg(formatFileSize(PathPool::instance().memoryUsage()));
         }
 
-        statsText += QString("\n🖼️  СТАТИСТИКА ПО РАЗМЕРАМ:\n");
-        statsText += QString("• Малые (< 100K пикселей): %1 файлов\n").arg(smallImages);
-        statsText += QString("• Средние (100K-1M пикселей): %1 файлов\n").arg(mediumImages);
-        statsText += QString("• Большие (1M-10M пикселей): %1 файлов\n").arg(largeImages);
-        statsText += QString("• Огромные (> 10M пикселей): %1 файлов\n").arg(hugeImages);
-        statsText += QString("• Самое большое: %1 (%2 × %3 пикселей)\n").arg(largestImage).arg(maxWidth).arg(maxHeight);
-
-        // Производительность
-        qint64 elapsed = m_timer.elapsed();
+        statsText += QString("\n🧵 ПОТОКИ:\n");
+        for (const ScanProfiler::ThreadTotals &thread : m_profiler.threads()) {
+            QStringList parts;
+            for (int i = 0; i < ScanProfiler::StageCount; ++i) {
+                if (thread.count[i] == 0) continue;
+                parts << QString("%1 %2 мс")
+                             .arg(ScanProfiler::stageName(ScanProfiler::Stage(i)).toLower())
+                             .arg(thread.totalNs[i] / 1e6, 0, 'f', 1);
+            }
+            statsText += QString("• Поток %1: %2\n").arg(thread.index).arg(parts.join(", "));
+        }
+
+        // Производительность (при наблюдении - по завершенному анализу)
+        qint64 elapsed = m_scanElapsedMs >= 0 ? m_scanElapsedMs : m_timer.elapsed();
         if (elapsed > 0) {
-            double speed = m_results.size() / (elapsed / 1000.0);
+            double speed = m_statistics.fileCount() / (elapsed / 1000.0);
             statsText += QString("\n⚡ ПРОИЗВОДИТЕЛЬНОСТЬ:\n");
             statsText += QString("• Время анализа: %1 сек.\n").arg(elapsed / 1000.0, 0, 'f', 2);
             statsText += QString("• Скорость: %1 файлов/сек.\n").arg(speed, 0, 'f', 2);
-            statsText += QString("• Среднее время на файл: %1 мс\n").arg((double)elapsed / m_results.size(), 0, 'f', 1);
+            statsText += QString("• Среднее время на файл: %1 мс\n").arg((double)elapsed / m_statistics.fileCount(), 0, 'f', 1);
         }
     }
 
@@ -335,100 +608,457 @@ void MainWindow::updateStatistics()
 }
 
 
-void MainWindow::resultReady(const QString &filename, const ImageMetadata &metadata)
+void MainWindow::drainResults()
 {
-    m_results[filename] = metadata;
+    // Флаг сбрасывается до чтения: записи, пришедшие позже, пришлют новый сигнал
+    m_resultRing.clearSignaled();
 
-    if (ui->searchText->text().isEmpty() ||
-        filename.contains(ui->searchText->text(), Qt::CaseInsensitive)) {
-        m_filteredResults[filename] = metadata;
-        updateTable();
+    // Большой буфер разбирается по частям, чтобы окно не замирало
+    if (takeResults(kDrainBatch)) {
+        QMetaObject::invokeMethod(this, &MainWindow::drainResults, Qt::QueuedConnection);
     }
+}
 
-    ui->statusLabel->setText(QString("Обработано: %1 файлов").arg(m_results.size()));
-    updateStatistics();
+bool MainWindow::takeResults(int maxCount)
+{
+    QVector<ImageMetadata> batch;
+    batch.reserve(maxCount);
+    m_resultRing.popBatch(batch, maxCount);
+    if (batch.isEmpty()) return false;
+
+    {
+        ScanProfiler::Scope scope(&m_profiler, ScanProfiler::TableUpdate);
+        m_model->appendResults(batch);
+        // Статистику по записям процессов анализа считает координатор
+        if (!m_shards) {
+            for (const ImageMetadata &metadata : batch) {
+                m_statistics.add(metadata);
+            }
+        }
+    }
+    // Полные блоки сразу уходят в файл, в памяти копится не больше одного блока
+    if (m_resultStore.isOpen() && !m_resultStore.append(batch)) m_resultStore.finish();
+
+    ui->statusLabel->setText(QString("Обработано: %1 файлов").arg(m_model->rowCount()));
+
+    // Вкладка статистики перерисовывается не чаще нескольких раз в секунду
+    if (!m_statisticsTimer.isActive()) m_statisticsTimer.start();
+
+    return m_resultRing.size() > 0;
 }
 
 void MainWindow::analysisFinished()
 {
+    while (takeResults(kDrainBatch)) {
+    }
+
     ui->analyzeButton->setEnabled(true);
     ui->stopButton->setEnabled(false);
+    ui->pauseButton->setEnabled(false);
+    ui->pauseButton->setText("Пауза");
 
     qint64 elapsed = m_timer.elapsed();
-    QString status = QString("Анализ завершен. Файлов: %1. Время: %2 сек.")
-                         .arg(m_results.size())
-                         .arg(elapsed / 1000.0, 0, 'f', 1);
+    m_scanElapsedMs = elapsed;
+    QString status = !m_controller.isCancelled()
+                         ? QString("Анализ завершен. Файлов: %1. Время: %2 сек.")
+                         : m_shards ? QString("Анализ прерван. Файлов: %1. Время: %2 сек.")
+                                    : QString("Анализ прерван. Файлов: %1. Время: %2 сек. Его можно продолжить повторным запуском.");
+    status = status.arg(m_model->rowCount()).arg(elapsed / 1000.0, 0, 'f', 1);
+    if (m_shards) {
+        m_statistics = m_shards->statistics();
+        if (!m_shards->errorString().isEmpty()) status += " " + m_shards->errorString();
+    }
 
     ui->statusLabel->setText(status);
+    m_cacheSave = QtConcurrent::run([this]() { m_cache.save(); });
+    m_statisticsTimer.stop();
     updateStatistics();
+    ui->saveTraceButton->setEnabled(true);
+    m_resultsFileCurrent = m_resultStore.isOpen() && m_resultStore.finish();
+    updateResultsButtons();
+    if (m_scanHashes) findDuplicates();
+
+    if (ui->watchCheckBox->isChecked() && !m_controller.isCancelled()) startWatching();
 }
 
-QString MainWindow::formatFileSize(qint64 bytes)
+void MainWindow::on_watchCheckBox_toggled(bool checked)
 {
-    if (bytes < 1024) return QString("%1 байт").arg(bytes);
-    else if (bytes < 1024 * 1024) return QString("%1 КБ").arg(bytes / 1024.0, 0, 'f', 1);
-    else if (bytes < 1024 * 1024 * 1024) return QString("%1 МБ").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
-    else return QString("%1 ГБ").arg(bytes / (1024.0 * 1024.0 * 1024.0), 0, 'f', 1);
+    // Во время анализа наблюдение включится по его окончании
+    if (m_futureWatcher.isRunning()) return;
+
+    if (checked && !m_controller.isCancelled()) startWatching();
+    else stopWatching();
 }
-QString MainWindow::getAdditionalInfo(const QString &format, const QString &filePath)
+
+void MainWindow::startWatching()
 {
-    QString additional;
+    if (!m_analyzer || m_scanFolder.isEmpty()) return;
+
+    QStringList known;
+    known.reserve(m_model->rowCount());
+    for (const ImageMetadata &metadata : m_model->results()) {
+        known.append(metadata.filepath());
+    }
+    m_folderWatcher.start(m_scanFolder, m_scanRecursive, known);
+    ui->statusLabel->setText("Наблюдение за папкой: " + m_scanFolder);
+}
+
+void MainWindow::stopWatching()
+{
+    m_folderWatcher.stop();
+    m_watchAnalysis.waitForFinished();
+    m_pendingChanged.clear();
+    m_pendingRemoved.clear();
+}
 
-    if (format == "JPG" || format == "JPEG") {
-        additional = "Цветовое пространство: YCbCr";
-    } else if (format == "PNG") {
-        QImage image(filePath);
-        if (!image.isNull()) {
-            additional = QString("Каналов: %1").arg(image.isGrayscale() ? "1" : "3-4");
+void MainWindow::watchChanges(const QStringList &changed, const QStringList &removed)
+{
+    // Последнее событие по пути отменяет предыдущие
+    for (const QString &path : removed) {
+        m_pendingChanged.remove(path);
+        m_pendingRemoved.insert(path);
+    }
+    for (const QString &path : changed) {
+        m_pendingRemoved.remove(path);
+        m_pendingChanged.insert(path);
+    }
+    processWatchChanges();
+}
+
+void MainWindow::processWatchChanges()
+{
+    // Изменения применяются по очереди: следующая партия - после анализа текущей
+    if (m_watchAnalysis.isRunning()) return;
+
+    if (!m_pendingRemoved.isEmpty()) {
+        QVector<quint32> removedIds;
+        for (const QString &path : m_pendingRemoved) {
+            quint32 pathId;
+            if (!PathPool::instance().find(path, pathId)) continue;
+
+            int row = m_model->rowOf(pathId);
+            if (row < 0) continue;
+            m_statistics.remove(m_model->result(row));
+            removedIds.append(pathId);
         }
-    } else if (format == "GIF") {
-        additional = "Палитровое изображение (256 цветов)";
-    } else if (format == "BMP") {
-        // Дополнительная информация для BMP
-        QFile file(filePath);
-        if (file.open(QIODevice::ReadOnly)) {
-            QDataStream stream(&file);
-            stream.setByteOrder(QDataStream::LittleEndian);
-
-            // Читаем сигнатуру "BM"
-            char signature[2];
-            stream.readRawData(signature, 2);
-
-            if (signature[0] == 'B' && signature[1] == 'M') {
-                // Пропускаем размер файла и зарезервированные поля
-                stream.skipRawData(8);
-
-                // Читаем смещение до данных пикселей
-                quint32 dataOffset;
-                stream >> dataOffset;
-
-                // Читаем размер заголовка
-                quint32 headerSize;
-                stream >> headerSize;
-
-                QString bmpType;
-                if (headerSize == 12) {
-                    bmpType = "BITMAPCOREHEADER (OS/2 1.x)";
-                } else if (headerSize == 40) {
-                    bmpType = "BITMAPINFOHEADER (Windows 3.x+)";
-                } else if (headerSize == 108) {
-                    bmpType = "BITMAPV4HEADER";
-                } else if (headerSize == 124) {
-                    bmpType = "BITMAPV5HEADER";
-                } else {
-                    bmpType = QString("Неизвестный заголовок (%1 байт)").arg(headerSize);
-                }
-
-                additional = QString("Тип BMP: %1 | Смещение данных: %2 байт")
-                                 .arg(bmpType).arg(dataOffset);
-            } else {
-                additional = "Неверная сигнатура BMP";
+        m_pendingRemoved.clear();
+
+        // Удаление после еще не учтенного изменения отменяет его
+        if (m_scanHashes && !removedIds.isEmpty()) {
+            QSet<quint32> removedSet;
+            for (quint32 pathId : removedIds) {
+                removedSet.insert(pathId);
             }
-            file.close();
+            auto stale = std::remove_if(m_duplicatesChanged.begin(), m_duplicatesChanged.end(),
+                                        [&removedSet](const ImageMetadata &metadata) {
+                                            return removedSet.contains(metadata.pathId);
+                                        });
+            m_duplicatesChanged.erase(stale, m_duplicatesChanged.end());
+            m_duplicatesRemoved += removedIds;
+        }
+
+        m_model->applyChanges(QVector<ImageMetadata>(), removedIds);
+        watchChangesApplied();
+    }
+
+    if (!m_pendingChanged.isEmpty()) {
+        QStringList paths = m_pendingChanged.values();
+        m_pendingChanged.clear();
+
+        ImageAnalyzer *analyzer = m_analyzer;
+        m_watchAnalysis.setFuture(QtConcurrent::run([analyzer, paths]() {
+            return analyzer->analyzeFiles(paths);
+        }));
+    }
+}
+
+void MainWindow::watchAnalysisFinished()
+{
+    const QVector<ImageMetadata> results = m_watchAnalysis.result();
+    if (!m_folderWatcher.isActive()) return;
+
+    for (const ImageMetadata &metadata : results) {
+        int row = m_model->rowOf(metadata.pathId);
+        if (row >= 0) m_statistics.remove(m_model->result(row));
+        m_statistics.add(metadata);
+    }
+    m_model->applyChanges(results, QVector<quint32>());
+    if (m_scanHashes) m_duplicatesChanged += results;
+    watchChangesApplied();
+
+    processWatchChanges();
+}
+
+void MainWindow::watchChangesApplied()
+{
+    m_resultsFileCurrent = false;
+
+    // У индекса новое поколение: поиск повторяется, до его результата строки проверяются по одной
+    m_lastSearch = SearchIndex::Result();
+    if (!ui->searchText->text().isEmpty()) applyFilter(ui->searchText->text());
+
+    ui->statusLabel->setText(QString("Наблюдение за папкой: %1 файлов").arg(m_model->rowCount()));
+    if (!m_statisticsTimer.isActive()) m_statisticsTimer.start();
+    if (m_scanHashes) updateDuplicates();
+}
+
+void MainWindow::findDuplicates()
+{
+    // Индекс строится заново по всем результатам анализа
+    m_duplicatesRebuild = true;
+    m_duplicatesChanged.clear();
+    m_duplicatesRemoved.clear();
+    updateDuplicates();
+}
+
+void MainWindow::updateDuplicates()
+{
+    // Поиск идет в фоне; изменения, пришедшие за это время, учитываются
+    // следующим проходом. После перестройки в индекс вносятся только
+    // измененные и удаленные файлы.
+    if (m_duplicatesWatcher.isRunning()) {
+        m_duplicatesPending = true;
+        return;
+    }
+
+    m_duplicatesPending = false;
+    m_duplicatesGeneration = m_scanGeneration;
+    ui->duplicatesLabel->setText("Поиск похожих изображений...");
+
+    const bool rebuild = m_duplicatesRebuild;
+    const QVector<ImageMetadata> changed = rebuild ? m_model->results() : m_duplicatesChanged;
+    const QVector<quint32> removed = m_duplicatesRemoved;
+    m_duplicatesRebuild = false;
+    m_duplicatesChanged.clear();
+    m_duplicatesRemoved.clear();
+
+    DuplicateIndex *index = &m_duplicateIndex;
+    m_duplicatesWatcher.setFuture(QtConcurrent::run([index, rebuild, changed, removed]() {
+        QElapsedTimer timer;
+        timer.start();
+        if (rebuild) {
+            index->rebuild(changed);
         } else {
-            additional = "Ошибка чтения файла";
+            for (quint32 pathId : removed) {
+                index->remove(pathId);
+            }
+            for (const ImageMetadata &metadata : changed) {
+                index->insert(metadata);
+            }
         }
+        DuplicateReport report = index->report();
+        report.elapsedMs = timer.elapsed();
+        return report;
+    }));
+}
+
+void MainWindow::duplicatesFound()
+{
+    const DuplicateReport report = m_duplicatesWatcher.result();
+    if (m_duplicatesPending) {
+        updateDuplicates();
+        return;
+    }
+
+    // Пока шел поиск, начат новый анализ: номера путей в отчете уже недействительны
+    if (m_duplicatesGeneration != m_scanGeneration) return;
+
+    showDuplicates(report);
+}
+
+void MainWindow::showDuplicates(const DuplicateReport &report)
+{
+    ui->duplicatesTree->clear();
+
+    QString summary = QString("Групп похожих изображений: %1, лишних файлов: %2, можно освободить: %3\n"
+                              "Файлов с хэшем: %4, допустимое отличие: %5 бит из 64, поиск занял %6 мс")
+                          .arg(report.groups.size())
+                          .arg(report.duplicateFiles)
+                          .arg(formatFileSize(report.reclaimableBytes))
+                          .arg(report.hashedFiles)
+                          .arg(report.maxDistance)
+                          .arg(report.elapsedMs);
+
+    const int shown = qMin(report.groups.size(), kMaxDuplicateGroups);
+    if (shown < report.groups.size()) {
+        summary += QString("\nПоказаны %1 групп с наибольшим освобождаемым объемом").arg(shown);
+    }
+    ui->duplicatesLabel->setText(summary);
+
+    // Первый файл группы - с наибольшим разрешением, его стоит оставить
+    QList<QTreeWidgetItem *> items;
+    items.reserve(shown);
+    for (int i = 0; i < shown; ++i) {
+        const DuplicateGroup &group = report.groups.at(i);
+        QTreeWidgetItem *groupItem = new QTreeWidgetItem();
+        groupItem->setText(0, QString("Группа %1: %2 файлов").arg(i + 1).arg(group.files.size()));
+        groupItem->setText(1, "освободить " + formatFileSize(group.reclaimableBytes));
+
+        for (int j = 0; j < group.files.size(); ++j) {
+            const ImageMetadata &metadata = group.files.at(j);
+            QTreeWidgetItem *fileItem = new QTreeWidgetItem(groupItem);
+            fileItem->setText(0, metadata.filepath());
+            fileItem->setToolTip(0, metadata.filepath());
+            fileItem->setText(1, metadata.fileSizeText());
+            fileItem->setText(2, metadata.sizeText());
+            fileItem->setText(3, j == 0 ? "оставить" : QString::number(group.distances.at(j)));
+        }
+        items.append(groupItem);
+    }
+    ui->duplicatesTree->addTopLevelItems(items);
+}
+
+void MainWindow::on_saveTraceButton_clicked()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Сохранить трассировку", "scan-trace.json",
+                                                "Chrome Trace (*.json)");
+    if (path.isEmpty()) return;
+
+    if (m_profiler.writeChromeTrace(path)) {
+        ui->statusLabel->setText("Трассировка сохранена: " + path);
+    } else {
+        QMessageBox::critical(this, "Ошибка", "Не удалось сохранить трассировку!");
+    }
+}
+
+void MainWindow::updateResultsButtons()
+{
+    // Во время анализа и фоновой работы с файлом результатов кнопки недоступны
+    bool idle = !m_futureWatcher.isRunning() && !m_loadWatcher.isRunning() && !m_resultsFileWatcher.isRunning();
+    ui->openResultsButton->setEnabled(idle);
+    ui->saveResultsButton->setEnabled(idle && m_model->rowCount() > 0);
+    ui->exportButton->setEnabled(idle && m_model->rowCount() > 0);
+}
+
+void MainWindow::on_openResultsButton_clicked()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Открыть результаты", QString(),
+                                                "Результаты анализа (*.imgres);;Все файлы (*)");
+    if (path.isEmpty()) return;
+
+    // Открытые результаты не связаны с папкой: наблюдение и поиск дубликатов выключаются
+    stopWatching();
+    m_scanFolder.clear();
+    m_scanGeneration++;
+    m_duplicatesPending = false;
+    m_scanHashes = false;
+    ui->duplicatesTree->clear();
+    ui->duplicatesLabel->setText("Включите \"Дубликаты\" перед анализом, чтобы найти похожие изображения");
+
+    m_model->clear();
+    m_proxyModel->clearSearch();
+    m_lastSearch = SearchIndex::Result();
+    ui->searchText->clear();
+    m_statistics.clear();
+    PathPool::instance().clear();
+    m_scanElapsedMs = -1;
+    m_resultsFileCurrent = false;
+
+    ui->statusLabel->setText("Загрузка результатов: " + path);
+    m_loadWatcher.setFuture(QtConcurrent::run([path]() {
+        LoadedResults loaded;
+        loaded.filePath = path;
+        QElapsedTimer timer;
+        timer.start();
+        ResultStoreReader::load(path, loaded.results, &loaded.error);
+        loaded.elapsedMs = timer.elapsed();
+        return loaded;
+    }));
+    updateResultsButtons();
+}
+
+void MainWindow::resultsLoaded()
+{
+    const LoadedResults loaded = m_loadWatcher.result();
+    if (!loaded.error.isEmpty()) {
+        ui->statusLabel->setText("Готов к работе");
+        QMessageBox::critical(this, "Ошибка", "Не удалось открыть результаты:\n" + loaded.error);
+        updateResultsButtons();
+        return;
+    }
+
+    m_model->appendResults(loaded.results);
+    for (const ImageMetadata &metadata : loaded.results) {
+        m_statistics.add(metadata);
+    }
+    updateStatistics();
+    updateResultsButtons();
+    ui->statusLabel->setText(QString("Результаты загружены: %1 файлов за %2 мс (%3)")
+                                 .arg(loaded.results.size())
+                                 .arg(loaded.elapsedMs)
+                                 .arg(loaded.filePath));
+}
+
+void MainWindow::on_saveResultsButton_clicked()
+{
+    QString path = QFileDialog::getSaveFileName(this, "Сохранить результаты", "scan.imgres",
+                                                "Результаты анализа (*.imgres)");
+    if (path.isEmpty()) return;
+
+    // Записанный по ходу анализа файл копируется, иначе результаты пишутся из копии таблицы
+    QString source = m_resultsFileCurrent ? m_resultsFile : QString();
+    const QVector<ImageMetadata> results = source.isEmpty() ? m_model->results() : QVector<ImageMetadata>();
+
+    ui->statusLabel->setText("Сохранение результатов...");
+    m_resultsFileWatcher.setFuture(QtConcurrent::run([path, source, results]() {
+        QString error;
+        if (QFile::exists(path) && !QFile::remove(path)) return QString("Не удалось заменить файл: %1").arg(path);
+        if (!source.isEmpty()) {
+            QFile file(source);
+            if (!file.copy(path)) error = file.errorString();
+        } else {
+            ResultStoreWriter::save(path, results, &error);
+        }
+        return error;
+    }));
+    updateResultsButtons();
+}
+
+void MainWindow::on_exportButton_clicked()
+{
+    QString selectedFilter;
+    QString path = QFileDialog::getSaveFileName(this, "Экспорт результатов", "scan.csv",
+                                                "CSV (*.csv);;JSON Lines (*.jsonl)", &selectedFilter);
+    if (path.isEmpty()) return;
+
+    ResultWriter::Format format = selectedFilter.startsWith("JSON") || path.endsWith(".jsonl", Qt::CaseInsensitive)
+                                      ? ResultWriter::JsonLines
+                                      : ResultWriter::Csv;
+
+    // Выгрузка идет из файла по столбцам; устаревший файл сначала переписывается
+    QString store = m_resultsFile;
+    bool current = m_resultsFileCurrent;
+    const QVector<ImageMetadata> results = current ? QVector<ImageMetadata>() : m_model->results();
+
+    ui->statusLabel->setText("Экспорт результатов...");
+    m_resultsFileWatcher.setFuture(QtConcurrent::run([path, format, store, current, results]() {
+        QString error;
+        if (!current && !ResultStoreWriter::save(store, results, &error)) return error;
+
+        ResultStoreReader reader;
+        if (!reader.open(store)) return reader.errorString();
+
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return file.errorString();
+        if (!reader.exportTo(&file, format) || !file.flush()) return file.errorString();
+        return QString();
+    }));
+    updateResultsButtons();
+}
+
+void MainWindow::resultsFileSaved()
+{
+    const QString error = m_resultsFileWatcher.result();
+    updateResultsButtons();
+    if (error.isEmpty()) {
+        ui->statusLabel->setText("Результаты сохранены");
+    } else {
+        ui->statusLabel->setText("Готов к работе");
+        QMessageBox::critical(this, "Ошибка", "Не удалось сохранить результаты:\n" + error);
     }
+}
 
-    return additional;
+QString MainWindow::formatFileSize(qint64 bytes)
+{
+    return ImageMetadata::formatFileSize(bytes);
 }
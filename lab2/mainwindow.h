@@ -4,8 +4,21 @@
 #include <QMainWindow>
 #include <QFutureWatcher>
 #include <QMap>
+#include <QSet>
 #include <QElapsedTimer>
+#include <QTimer>
 #include "imageanalyzer.h"
+#include "imageresultmodel.h"
+#include "scanstatistics.h"
+#include "metadatacache.h"
+#include "scanprofiler.h"
+#include "scancontroller.h"
+#include "scancheckpoint.h"
+#include "folderwatcher.h"
+#include "duplicatefinder.h"
+#include "thumbnailcache.h"
+#include "resultstore.h"
+#include "shardcoordinator.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -25,27 +38,98 @@ private slots:
     void on_browseButton_clicked();
     void on_analyzeButton_clicked();
     void on_stopButton_clicked();
+    void on_pauseButton_clicked();
     void on_searchText_textChanged(const QString &text);
     void analysisFinished();
     void progressUpdated(int value, const QString &status);
-    void resultReady(const QString &filename, const ImageMetadata &metadata);
-    void on_tableWidget_cellDoubleClicked(int row, int column);
+    void drainResults();
+    void on_tableView_doubleClicked(const QModelIndex &index);
+    void on_saveTraceButton_clicked();
+    void on_watchCheckBox_toggled(bool checked);
+    void searchFinished();
+    void watchChanges(const QStringList &changed, const QStringList &removed);
+    void watchAnalysisFinished();
+    void duplicatesFound();
+    void previewReady(const QString &filePath, const QPixmap &preview);
+    void on_openResultsButton_clicked();
+    void on_saveResultsButton_clicked();
+    void on_exportButton_clicked();
+    void resultsLoaded();
+    void resultsFileSaved();
 
 private:
+    struct LoadedResults {
+        QVector<ImageMetadata> results;
+        QString filePath;
+        QString error;
+        qint64 elapsedMs = 0;
+    };
+
     Ui::MainWindow *ui;
     QFutureWatcher<void> m_futureWatcher;
-    QMap<QString, ImageMetadata> m_results;
-    QMap<QString, ImageMetadata> m_filteredResults;
-    bool m_stopRequested = false;
+    ImageResultModel *m_model = nullptr;
+    ImageFilterProxyModel *m_proxyModel = nullptr;
+    ScanController m_controller;
+    ImageAnalyzer *m_analyzer = nullptr;
+    ShardCoordinator *m_shards = nullptr;     // анализ процессами, иначе nullptr
+    ScanCheckpoint *m_checkpoint = nullptr;
+    ResultRing m_resultRing{8192};
     QElapsedTimer m_timer;
+    qint64 m_scanElapsedMs = -1;    // длительность завершенного анализа
+    ScanStatistics m_statistics;
+    QTimer m_statisticsTimer;
+    MetadataCache m_cache;
+    QFuture<void> m_cacheSave;      // кэш сохраняется в фоне после анализа
+    ThumbnailCache m_thumbnails;
+    QString m_detailsPath;          // файл в панели деталей
+    ScanProfiler m_profiler;
+    QTimer m_searchTimer;
+    QFutureWatcher<SearchIndex::Result> m_searchWatcher;
+    SearchIndex::Result m_lastSearch;
+
+    // Наблюдение за папкой последнего анализа
+    QString m_scanFolder;
+    bool m_scanRecursive = false;
+    FolderWatcher m_folderWatcher;
+    QFutureWatcher<QVector<ImageMetadata>> m_watchAnalysis;
+    QSet<QString> m_pendingChanged;
+    QSet<QString> m_pendingRemoved;
+
+    // Поиск дубликатов по хэшам последнего анализа
+    bool m_scanHashes = false;
+    int m_scanGeneration = 0;
+    int m_duplicatesGeneration = 0;
+    bool m_duplicatesPending = false;
+    QFutureWatcher<DuplicateReport> m_duplicatesWatcher;
+    // Индекс меняется только в фоновой задаче поиска; изменения папки
+    // копятся до следующей задачи
+    DuplicateIndex m_duplicateIndex;
+    bool m_duplicatesRebuild = false;
+    QVector<ImageMetadata> m_duplicatesChanged;
+    QVector<quint32> m_duplicatesRemoved;
+
+    // Результаты последнего анализа дописываются в файл по ходу анализа;
+    // после изменений в режиме наблюдения файл устаревает
+    ResultStoreWriter m_resultStore;
+    QString m_resultsFile;
+    bool m_resultsFileCurrent = false;
+    QFutureWatcher<LoadedResults> m_loadWatcher;
+    QFutureWatcher<QString> m_resultsFileWatcher;     // сохранение и экспорт, пустая строка - успех
 
-    void updateTable();
-    void showDetails(int row);
+    void showDetails(const QModelIndex &index);
     void applyFilter(const QString &filter);
     void loadStyles();
     void updateStatistics();
+    bool takeResults(int maxCount);
+    void startWatching();
+    void stopWatching();
+    void processWatchChanges();
+    void watchChangesApplied();
+    void findDuplicates();
+    void updateDuplicates();
+    void showDuplicates(const DuplicateReport &report);
+    void updateResultsButtons();
     QString formatFileSize(qint64 bytes);
-    QString getAdditionalInfo(const QString &format, const QString &filePath);
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,299 @@
+#include "metadatacache.h"
+#include "metadatarecord.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QVector>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// Формат файла: заголовок, массив записей фиксированной длины,
+// затем пути в UTF-8 и списки страниц подряд. Все числа little-endian.
+const char kMagic[8] = {'I', 'M', 'G', 'C', 'A', 'C', 'H', 'E'};
+const quint32 kVersion = 4;
+const int kHeaderSize = 24;
+const int kEntrySize = 96;
+
+struct HeaderLayout {
+    enum { Magic = 0, Version = 8, EntryCount = 12, HeapSize = 16 };
+};
+
+struct EntryLayout {
+    enum {
+        PathOffset = 0, PathLength = 4,
+        Size = 8, Modified = 16, Inode = 24, LastUsed = 32,
+        Width = 40, Height = 44, DpiX = 48, DpiY = 52, PaletteColors = 56,
+        Depth = 60, Format = 61, Compression = 62, Error = 63,
+        PerceptualHash = 64, Flags = 72,
+        ColorModel = 73, SampleBits = 74, Sampling = 75, DetailFlags = 76,
+        CompressionCode = 78, DataOffset = 80, Frames = 84, HeaderSize = 88, Chunks = 90,
+        PagesOffset = 92
+    };
+};
+
+// PagesOffset одностраничного файла: списка страниц нет
+const quint32 kNoPages = 0xFFFFFFFF;
+
+template <typename T>
+void put(QByteArray &buffer, int offset, T value)
+{
+    qToLittleEndian<T>(value, buffer.data() + offset);
+}
+
+template <typename T>
+T get(const uchar *data, int offset)
+{
+    return qFromLittleEndian<T>(data + offset);
+}
+
+} // namespace
+
+MetadataCache::MetadataCache(const QString &filePath) : m_filePath(filePath) {}
+
+QString MetadataCache::defaultPath()
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return QDir(dir).filePath("metadata.cache");
+}
+
+MetadataCache::FileKey MetadataCache::fileKey(const QFileInfo &fileInfo)
+{
+    FileKey key;
+    key.size = fileInfo.size();
+    key.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(fileInfo.filePath()).constData(), &st) == 0) {
+        key.inode = quint64(st.st_ino);
+    }
+#endif
+
+    return key;
+}
+
+bool MetadataCache::load()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_loaded) return true;
+    m_loaded = true;
+
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    qint64 fileSize = file.size();
+    if (fileSize < kHeaderSize) return false;
+
+    const uchar *data = file.map(0, fileSize);
+    if (!data) return false;
+
+    bool valid = std::memcmp(data, kMagic, sizeof(kMagic)) == 0 &&
+                 get<quint32>(data, HeaderLayout::Version) == kVersion;
+    quint32 entryCount = valid ? get<quint32>(data, HeaderLayout::EntryCount) : 0;
+    quint64 heapSize = valid ? get<quint64>(data, HeaderLayout::HeapSize) : 0;
+    qint64 heapStart = kHeaderSize + qint64(entryCount) * kEntrySize;
+    valid = valid && heapStart + qint64(heapSize) <= fileSize;
+
+    if (valid) {
+        const uchar *heap = data + heapStart;
+        m_entries.reserve(int(entryCount));
+
+        for (quint32 i = 0; i < entryCount; ++i) {
+            const uchar *record = data + kHeaderSize + qint64(i) * kEntrySize;
+            quint32 pathOffset = get<quint32>(record, EntryLayout::PathOffset);
+            quint32 pathLength = get<quint32>(record, EntryLayout::PathLength);
+            if (quint64(pathOffset) + pathLength > heapSize) continue;
+
+            Entry entry;
+            entry.key.size = get<qint64>(record, EntryLayout::Size);
+            entry.key.modified = get<qint64>(record, EntryLayout::Modified);
+            entry.key.inode = get<quint64>(record, EntryLayout::Inode);
+            entry.lastUsed = get<qint64>(record, EntryLayout::LastUsed);
+
+            ImageMetadata &metadata = entry.metadata;
+            metadata.bytes = entry.key.size;
+            metadata.width = get<quint32>(record, EntryLayout::Width);
+            metadata.height = get<quint32>(record, EntryLayout::Height);
+            metadata.dpiX = get<quint32>(record, EntryLayout::DpiX);
+            metadata.dpiY = get<quint32>(record, EntryLayout::DpiY);
+            metadata.paletteColors = get<quint32>(record, EntryLayout::PaletteColors);
+            metadata.depth = record[EntryLayout::Depth];
+            metadata.format = ImageFormat(record[EntryLayout::Format]);
+            metadata.compression = Compression(record[EntryLayout::Compression]);
+            metadata.error = ImageError(record[EntryLayout::Error]);
+            metadata.contentFlags = record[EntryLayout::Flags] & ImageMetadata::PerceptualHashed;
+            metadata.perceptualHash = get<quint64>(record, EntryLayout::PerceptualHash);
+
+            FormatDetails &details = metadata.details;
+            details.colorModel = record[EntryLayout::ColorModel];
+            details.sampleBits = record[EntryLayout::SampleBits];
+            details.sampling = record[EntryLayout::Sampling];
+            details.flags = record[EntryLayout::DetailFlags];
+            details.compressionCode = get<quint16>(record, EntryLayout::CompressionCode);
+            details.dataOffset = get<quint32>(record, EntryLayout::DataOffset);
+            details.frames = get<quint32>(record, EntryLayout::Frames);
+            details.headerSize = get<quint16>(record, EntryLayout::HeaderSize);
+            details.chunks = get<quint16>(record, EntryLayout::Chunks);
+
+            quint32 pagesOffset = get<quint32>(record, EntryLayout::PagesOffset);
+            if (pagesOffset != kNoPages &&
+                (pagesOffset > heapSize ||
+                 MetadataRecord::readPages(heap + pagesOffset, qint64(heapSize - pagesOffset), metadata.pageList) < 0)) {
+                continue;
+            }
+
+            QString path = QString::fromUtf8(reinterpret_cast<const char *>(heap + pathOffset), int(pathLength));
+            m_entries.insert(path, entry);
+        }
+    }
+
+    file.unmap(const_cast<uchar *>(data));
+    return valid;
+}
+
+bool MetadataCache::save()
+{
+    QMutexLocker saveLocker(&m_saveMutex);
+    QMutexLocker locker(&m_mutex);
+
+    // Сверх емкости вытесняются записи, которые дольше всего не встречались
+    if (m_entries.size() > m_maxEntries) {
+        QVector<QPair<qint64, QString>> byAge;
+        byAge.reserve(m_entries.size());
+        for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+            byAge.append(qMakePair(it->lastUsed, it.key()));
+        }
+        std::nth_element(byAge.begin(), byAge.begin() + m_maxEntries, byAge.end(),
+                         [](const QPair<qint64, QString> &a, const QPair<qint64, QString> &b) {
+                             return a.first > b.first;
+                         });
+        for (int i = m_maxEntries; i < byAge.size(); ++i) {
+            m_entries.remove(byAge[i].second);
+        }
+        m_counters.evictions += byAge.size() - m_maxEntries;
+    }
+
+    // Записи сериализуются из копии без блокировки: поиск в кэше из потоков
+    // анализа не ждет, пока пишется файл
+    const QHash<QString, Entry> entries = m_entries;
+    locker.unlock();
+
+    QByteArray records(entries.size() * kEntrySize, '\0');
+    QByteArray heap;
+
+    int offset = 0;
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it, offset += kEntrySize) {
+        const Entry &entry = it.value();
+        const ImageMetadata &metadata = entry.metadata;
+        QByteArray utf8 = it.key().toUtf8();
+
+        put<quint32>(records, offset + EntryLayout::PathOffset, quint32(heap.size()));
+        put<quint32>(records, offset + EntryLayout::PathLength, quint32(utf8.size()));
+        put<qint64>(records, offset + EntryLayout::Size, entry.key.size);
+        put<qint64>(records, offset + EntryLayout::Modified, entry.key.modified);
+        put<quint64>(records, offset + EntryLayout::Inode, entry.key.inode);
+        put<qint64>(records, offset + EntryLayout::LastUsed, entry.lastUsed);
+        put<quint32>(records, offset + EntryLayout::Width, metadata.width);
+        put<quint32>(records, offset + EntryLayout::Height, metadata.height);
+        put<quint32>(records, offset + EntryLayout::DpiX, metadata.dpiX);
+        put<quint32>(records, offset + EntryLayout::DpiY, metadata.dpiY);
+        put<quint32>(records, offset + EntryLayout::PaletteColors, metadata.paletteColors);
+        records[offset + EntryLayout::Depth] = char(metadata.depth);
+        records[offset + EntryLayout::Format] = char(metadata.format);
+        records[offset + EntryLayout::Compression] = char(metadata.compression);
+        records[offset + EntryLayout::Error] = char(metadata.error);
+        // Статистика пикселей не хранится: она занимает больше самой записи
+        put<quint64>(records, offset + EntryLayout::PerceptualHash, metadata.perceptualHash);
+        records[offset + EntryLayout::Flags] = char(metadata.contentFlags & ImageMetadata::PerceptualHashed);
+
+        const FormatDetails &details = metadata.details;
+        records[offset + EntryLayout::ColorModel] = char(details.colorModel);
+        records[offset + EntryLayout::SampleBits] = char(details.sampleBits);
+        records[offset + EntryLayout::Sampling] = char(details.sampling);
+        records[offset + EntryLayout::DetailFlags] = char(details.flags);
+        put<quint16>(records, offset + EntryLayout::CompressionCode, details.compressionCode);
+        put<quint32>(records, offset + EntryLayout::DataOffset, details.dataOffset);
+        put<quint32>(records, offset + EntryLayout::Frames, details.frames);
+        put<quint16>(records, offset + EntryLayout::HeaderSize, details.headerSize);
+        put<quint16>(records, offset + EntryLayout::Chunks, details.chunks);
+
+        heap.append(utf8);
+        put<quint32>(records, offset + EntryLayout::PagesOffset, metadata.pageList ? quint32(heap.size()) : kNoPages);
+        if (metadata.pageList) MetadataRecord::appendPages(heap, *metadata.pageList);
+    }
+
+    QByteArray header(kHeaderSize, '\0');
+    std::memcpy(header.data(), kMagic, sizeof(kMagic));
+    put<quint32>(header, HeaderLayout::Version, kVersion);
+    put<quint32>(header, HeaderLayout::EntryCount, quint32(entries.size()));
+    put<quint64>(header, HeaderLayout::HeapSize, quint64(heap.size()));
+
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+    QSaveFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+
+    file.write(header);
+    file.write(records);
+    file.write(heap);
+    return file.commit();
+}
+
+bool MetadataCache::lookup(const QString &path, const FileKey &key, ImageMetadata &metadata)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto it = m_entries.find(path);
+    if (it == m_entries.end()) {
+        m_counters.misses++;
+        return false;
+    }
+
+    if (!(it->key == key)) {
+        m_counters.invalidations++;
+        m_entries.erase(it);
+        return false;
+    }
+
+    m_counters.hits++;
+    it->lastUsed = QDateTime::currentSecsSinceEpoch();
+
+    quint32 pathId = metadata.pathId;
+    metadata = it->metadata;
+    metadata.pathId = pathId;
+    return true;
+}
+
+void MetadataCache::store(const QString &path, const FileKey &key, const ImageMetadata &metadata)
+{
+    Entry entry;
+    entry.key = key;
+    entry.lastUsed = QDateTime::currentSecsSinceEpoch();
+    entry.metadata = metadata;
+
+    QMutexLocker locker(&m_mutex);
+    m_entries.insert(path, entry);
+}
+
+MetadataCache::Counters MetadataCache::counters() const
+{
+    QMutexLocker locker(&m_mutex);
+    Counters counters = m_counters;
+    counters.entries = m_entries.size();
+    return counters;
+}
+
+void MetadataCache::resetCounters()
+{
+    QMutexLocker locker(&m_mutex);
+    m_counters = Counters();
+}
@@ -0,0 +1,69 @@
+#ifndef METADATACACHE_H
+#define METADATACACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include "imagemetadata.h"
+
+class QFileInfo;
+
+// Постоянный кэш метаданных между запусками. Запись действительна,
+// пока у файла не изменились размер, время изменения и inode.
+class MetadataCache
+{
+public:
+    struct FileKey {
+        qint64 size = 0;
+        qint64 modified = 0;    // мс с начала эпохи
+        quint64 inode = 0;      // 0, если ОС не сообщает
+
+        bool operator==(const FileKey &other) const {
+            return size == other.size && modified == other.modified && inode == other.inode;
+        }
+    };
+
+    struct Counters {
+        int hits = 0;
+        int misses = 0;
+        int invalidations = 0;  // файл изменился, запись устарела
+        int evictions = 0;      // вытеснено при превышении емкости
+        int entries = 0;
+    };
+
+    explicit MetadataCache(const QString &filePath = defaultPath());
+
+    static QString defaultPath();
+    static FileKey fileKey(const QFileInfo &fileInfo);
+
+    bool load();
+    // Можно вызывать в фоне во время анализа: файл пишется из снимка записей
+    bool save();
+
+    // Потокобезопасны: вызываются из рабочих потоков сканирования
+    bool lookup(const QString &path, const FileKey &key, ImageMetadata &metadata);
+    void store(const QString &path, const FileKey &key, const ImageMetadata &metadata);
+
+    Counters counters() const;
+    void resetCounters();
+
+    void setMaxEntries(int maxEntries) { m_maxEntries = maxEntries; }
+
+private:
+    struct Entry {
+        FileKey key;
+        qint64 lastUsed = 0;    // с начала эпохи, для вытеснения давно не встречавшихся
+        ImageMetadata metadata;
+    };
+
+    QString m_filePath;
+    int m_maxEntries = 500000;
+    bool m_loaded = false;
+
+    mutable QMutex m_mutex;
+    QMutex m_saveMutex;         // сохранения по очереди: последний снимок пишется последним
+    QHash<QString, Entry> m_entries;
+    Counters m_counters;
+};
+
+#endif // METADATACACHE_H
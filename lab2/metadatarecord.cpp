@@ -0,0 +1,198 @@
+#include "metadatarecord.h"
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+struct RecordLayout {
+    enum {
+        Bytes = 0, Width = 8, Height = 12, DpiX = 16, DpiY = 20, PaletteColors = 24,
+        Depth = 28, Format = 29, Compression = 30, Error = 31,
+        DataOffset = 32, Frames = 36, CompressionCode = 40, HeaderSize = 42, Chunks = 44,
+        ColorModel = 46, SampleBits = 47, Sampling = 48, DetailFlags = 49, ContentFlags = 50,
+        RecordFlags = 51, PerceptualHash = 52, PathLength = 60
+    };
+};
+
+struct PageLayout {
+    enum { Width = 0, Height = 4, CompressionCode = 8, Delay = 10, Depth = 12, Flags = 13 };
+};
+
+struct ContentLayout {
+    enum { UniqueColors = 0, ChannelMin = 4, ChannelMax = 7, ChannelMean = 10, Luminance = 13, Flags = 29 };
+};
+
+enum RecordFlag : quint8 {
+    HasPages = 1,                   // за путем следует список страниц
+    HasContent = 2                  // затем статистика пикселей
+};
+
+const quint8 kContentFlags = ImageMetadata::ContentAnalyzed | ImageMetadata::Grayscale | ImageMetadata::HasAlpha;
+
+// Ограничение длины пути защищает от мусора в поврежденном файле
+const quint32 kMaxPathLength = 64 * 1024;
+const quint32 kMaxPages = 1 << 20;
+
+} // namespace
+
+void MetadataRecord::append(QByteArray &out, const QString &path, const ImageMetadata &metadata)
+{
+    const QByteArray utf8 = path.toUtf8();
+
+    int offset = out.size();
+    out.resize(offset + kFixedSize);
+    uchar *record = reinterpret_cast<uchar *>(out.data()) + offset;
+
+    qToLittleEndian<qint64>(metadata.bytes, record + RecordLayout::Bytes);
+    qToLittleEndian<quint32>(metadata.width, record + RecordLayout::Width);
+    qToLittleEndian<quint32>(metadata.height, record + RecordLayout::Height);
+    qToLittleEndian<quint32>(metadata.dpiX, record + RecordLayout::DpiX);
+    qToLittleEndian<quint32>(metadata.dpiY, record + RecordLayout::DpiY);
+    qToLittleEndian<quint32>(metadata.paletteColors, record + RecordLayout::PaletteColors);
+    record[RecordLayout::Depth] = metadata.depth;
+    record[RecordLayout::Format] = quint8(metadata.format);
+    record[RecordLayout::Compression] = quint8(metadata.compression);
+    record[RecordLayout::Error] = quint8(metadata.error);
+
+    const FormatDetails &details = metadata.details;
+    qToLittleEndian<quint32>(details.dataOffset, record + RecordLayout::DataOffset);
+    qToLittleEndian<quint32>(details.frames, record + RecordLayout::Frames);
+    qToLittleEndian<quint16>(details.compressionCode, record + RecordLayout::CompressionCode);
+    qToLittleEndian<quint16>(details.headerSize, record + RecordLayout::HeaderSize);
+    qToLittleEndian<quint16>(details.chunks, record + RecordLayout::Chunks);
+    record[RecordLayout::ColorModel] = details.colorModel;
+    record[RecordLayout::SampleBits] = details.sampleBits;
+    record[RecordLayout::Sampling] = details.sampling;
+    record[RecordLayout::DetailFlags] = details.flags;
+
+    // Флаги пикселей хранятся в блоке статистики, здесь - только хэш
+    record[RecordLayout::ContentFlags] = metadata.contentFlags & ImageMetadata::PerceptualHashed;
+    record[RecordLayout::RecordFlags] = (metadata.pageList ? HasPages : 0) | (metadata.hasContent() ? HasContent : 0);
+    qToLittleEndian<quint64>(metadata.perceptualHash, record + RecordLayout::PerceptualHash);
+    qToLittleEndian<quint32>(quint32(utf8.size()), record + RecordLayout::PathLength);
+
+    out.append(utf8);
+    if (metadata.pageList) appendPages(out, *metadata.pageList);
+    if (metadata.hasContent()) {
+        int contentOffset = out.size();
+        out.resize(contentOffset + kContentSize);
+        uchar *content = reinterpret_cast<uchar *>(out.data()) + contentOffset;
+        qToLittleEndian<quint32>(metadata.uniqueColors, content + ContentLayout::UniqueColors);
+        std::memcpy(content + ContentLayout::ChannelMin, metadata.channelMin, 3);
+        std::memcpy(content + ContentLayout::ChannelMax, metadata.channelMax, 3);
+        std::memcpy(content + ContentLayout::ChannelMean, metadata.channelMean, 3);
+        std::memcpy(content + ContentLayout::Luminance, metadata.luminance, 16);
+        content[ContentLayout::Flags] = metadata.contentFlags & kContentFlags;
+    }
+}
+
+bool MetadataRecord::read(const uchar *data, qint64 size, qint64 &pos,
+                          QString &path, ImageMetadata &metadata)
+{
+    if (pos + kFixedSize > size) return false;
+
+    const uchar *record = data + pos;
+    quint32 pathLength = qFromLittleEndian<quint32>(record + RecordLayout::PathLength);
+    if (pathLength > kMaxPathLength || pos + kFixedSize + pathLength > size) return false;
+
+    quint8 format = record[RecordLayout::Format];
+    quint8 compression = record[RecordLayout::Compression];
+    quint8 error = record[RecordLayout::Error];
+    if (format >= quint8(ImageFormat::Count) || compression > quint8(Compression::Other) ||
+        error > quint8(ImageError::NotAnalyzed)) {
+        return false;
+    }
+
+    metadata.bytes = qFromLittleEndian<qint64>(record + RecordLayout::Bytes);
+    metadata.width = qFromLittleEndian<quint32>(record + RecordLayout::Width);
+    metadata.height = qFromLittleEndian<quint32>(record + RecordLayout::Height);
+    metadata.dpiX = qFromLittleEndian<quint32>(record + RecordLayout::DpiX);
+    metadata.dpiY = qFromLittleEndian<quint32>(record + RecordLayout::DpiY);
+    metadata.paletteColors = qFromLittleEndian<quint32>(record + RecordLayout::PaletteColors);
+    metadata.depth = record[RecordLayout::Depth];
+    metadata.format = ImageFormat(format);
+    metadata.compression = Compression(compression);
+    metadata.error = ImageError(error);
+
+    FormatDetails &details = metadata.details;
+    details.dataOffset = qFromLittleEndian<quint32>(record + RecordLayout::DataOffset);
+    details.frames = qFromLittleEndian<quint32>(record + RecordLayout::Frames);
+    details.compressionCode = qFromLittleEndian<quint16>(record + RecordLayout::CompressionCode);
+    details.headerSize = qFromLittleEndian<quint16>(record + RecordLayout::HeaderSize);
+    details.chunks = qFromLittleEndian<quint16>(record + RecordLayout::Chunks);
+    details.colorModel = record[RecordLayout::ColorModel];
+    details.sampleBits = record[RecordLayout::SampleBits];
+    details.sampling = record[RecordLayout::Sampling];
+    details.flags = record[RecordLayout::DetailFlags];
+
+    metadata.contentFlags = record[RecordLayout::ContentFlags] & ImageMetadata::PerceptualHashed;
+    metadata.perceptualHash = qFromLittleEndian<quint64>(record + RecordLayout::PerceptualHash);
+
+    qint64 end = pos + kFixedSize + pathLength;
+    metadata.pageList.reset();
+    if (record[RecordLayout::RecordFlags] & HasPages) {
+        qint64 pagesSize = readPages(data + end, size - end, metadata.pageList);
+        if (pagesSize < 0) return false;
+        end += pagesSize;
+    }
+    if (record[RecordLayout::RecordFlags] & HasContent) {
+        if (end + kContentSize > size) return false;
+        const uchar *content = data + end;
+        metadata.uniqueColors = qFromLittleEndian<quint32>(content + ContentLayout::UniqueColors);
+        std::memcpy(metadata.channelMin, content + ContentLayout::ChannelMin, 3);
+        std::memcpy(metadata.channelMax, content + ContentLayout::ChannelMax, 3);
+        std::memcpy(metadata.channelMean, content + ContentLayout::ChannelMean, 3);
+        std::memcpy(metadata.luminance, content + ContentLayout::Luminance, 16);
+        metadata.contentFlags |= (content[ContentLayout::Flags] & kContentFlags) | ImageMetadata::ContentAnalyzed;
+        end += kContentSize;
+    }
+
+    path = QString::fromUtf8(reinterpret_cast<const char *>(record + kFixedSize), int(pathLength));
+    pos = end;
+    return true;
+}
+
+void MetadataRecord::appendPages(QByteArray &out, const PageList &pageList)
+{
+    const QVector<PageInfo> &pages = pageList.pages;
+    int offset = out.size();
+    out.resize(offset + 4 + pages.size() * kPageSize);
+    uchar *data = reinterpret_cast<uchar *>(out.data()) + offset;
+
+    qToLittleEndian<quint32>(quint32(pages.size()), data);
+    data += 4;
+    for (const PageInfo &page : pages) {
+        qToLittleEndian<quint32>(page.width, data + PageLayout::Width);
+        qToLittleEndian<quint32>(page.height, data + PageLayout::Height);
+        qToLittleEndian<quint16>(page.compressionCode, data + PageLayout::CompressionCode);
+        qToLittleEndian<quint16>(page.delay, data + PageLayout::Delay);
+        data[PageLayout::Depth] = page.depth;
+        data[PageLayout::Flags] = page.flags;
+        data[PageLayout::Flags + 1] = 0;
+        data[PageLayout::Flags + 2] = 0;
+        data += kPageSize;
+    }
+}
+
+qint64 MetadataRecord::readPages(const uchar *data, qint64 size, QExplicitlySharedDataPointer<PageList> &pageList)
+{
+    if (size < 4) return -1;
+    quint32 count = qFromLittleEndian<quint32>(data);
+    qint64 bytes = 4 + qint64(count) * kPageSize;
+    if (count > kMaxPages || bytes > size) return -1;
+
+    PageList *list = new PageList;
+    list->pages.resize(int(count));
+    const uchar *page = data + 4;
+    for (PageInfo &info : list->pages) {
+        info.width = qFromLittleEndian<quint32>(page + PageLayout::Width);
+        info.height = qFromLittleEndian<quint32>(page + PageLayout::Height);
+        info.compressionCode = qFromLittleEndian<quint16>(page + PageLayout::CompressionCode);
+        info.delay = qFromLittleEndian<quint16>(page + PageLayout::Delay);
+        info.depth = page[PageLayout::Depth];
+        info.flags = page[PageLayout::Flags];
+        page += kPageSize;
+    }
+    pageList = QExplicitlySharedDataPointer<PageList>(list);
+    return bytes;
+}
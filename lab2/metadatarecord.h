@@ -0,0 +1,32 @@
+#ifndef METADATARECORD_H
+#define METADATARECORD_H
+
+#include <QByteArray>
+#include <QString>
+#include "imagemetadata.h"
+
+// Двоичная запись "путь + метаданные" для журналов и обмена между
+// процессами: 64 байта фиксированных полей (little-endian), затем путь в UTF-8
+// и у многостраничных файлов - список страниц, после глубокого анализа -
+// статистика пикселей (kContentSize байт).
+class MetadataRecord
+{
+public:
+    static const int kFixedSize = 64;
+
+    static void append(QByteArray &out, const QString &path, const ImageMetadata &metadata);
+
+    // Читает запись с позиции pos и сдвигает ее; false - запись неполная
+    // (например, оборвана при аварийном завершении) или повреждена
+    static bool read(const uchar *data, qint64 size, qint64 &pos,
+                     QString &path, ImageMetadata &metadata);
+
+    // Список страниц: число страниц (32 бита), затем по kPageSize байт на страницу.
+    // readPages возвращает число прочитанных байт, -1 - данные неполные.
+    static const int kPageSize = 16;
+    static const int kContentSize = 30;
+    static void appendPages(QByteArray &out, const PageList &pageList);
+    static qint64 readPages(const uchar *data, qint64 size, QExplicitlySharedDataPointer<PageList> &pageList);
+};
+
+#endif // METADATARECORD_H
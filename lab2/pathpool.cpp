@@ -0,0 +1,271 @@
+#include "pathpool.h"
+#include <cstring>
+
+namespace {
+
+// Символов в блоке имен; длинное имя получает отдельный блок
+const int kChunkChars = 256 * 1024;
+
+// Старший бит номера - путь потокового режима, остальные - его ячейка
+const quint32 kStreamBit = 0x80000000u;
+
+// Путь делится после последнего '/': папка вместе с разделителем и имя
+int splitPosition(const QString &path)
+{
+    return path.lastIndexOf('/') + 1;
+}
+
+uint entryHash(quint32 directory, QStringView name)
+{
+    return qHash(name) ^ (directory * 0x9E3779B1u);
+}
+
+bool sameChars(QStringView a, QStringView b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), size_t(a.size()) * sizeof(QChar)) == 0;
+}
+
+} // namespace
+
+PathPool &PathPool::instance()
+{
+    static PathPool pool;
+    return pool;
+}
+
+QStringView PathPool::name(const Entry &entry) const
+{
+    return QStringView(m_chunks[entry.chunk].chars.get() + entry.offset, qsizetype(entry.length));
+}
+
+qint64 PathPool::lookup(quint32 directory, QStringView name, uint hash, int &slot) const
+{
+    slot = -1;
+    if (m_index.isEmpty()) return -1;
+
+    const int mask = m_index.size() - 1;
+    for (int i = int(hash) & mask;; i = (i + 1) & mask) {
+        quint32 value = m_index.at(i);
+        if (value == 0) {
+            slot = i;
+            return -1;
+        }
+        const Entry &entry = m_entries.at(int(value - 1));
+        if (entry.directory == directory && sameChars(this->name(entry), name)) return value - 1;
+    }
+}
+
+qint64 PathPool::lookupDirectory(QStringView directory, uint hash, int &slot) const
+{
+    slot = -1;
+    if (m_directoryIndex.isEmpty()) return -1;
+
+    const int mask = m_directoryIndex.size() - 1;
+    for (int i = int(hash) & mask;; i = (i + 1) & mask) {
+        quint32 value = m_directoryIndex.at(i);
+        if (value == 0) {
+            slot = i;
+            return -1;
+        }
+        if (sameChars(m_directories.at(int(value - 1)), directory)) return value - 1;
+    }
+}
+
+void PathPool::growDirectoryIndex()
+{
+    QVector<quint32> index(qMax(64, m_directoryIndex.size() * 2), 0);
+    const int mask = index.size() - 1;
+    for (int id = 0; id < m_directories.size(); ++id) {
+        int i = int(qHash(QStringView(m_directories.at(id)))) & mask;
+        while (index.at(i) != 0) i = (i + 1) & mask;
+        index[i] = quint32(id + 1);
+    }
+    m_directoryIndex.swap(index);
+}
+
+void PathPool::growIndex()
+{
+    // Заполнение не больше половины: короткие цепочки при линейном пробировании
+    QVector<quint32> index(qMax(1024, m_index.size() * 2), 0);
+    const int mask = index.size() - 1;
+    for (int id = 0; id < m_entries.size(); ++id) {
+        const Entry &entry = m_entries.at(id);
+        int i = int(entryHash(entry.directory, name(entry))) & mask;
+        while (index.at(i) != 0) i = (i + 1) & mask;
+        index[i] = quint32(id + 1);
+    }
+    m_index.swap(index);
+}
+
+quint32 PathPool::intern(const QString &path)
+{
+    if (m_streaming) {
+        // Строка неявно разделяется с путем вызывающего, копии нет
+        QWriteLocker locker(&m_lock);
+        quint32 slot;
+        if (!m_freeStreamPaths.isEmpty()) {
+            slot = m_freeStreamPaths.takeLast();
+            m_streamPaths[int(slot)] = path;
+        } else {
+            slot = quint32(m_streamPaths.size());
+            m_streamPaths.append(path);
+        }
+        return kStreamBit | slot;
+    }
+
+    const int split = splitPosition(path);
+    const QStringView directory = QStringView(path).left(split);
+    const QStringView fileName = QStringView(path).mid(split);
+    const uint directoryHash = qHash(directory);
+
+    {
+        QReadLocker locker(&m_lock);
+        int slot;
+        qint64 directoryId = lookupDirectory(directory, directoryHash, slot);
+        if (directoryId >= 0) {
+            qint64 id = lookup(quint32(directoryId), fileName, entryHash(quint32(directoryId), fileName), slot);
+            if (id >= 0) return quint32(id);
+        }
+    }
+
+    // Строка папки создается только для новой папки
+    QWriteLocker locker(&m_lock);
+    if ((m_directories.size() + 1) * 2 > m_directoryIndex.size()) growDirectoryIndex();
+    int directorySlot;
+    qint64 foundDirectory = lookupDirectory(directory, directoryHash, directorySlot);
+    quint32 directoryId;
+    if (foundDirectory >= 0) {
+        directoryId = quint32(foundDirectory);
+    } else {
+        directoryId = quint32(m_directories.size());
+        m_directories.append(directory.toString());
+        m_directoryIndex[directorySlot] = directoryId + 1;
+    }
+
+    if ((m_entries.size() + 1) * 2 > m_index.size()) growIndex();
+
+    const uint hash = entryHash(directoryId, fileName);
+    int slot;
+    qint64 existing = lookup(directoryId, fileName, hash, slot);
+    if (existing >= 0) return quint32(existing);
+
+    const int length = fileName.size();
+    if (m_chunks.empty() || m_chunks.back().capacity - m_chunks.back().used < length) {
+        Chunk chunk;
+        chunk.capacity = qMax(kChunkChars, length);
+        chunk.chars.reset(new QChar[size_t(chunk.capacity)]);
+        m_chunks.push_back(std::move(chunk));
+    }
+    Chunk &chunk = m_chunks.back();
+    std::memcpy(chunk.chars.get() + chunk.used, fileName.data(), size_t(length) * sizeof(QChar));
+
+    Entry entry;
+    entry.directory = directoryId;
+    entry.chunk = quint32(m_chunks.size() - 1);
+    entry.offset = quint32(chunk.used);
+    entry.length = quint32(length);
+    chunk.used += length;
+
+    quint32 id = quint32(m_entries.size());
+    m_entries.append(entry);
+    m_index[slot] = id + 1;
+    return id;
+}
+
+bool PathPool::find(const QString &path, quint32 &id) const
+{
+    const int split = splitPosition(path);
+    const QStringView directory = QStringView(path).left(split);
+    const QStringView fileName = QStringView(path).mid(split);
+
+    QReadLocker locker(&m_lock);
+    int slot;
+    qint64 directoryId = lookupDirectory(directory, qHash(directory), slot);
+    if (directoryId < 0) return false;
+
+    qint64 found = lookup(quint32(directoryId), fileName, entryHash(quint32(directoryId), fileName), slot);
+    if (found < 0) return false;
+
+    id = quint32(found);
+    return true;
+}
+
+QString PathPool::path(quint32 id) const
+{
+    QReadLocker locker(&m_lock);
+    if (id & kStreamBit) return m_streamPaths.value(int(id & ~kStreamBit));
+    if (id >= quint32(m_entries.size())) return QString();
+
+    const Entry &entry = m_entries.at(int(id));
+    const QString &directory = m_directories.at(int(entry.directory));
+    QString result;
+    result.reserve(directory.size() + int(entry.length));
+    result.append(directory);
+    result.append(name(entry).data(), int(entry.length));
+    return result;
+}
+
+QString PathPool::fileName(quint32 id) const
+{
+    QReadLocker locker(&m_lock);
+    if (id & kStreamBit) {
+        const QString path = m_streamPaths.value(int(id & ~kStreamBit));
+        return path.mid(splitPosition(path));
+    }
+    if (id >= quint32(m_entries.size())) return QString();
+    return name(m_entries.at(int(id))).toString();
+}
+
+int PathPool::size() const
+{
+    QReadLocker locker(&m_lock);
+    return m_entries.size();
+}
+
+void PathPool::setStreaming(bool streaming)
+{
+    QWriteLocker locker(&m_lock);
+    m_streaming = streaming;
+}
+
+void PathPool::release(quint32 id)
+{
+    if (!(id & kStreamBit)) return;
+
+    QWriteLocker locker(&m_lock);
+    const int slot = int(id & ~kStreamBit);
+    if (slot >= m_streamPaths.size() || m_streamPaths.at(slot).isNull()) return;
+    m_streamPaths[slot] = QString();
+    m_freeStreamPaths.append(quint32(slot));
+}
+
+qint64 PathPool::memoryUsage() const
+{
+    QReadLocker locker(&m_lock);
+    qint64 bytes = qint64(m_entries.capacity()) * qint64(sizeof(Entry))
+                   + qint64(m_index.capacity() + m_directoryIndex.capacity()) * qint64(sizeof(quint32));
+    for (const Chunk &chunk : m_chunks) {
+        bytes += qint64(chunk.capacity) * qint64(sizeof(QChar));
+    }
+    for (const QString &directory : m_directories) {
+        bytes += qint64(directory.capacity()) * qint64(sizeof(QChar));
+    }
+    bytes += qint64(m_streamPaths.capacity()) * qint64(sizeof(QString))
+             + qint64(m_freeStreamPaths.capacity()) * qint64(sizeof(quint32));
+    for (const QString &path : m_streamPaths) {
+        bytes += qint64(path.capacity()) * qint64(sizeof(QChar));
+    }
+    return bytes;
+}
+
+void PathPool::clear()
+{
+    QWriteLocker locker(&m_lock);
+    m_streamPaths.clear();
+    m_freeStreamPaths.clear();
+    m_directories.clear();
+    m_directoryIndex.clear();
+    m_entries.clear();
+    m_chunks.clear();
+    m_index.clear();
+}
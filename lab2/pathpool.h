@@ -0,0 +1,79 @@
+#ifndef PATHPOOL_H
+#define PATHPOOL_H
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <memory>
+#include <vector>
+
+// Общий реестр путей: записи результатов хранят только номер пути.
+// Повторная регистрация того же пути возвращает прежний номер.
+// Папка (с завершающим '/') хранится один раз, имена файлов дописываются
+// в большие блоки символов; запись о пути - номер папки и смещение имени.
+// Индексы путей и папок - открытая адресация по номерам, без отдельных узлов
+// и копий строк: поиск уже известного пути ничего не выделяет.
+class PathPool
+{
+public:
+    static PathPool &instance();
+
+    quint32 intern(const QString &path);
+    // Номер уже зарегистрированного пути, без добавления
+    bool find(const QString &path, quint32 &id) const;
+    QString path(quint32 id) const;
+    QString fileName(quint32 id) const;
+    // Путей в реестре, без потоковых
+    int size() const;
+
+    // Потоковый режим (командная строка, процесс анализа): результаты не
+    // хранятся, поэтому intern не регистрирует путь, а держит строку до
+    // release, и номер затем используется снова. Память ограничена числом
+    // записей в пути от анализа до вывода. Повторный intern дает новый номер,
+    // find такие пути не находит. Включается до начала анализа.
+    void setStreaming(bool streaming);
+    void release(quint32 id);
+
+    // Память под пути, папки и индекс, в байтах
+    qint64 memoryUsage() const;
+
+    void clear();
+
+private:
+    struct Entry {
+        quint32 directory;
+        quint32 chunk;
+        quint32 offset;
+        quint32 length;
+    };
+
+    struct Chunk {
+        std::unique_ptr<QChar[]> chars;
+        int capacity = 0;
+        int used = 0;
+    };
+
+    PathPool() = default;
+
+    QStringView name(const Entry &entry) const;
+    // Номер пути в папке или -1; slot - ячейка индекса для вставки
+    qint64 lookup(quint32 directory, QStringView name, uint hash, int &slot) const;
+    void growIndex();
+    // Номер папки или -1, так же
+    qint64 lookupDirectory(QStringView directory, uint hash, int &slot) const;
+    void growDirectoryIndex();
+
+    mutable QReadWriteLock m_lock;
+    bool m_streaming = false;
+    QVector<QString> m_streamPaths;
+    QVector<quint32> m_freeStreamPaths;
+    QVector<QString> m_directories;
+    QVector<quint32> m_directoryIndex;  // номер папки + 1, 0 - свободно
+    QVector<Entry> m_entries;
+    std::vector<Chunk> m_chunks;
+    QVector<quint32> m_index;       // номер пути + 1, 0 - свободно
+};
+
+#endif // PATHPOOL_H
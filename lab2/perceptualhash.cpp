@@ -0,0 +1,47 @@
+#include "perceptualhash.h"
+#include <QImageIOHandler>
+#include <QImageReader>
+
+namespace {
+
+const int kHashWidth = 8;
+const int kHashHeight = 8;
+
+// Сторона промежуточной копии при чтении с уменьшением: заметно больше
+// 9x8, чтобы итоговое усреднение не зависело от способа уменьшения
+const int kThumbnailSide = 64;
+
+} // namespace
+
+quint64 PerceptualHash::compute(const QImage &image)
+{
+    // Сглаживающее уменьшение усредняет пиксели по площади: шум и
+    // артефакты сжатия не влияют на результат
+    const QImage small = image.scaled(kHashWidth + 1, kHashHeight, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+                             .convertToFormat(QImage::Format_Grayscale8);
+
+    quint64 hash = 0;
+    for (int y = 0; y < kHashHeight; ++y) {
+        const uchar *line = small.constScanLine(y);
+        for (int x = 0; x < kHashWidth; ++x) {
+            hash = (hash << 1) | (line[x] > line[x + 1] ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+bool PerceptualHash::fromFile(const QString &filePath, quint64 &hash)
+{
+    QImageReader reader(filePath);
+    const QSize size = reader.size();
+    if (size.isValid() && size.width() > kThumbnailSide && size.height() > kThumbnailSide &&
+        reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        reader.setScaledSize(size.scaled(kThumbnailSide, kThumbnailSide, Qt::KeepAspectRatioByExpanding));
+    }
+
+    const QImage image = reader.read();
+    if (image.isNull()) return false;
+
+    hash = compute(image);
+    return true;
+}
@@ -0,0 +1,26 @@
+#ifndef PERCEPTUALHASH_H
+#define PERCEPTUALHASH_H
+
+#include <QImage>
+#include <QString>
+#include <QtAlgorithms>
+#include <QtGlobal>
+
+// Перцептивный хэш (dHash): изображение уменьшается до 9x8 в оттенках
+// серого, каждый бит - ярче ли пиксель своего соседа справа. Не зависит
+// от размера, формата и степени сжатия; похожие изображения дают хэши,
+// отличающиеся в нескольких битах.
+class PerceptualHash
+{
+public:
+    static quint64 compute(const QImage &image);
+
+    // Читает файл сразу уменьшенным, если формат это умеет (JPEG
+    // декодирует в 1/2-1/8 размера); false - файл не читается
+    static bool fromFile(const QString &filePath, quint64 &hash);
+
+    // Расстояние Хэмминга: число различающихся бит
+    static int distance(quint64 a, quint64 b) { return int(qPopulationCount(a ^ b)); }
+};
+
+#endif // PERCEPTUALHASH_H
@@ -0,0 +1,495 @@
+#include "pixelanalyzer.h"
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent>
+#include <algorithm>
+#include <vector>
+
+#if defined(Q_PROCESSOR_X86) && (defined(__GNUC__) || defined(_MSC_VER))
+#define PIXEL_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC и Clang собирают векторные функции для своего набора команд,
+// без флагов -mavx2 для всего файла; вызываются они только после проверки процессора
+#if defined(PIXEL_SIMD) && defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+namespace {
+
+// Меньшие изображения не делятся на полосы: запуск потоков дороже подсчета
+const quint64 kParallelThreshold = 1 << 20;
+
+// До этого числа пикселей цвета считаются сортировкой, дальше - битовой картой на 2^24 цветов
+const quint64 kSmallImage = 1 << 16;
+const int kColorWords = (1 << 24) / 64;
+
+// Байт i векторного регистра - байт i % 4 пикселя ARGB32 в памяти: B, G, R, A
+const int kLaneChannel[4] = {2, 1, 0, 3};
+
+// Статистика полосы строк, кроме числа цветов
+struct Partial {
+    quint8 min[4] = {255, 255, 255, 255};
+    quint8 max[4] = {0, 0, 0, 0};
+    quint64 sum[4] = {0, 0, 0, 0};
+    quint64 luminance[256] = {};
+    bool grayscale = true;
+};
+
+struct Band {
+    Partial partial;
+    std::vector<quint32> colorList;     // небольшое изображение: список для сортировки
+};
+
+enum ColorBitsUse {
+    ScratchBits,    // цвета одной полосы
+    ResultBits      // итог изображения в вызвавшем потоке
+};
+
+// Битовые карты цветов (2 МБ) выделяются один раз на поток и переиспользуются:
+// при анализе папки потоков много, и своя карта у каждой полосы каждого
+// изображения умножала бы память на число полос. Возвращается обнуленной.
+std::vector<quint64> &threadColorBits(ColorBitsUse use)
+{
+    thread_local std::vector<quint64> bits[2];
+    std::vector<quint64> &result = bits[use];
+    result.assign(kColorWords, 0);
+    return result;
+}
+
+void mergeColorBits(std::vector<quint64> &bits, const std::vector<quint64> &other)
+{
+    for (int word = 0; word < kColorWords; ++word) {
+        bits[word] |= other[word];
+    }
+}
+
+typedef void (*RowFunction)(const QRgb *row, int width, Partial &partial);
+
+inline int luma(int r, int g, int b)
+{
+    return (77 * r + 150 * g + 29 * b + 128) >> 8;
+}
+
+void scalarPixels(const QRgb *row, int begin, int end, Partial &partial)
+{
+    for (int x = begin; x < end; ++x) {
+        const QRgb pixel = row[x];
+        const int channels[4] = {qRed(pixel), qGreen(pixel), qBlue(pixel), qAlpha(pixel)};
+        for (int c = 0; c < 4; ++c) {
+            partial.min[c] = quint8(qMin<int>(partial.min[c], channels[c]));
+            partial.max[c] = quint8(qMax<int>(partial.max[c], channels[c]));
+            partial.sum[c] += quint64(channels[c]);
+        }
+        if (channels[0] != channels[1] || channels[1] != channels[2]) partial.grayscale = false;
+        partial.luminance[luma(channels[0], channels[1], channels[2])]++;
+    }
+}
+
+void scalarRow(const QRgb *row, int width, Partial &partial)
+{
+    scalarPixels(row, 0, width, partial);
+}
+
+#ifdef PIXEL_SIMD
+
+void mergeLanes(const quint8 *mins, const quint8 *maxs, int bytes, Partial &partial)
+{
+    for (int i = 0; i < bytes; ++i) {
+        const int c = kLaneChannel[i & 3];
+        partial.min[c] = qMin(partial.min[c], mins[i]);
+        partial.max[c] = qMax(partial.max[c], maxs[i]);
+    }
+}
+
+// 4 пикселя за шаг. Минимум и максимум - по байтам сразу для всех каналов,
+// суммы - через _mm_sad_epu8 по маске канала, яркость - 16-битным умножением
+// (все произведения и их сумма меньше 2^16)
+TARGET_SSE2 void sse2Row(const QRgb *row, int width, Partial &partial)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    const __m128i grayMask = _mm_set1_epi32(0xFFFF);
+    const __m128i weightR = _mm_set1_epi32(77);
+    const __m128i weightG = _mm_set1_epi32(150);
+    const __m128i weightB = _mm_set1_epi32(29);
+    const __m128i rounding = _mm_set1_epi32(128);
+    __m128i laneMasks[4];
+    __m128i sums[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        laneMasks[lane] = _mm_set1_epi32(int(0xFFu << (8 * lane)));
+        sums[lane] = zero;
+    }
+    __m128i vmin = _mm_set1_epi8(char(0xFF));
+    __m128i vmax = zero;
+    __m128i mismatch = zero;
+    alignas(16) quint32 y[4];
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+        vmin = _mm_min_epu8(vmin, v);
+        vmax = _mm_max_epu8(vmax, v);
+        for (int lane = 0; lane < 4; ++lane) {
+            sums[lane] = _mm_add_epi64(sums[lane], _mm_sad_epu8(_mm_and_si128(v, laneMasks[lane]), zero));
+        }
+
+        // Байты 0 и 1 сравнения с собой, сдвинутым на байт: B == G и G == R
+        const __m128i shifted = _mm_srli_epi32(v, 8);
+        mismatch = _mm_or_si128(mismatch, _mm_andnot_si128(_mm_cmpeq_epi8(v, shifted), grayMask));
+
+        const __m128i b = _mm_and_si128(v, byteMask);
+        const __m128i g = _mm_and_si128(shifted, byteMask);
+        const __m128i r = _mm_and_si128(_mm_srli_epi32(v, 16), byteMask);
+        __m128i l = _mm_add_epi32(_mm_mullo_epi16(r, weightR), _mm_mullo_epi16(g, weightG));
+        l = _mm_add_epi32(l, _mm_add_epi32(_mm_mullo_epi16(b, weightB), rounding));
+        _mm_store_si128(reinterpret_cast<__m128i *>(y), _mm_srli_epi32(l, 8));
+        partial.luminance[y[0]]++;
+        partial.luminance[y[1]]++;
+        partial.luminance[y[2]]++;
+        partial.luminance[y[3]]++;
+    }
+
+    alignas(16) quint8 mins[16];
+    alignas(16) quint8 maxs[16];
+    _mm_store_si128(reinterpret_cast<__m128i *>(mins), vmin);
+    _mm_store_si128(reinterpret_cast<__m128i *>(maxs), vmax);
+    mergeLanes(mins, maxs, 16, partial);
+
+    alignas(16) quint64 laneSums[2];
+    for (int lane = 0; lane < 4; ++lane) {
+        _mm_store_si128(reinterpret_cast<__m128i *>(laneSums), sums[lane]);
+        partial.sum[kLaneChannel[lane]] += laneSums[0] + laneSums[1];
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(mismatch, zero)) != 0xFFFF) partial.grayscale = false;
+
+    scalarPixels(row, x, width, partial);
+}
+
+// То же, что sse2Row, по 8 пикселей за шаг
+TARGET_AVX2 void avx2Row(const QRgb *row, int width, Partial &partial)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    const __m256i grayMask = _mm256_set1_epi32(0xFFFF);
+    const __m256i weightR = _mm256_set1_epi32(77);
+    const __m256i weightG = _mm256_set1_epi32(150);
+    const __m256i weightB = _mm256_set1_epi32(29);
+    const __m256i rounding = _mm256_set1_epi32(128);
+    __m256i laneMasks[4];
+    __m256i sums[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        laneMasks[lane] = _mm256_set1_epi32(int(0xFFu << (8 * lane)));
+        sums[lane] = zero;
+    }
+    __m256i vmin = _mm256_set1_epi8(char(0xFF));
+    __m256i vmax = zero;
+    __m256i mismatch = zero;
+    alignas(32) quint32 y[8];
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + x));
+        vmin = _mm256_min_epu8(vmin, v);
+        vmax = _mm256_max_epu8(vmax, v);
+        for (int lane = 0; lane < 4; ++lane) {
+            sums[lane] = _mm256_add_epi64(sums[lane], _mm256_sad_epu8(_mm256_and_si256(v, laneMasks[lane]), zero));
+        }
+
+        const __m256i shifted = _mm256_srli_epi32(v, 8);
+        mismatch = _mm256_or_si256(mismatch, _mm256_andnot_si256(_mm256_cmpeq_epi8(v, shifted), grayMask));
+
+        const __m256i b = _mm256_and_si256(v, byteMask);
+        const __m256i g = _mm256_and_si256(shifted, byteMask);
+        const __m256i r = _mm256_and_si256(_mm256_srli_epi32(v, 16), byteMask);
+        __m256i l = _mm256_add_epi32(_mm256_mullo_epi16(r, weightR), _mm256_mullo_epi16(g, weightG));
+        l = _mm256_add_epi32(l, _mm256_add_epi32(_mm256_mullo_epi16(b, weightB), rounding));
+        _mm256_store_si256(reinterpret_cast<__m256i *>(y), _mm256_srli_epi32(l, 8));
+        for (int i = 0; i < 8; ++i) {
+            partial.luminance[y[i]]++;
+        }
+    }
+
+    alignas(32) quint8 mins[32];
+    alignas(32) quint8 maxs[32];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(mins), vmin);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(maxs), vmax);
+    mergeLanes(mins, maxs, 32, partial);
+
+    alignas(32) quint64 laneSums[4];
+    for (int lane = 0; lane < 4; ++lane) {
+        _mm256_store_si256(reinterpret_cast<__m256i *>(laneSums), sums[lane]);
+        partial.sum[kLaneChannel[lane]] += laneSums[0] + laneSums[1] + laneSums[2] + laneSums[3];
+    }
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(mismatch, zero)) != -1) partial.grayscale = false;
+
+    scalarPixels(row, x, width, partial);
+}
+
+bool cpuHasSse2()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    return true;
+#elif defined(__GNUC__)
+    return __builtin_cpu_supports("sse2");
+#else
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#endif
+}
+
+bool cpuHasAvx2()
+{
+#if defined(__GNUC__)
+    // Учитывает и поддержку регистров YMM со стороны ОС
+    return __builtin_cpu_supports("avx2");
+#else
+    int info[4];
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+#endif // PIXEL_SIMD
+
+RowFunction rowFunction(PixelAnalyzer::Kernel kernel)
+{
+    switch (kernel) {
+#ifdef PIXEL_SIMD
+    case PixelAnalyzer::Sse2: return sse2Row;
+    case PixelAnalyzer::Avx2: return avx2Row;
+#endif
+    default: return scalarRow;
+    }
+}
+
+// Ядра работают с 32-битными пикселями без премультипликации
+QImage toArgb32(const QImage &source)
+{
+    return source.format() == QImage::Format_ARGB32 || source.format() == QImage::Format_RGB32
+               ? source
+               : source.convertToFormat(QImage::Format_ARGB32);
+}
+
+// Без битовой карты цвета собираются списком
+void scanRows(const QImage &image, int firstRow, int lastRow, RowFunction processRow,
+              Band &band, quint64 *colorBits)
+{
+    const int width = image.width();
+    const bool smallImage = !colorBits;
+    if (smallImage) band.colorList.reserve(size_t(width) * size_t(lastRow - firstRow));
+
+    for (int y = firstRow; y < lastRow; ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        processRow(line, width, band.partial);
+
+        // Набор цветов пополняется, пока строка еще в кэше процессора
+        if (smallImage) {
+            for (int x = 0; x < width; ++x) {
+                band.colorList.push_back(line[x] & 0xFFFFFF);
+            }
+        } else {
+            for (int x = 0; x < width; ++x) {
+                const quint32 color = line[x] & 0xFFFFFF;
+                colorBits[color >> 6] |= quint64(1) << (color & 63);
+            }
+        }
+    }
+}
+
+void mergePartial(PixelStatistics &stats, const Partial &partial)
+{
+    for (int c = 0; c < 4; ++c) {
+        stats.min[c] = qMin(stats.min[c], partial.min[c]);
+        stats.max[c] = qMax(stats.max[c], partial.max[c]);
+        stats.sum[c] += partial.sum[c];
+    }
+    for (int i = 0; i < 256; ++i) {
+        stats.luminance[i] += partial.luminance[i];
+    }
+    stats.grayscale = stats.grayscale && partial.grayscale;
+}
+
+quint32 countColors(const std::vector<quint64> &bits)
+{
+    quint32 count = 0;
+    for (quint64 word : bits) {
+        count += qPopulationCount(word);
+    }
+    return count;
+}
+
+} // namespace
+
+void PixelStatistics::applyTo(ImageMetadata &metadata) const
+{
+    metadata.uniqueColors = uniqueColors;
+    for (int c = 0; c < 3; ++c) {
+        metadata.channelMin[c] = min[c];
+        metadata.channelMax[c] = max[c];
+        metadata.channelMean[c] = quint8(qRound(mean(c)));
+    }
+
+    // 16 полос яркости, доля пикселей в 1/255
+    for (int band = 0; band < 16; ++band) {
+        quint64 count = 0;
+        for (int i = 0; i < 16; ++i) {
+            count += luminance[band * 16 + i];
+        }
+        metadata.luminance[band] = pixels ? quint8((count * 255 + pixels / 2) / pixels) : 0;
+    }
+
+    metadata.contentFlags = ImageMetadata::ContentAnalyzed;
+    if (grayscale) metadata.contentFlags |= ImageMetadata::Grayscale;
+    if (min[3] < 255) metadata.contentFlags |= ImageMetadata::HasAlpha;
+}
+
+bool PixelStatistics::operator==(const PixelStatistics &other) const
+{
+    return pixels == other.pixels && uniqueColors == other.uniqueColors && grayscale == other.grayscale &&
+           std::equal(min, min + 4, other.min) && std::equal(max, max + 4, other.max) &&
+           std::equal(sum, sum + 4, other.sum) && std::equal(luminance, luminance + 256, other.luminance);
+}
+
+bool PixelAnalyzer::isSupported(Kernel kernel)
+{
+    switch (kernel) {
+    case Auto:
+    case Scalar:
+        return true;
+#ifdef PIXEL_SIMD
+    case Sse2: return cpuHasSse2();
+    case Avx2: return cpuHasAvx2();
+#endif
+    default:
+        return false;
+    }
+}
+
+PixelAnalyzer::Kernel PixelAnalyzer::bestKernel()
+{
+    static const Kernel best = isSupported(Avx2) ? Avx2 : isSupported(Sse2) ? Sse2 : Scalar;
+    return best;
+}
+
+const char *PixelAnalyzer::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case Scalar: return "scalar";
+    case Sse2: return "sse2";
+    case Avx2: return "avx2";
+    default: return "auto";
+    }
+}
+
+PixelStatistics PixelAnalyzer::analyze(const QImage &source, Kernel kernel, int threadCount)
+{
+    PixelStatistics stats;
+    if (source.isNull()) return stats;
+
+    const QImage image = toArgb32(source);
+    if (kernel == Auto || !isSupported(kernel)) kernel = bestKernel();
+    const RowFunction processRow = rowFunction(kernel);
+
+    const int height = image.height();
+    const quint64 pixels = quint64(image.width()) * quint64(height);
+    const bool smallImage = pixels <= kSmallImage;
+
+    int bandCount = 1;
+    if (pixels >= kParallelThreshold && threadCount != 1) {
+        bandCount = threadCount > 0 ? threadCount : QThread::idealThreadCount();
+        bandCount = qBound(1, bandCount, height);
+    }
+
+    // Одна полоса пишет цвета прямо в итог, несколько - в карты своих потоков
+    // и сливают их в итог по окончании
+    std::vector<Band> bands(bandCount);
+    std::vector<quint64> *colorBits = smallImage ? nullptr : &threadColorBits(ResultBits);
+    QMutex colorMutex;
+    auto runBand = [&](int index) {
+        const int firstRow = int(qint64(height) * index / bandCount);
+        const int lastRow = int(qint64(height) * (index + 1) / bandCount);
+        if (!colorBits || bandCount == 1) {
+            scanRows(image, firstRow, lastRow, processRow, bands[index], colorBits ? colorBits->data() : nullptr);
+            return;
+        }
+
+        std::vector<quint64> &scratch = threadColorBits(ScratchBits);
+        scanRows(image, firstRow, lastRow, processRow, bands[index], scratch.data());
+        QMutexLocker locker(&colorMutex);
+        mergeColorBits(*colorBits, scratch);
+    };
+
+    QVector<QFuture<void>> helpers;
+    for (int i = 1; i < bandCount; ++i) {
+        helpers.append(QtConcurrent::run([&runBand, i]() { runBand(i); }));
+    }
+    runBand(0);
+    for (QFuture<void> &future : helpers) {
+        future.waitForFinished();
+    }
+
+    stats.pixels = pixels;
+    for (const Band &band : bands) {
+        mergePartial(stats, band.partial);
+    }
+
+    if (smallImage) {
+        std::vector<quint32> &colors = bands[0].colorList;
+        std::sort(colors.begin(), colors.end());
+        stats.uniqueColors = quint32(std::unique(colors.begin(), colors.end()) - colors.begin());
+    } else {
+        stats.uniqueColors = countColors(*colorBits);
+    }
+
+    return stats;
+}
+
+PixelAccumulator::PixelAccumulator(PixelAnalyzer::Kernel kernel)
+    : m_kernel(PixelAnalyzer::isSupported(kernel) && kernel != PixelAnalyzer::Auto ? kernel
+                                                                                   : PixelAnalyzer::bestKernel()),
+      m_colorBits(kColorWords, 0)
+{
+}
+
+void PixelAccumulator::add(const QImage &source)
+{
+    if (source.isNull()) return;
+
+    const QImage image = toArgb32(source);
+    const quint64 pixels = quint64(image.width()) * quint64(image.height());
+    const bool smallImage = pixels <= kSmallImage;
+    Band band;
+    std::vector<quint64> *colorBits = smallImage ? nullptr : &threadColorBits(ScratchBits);
+    scanRows(image, 0, image.height(), rowFunction(m_kernel), band, colorBits ? colorBits->data() : nullptr);
+
+    QMutexLocker locker(&m_mutex);
+    m_stats.pixels += pixels;
+    mergePartial(m_stats, band.partial);
+    if (smallImage) {
+        for (quint32 color : band.colorList) {
+            m_colorBits[color >> 6] |= quint64(1) << (color & 63);
+        }
+    } else {
+        mergeColorBits(m_colorBits, *colorBits);
+    }
+}
+
+PixelStatistics PixelAccumulator::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    PixelStatistics stats = m_stats;
+    stats.uniqueColors = countColors(m_colorBits);
+    return stats;
+}
@@ -0,0 +1,70 @@
+#ifndef PIXELANALYZER_H
+#define PIXELANALYZER_H
+
+#include <QImage>
+#include <QMutex>
+#include <QtGlobal>
+#include <vector>
+#include "imagemetadata.h"
+
+// Статистика содержимого изображения по всем пикселям.
+// Каналы по порядку: R, G, B, A.
+struct PixelStatistics {
+    quint64 pixels = 0;
+    quint32 uniqueColors = 0;           // различных RGB, альфа не учитывается
+    quint8 min[4] = {255, 255, 255, 255};
+    quint8 max[4] = {0, 0, 0, 0};
+    quint64 sum[4] = {0, 0, 0, 0};
+    quint64 luminance[256] = {};        // Y = (77R + 150G + 29B + 128) >> 8
+    bool grayscale = true;              // R == G == B во всех пикселях
+
+    double mean(int channel) const { return pixels ? double(sum[channel]) / pixels : 0.0; }
+
+    // Сводка для записи о файле
+    void applyTo(ImageMetadata &metadata) const;
+
+    bool operator==(const PixelStatistics &other) const;
+    bool operator!=(const PixelStatistics &other) const { return !(*this == other); }
+};
+
+// Подсчет статистики пикселей. Векторные ядра SSE2/AVX2 выбираются по
+// процессору во время выполнения; все вычисления целочисленные, поэтому
+// результат любого ядра совпадает со скалярным до бита.
+class PixelAnalyzer
+{
+public:
+    enum Kernel {
+        Auto,
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    static bool isSupported(Kernel kernel);
+    static Kernel bestKernel();
+    static const char *kernelName(Kernel kernel);
+
+    // Крупные изображения делятся на полосы строк по потокам;
+    // threadCount 0 - по числу ядер, 1 - без деления
+    static PixelStatistics analyze(const QImage &image, Kernel kernel = Auto, int threadCount = 0);
+};
+
+// Итог по нескольким изображениям, например по страницам TIFF.
+// add вызывается из разных потоков: изображение считается в вызвавшем
+// потоке одной полосой и сразу сливается в общий итог.
+class PixelAccumulator
+{
+public:
+    explicit PixelAccumulator(PixelAnalyzer::Kernel kernel = PixelAnalyzer::Auto);
+
+    void add(const QImage &image);
+    PixelStatistics statistics() const;
+
+private:
+    PixelAnalyzer::Kernel m_kernel;
+    mutable QMutex m_mutex;
+    PixelStatistics m_stats;
+    std::vector<quint64> m_colorBits;   // цвета всех изображений
+};
+
+#endif // PIXELANALYZER_H
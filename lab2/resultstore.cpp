@@ -0,0 +1,401 @@
+#include "resultstore.h"
+#include "metadatarecord.h"
+#include "pathpool.h"
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char kMagic[8] = {'I', 'M', 'G', 'R', 'E', 'S', 'U', 'L'};
+const quint32 kVersion = 1;
+const char kBlockMagic[4] = {'B', 'L', 'C', 'K'};
+
+struct HeaderLayout {
+    enum { Magic = 0, Version = 8, ColumnCount = 12, Columns = 16 };
+};
+
+struct BlockLayout {
+    enum { Magic = 0, RowCount = 4, HeapSize = 8, Size = 16 };
+};
+
+// Номера столбцов записываются в файл: новые - только в конец
+enum Column : quint16 {
+    Bytes, Width, Height, DpiX, DpiY, PaletteColors, Depth, Format, CompressionColumn, Error,
+    ContentFlags, UniqueColors, ChannelMin, ChannelMax, ChannelMean, Luminance, PerceptualHash,
+    DataOffset, Frames, CompressionCode, HeaderSize, Chunks, ColorModel, SampleBits, Sampling, DetailFlags,
+    PathOffset, PathLength, PagesOffset,
+    ColumnCount
+};
+
+const quint16 kColumnWidths[ColumnCount] = {
+    8, 4, 4, 4, 4, 4, 1, 1, 1, 1,
+    1, 4, 3, 3, 3, 16, 8,
+    4, 4, 2, 2, 2, 1, 1, 1, 1,
+    4, 4, 4
+};
+
+// Одностраничный файл: списка страниц в куче нет
+const quint32 kNoPages = 0xFFFFFFFF;
+
+qint64 aligned(qint64 size)
+{
+    return (size + 7) & ~qint64(7);
+}
+
+qint64 headerSize(int columnCount)
+{
+    return aligned(HeaderLayout::Columns + qint64(columnCount) * 4);
+}
+
+// Поля записи, кроме пути и страниц: у них значения зависят от кучи блока
+void storeValue(uchar *p, int column, const ImageMetadata &m)
+{
+    const FormatDetails &d = m.details;
+    switch (column) {
+    case Bytes: qToLittleEndian<qint64>(m.bytes, p); break;
+    case Width: qToLittleEndian<quint32>(m.width, p); break;
+    case Height: qToLittleEndian<quint32>(m.height, p); break;
+    case DpiX: qToLittleEndian<quint32>(m.dpiX, p); break;
+    case DpiY: qToLittleEndian<quint32>(m.dpiY, p); break;
+    case PaletteColors: qToLittleEndian<quint32>(m.paletteColors, p); break;
+    case Depth: p[0] = m.depth; break;
+    case Format: p[0] = quint8(m.format); break;
+    case CompressionColumn: p[0] = quint8(m.compression); break;
+    case Error: p[0] = quint8(m.error); break;
+    case ContentFlags: p[0] = m.contentFlags; break;
+    case UniqueColors: qToLittleEndian<quint32>(m.uniqueColors, p); break;
+    case ChannelMin: std::memcpy(p, m.channelMin, 3); break;
+    case ChannelMax: std::memcpy(p, m.channelMax, 3); break;
+    case ChannelMean: std::memcpy(p, m.channelMean, 3); break;
+    case Luminance: std::memcpy(p, m.luminance, 16); break;
+    case PerceptualHash: qToLittleEndian<quint64>(m.perceptualHash, p); break;
+    case DataOffset: qToLittleEndian<quint32>(d.dataOffset, p); break;
+    case Frames: qToLittleEndian<quint32>(d.frames, p); break;
+    case CompressionCode: qToLittleEndian<quint16>(d.compressionCode, p); break;
+    case HeaderSize: qToLittleEndian<quint16>(d.headerSize, p); break;
+    case Chunks: qToLittleEndian<quint16>(d.chunks, p); break;
+    case ColorModel: p[0] = d.colorModel; break;
+    case SampleBits: p[0] = d.sampleBits; break;
+    case Sampling: p[0] = d.sampling; break;
+    case DetailFlags: p[0] = d.flags; break;
+    default: break;
+    }
+}
+
+void loadValue(const uchar *p, int column, ImageMetadata &m)
+{
+    FormatDetails &d = m.details;
+    switch (column) {
+    case Bytes: m.bytes = qFromLittleEndian<qint64>(p); break;
+    case Width: m.width = qFromLittleEndian<quint32>(p); break;
+    case Height: m.height = qFromLittleEndian<quint32>(p); break;
+    case DpiX: m.dpiX = qFromLittleEndian<quint32>(p); break;
+    case DpiY: m.dpiY = qFromLittleEndian<quint32>(p); break;
+    case PaletteColors: m.paletteColors = qFromLittleEndian<quint32>(p); break;
+    case Depth: m.depth = p[0]; break;
+    case Format: m.format = p[0] < quint8(ImageFormat::Count) ? ImageFormat(p[0]) : ImageFormat::Unknown; break;
+    case CompressionColumn:
+        m.compression = p[0] <= quint8(Compression::Other) ? Compression(p[0]) : Compression::Unknown;
+        break;
+    case Error: m.error = p[0] <= quint8(ImageError::NotAnalyzed) ? ImageError(p[0]) : ImageError::LoadFailed; break;
+    case ContentFlags: m.contentFlags = p[0]; break;
+    case UniqueColors: m.uniqueColors = qFromLittleEndian<quint32>(p); break;
+    case ChannelMin: std::memcpy(m.channelMin, p, 3); break;
+    case ChannelMax: std::memcpy(m.channelMax, p, 3); break;
+    case ChannelMean: std::memcpy(m.channelMean, p, 3); break;
+    case Luminance: std::memcpy(m.luminance, p, 16); break;
+    case PerceptualHash: m.perceptualHash = qFromLittleEndian<quint64>(p); break;
+    case DataOffset: d.dataOffset = qFromLittleEndian<quint32>(p); break;
+    case Frames: d.frames = qFromLittleEndian<quint32>(p); break;
+    case CompressionCode: d.compressionCode = qFromLittleEndian<quint16>(p); break;
+    case HeaderSize: d.headerSize = qFromLittleEndian<quint16>(p); break;
+    case Chunks: d.chunks = qFromLittleEndian<quint16>(p); break;
+    case ColorModel: d.colorModel = p[0]; break;
+    case SampleBits: d.sampleBits = p[0]; break;
+    case Sampling: d.sampling = p[0]; break;
+    case DetailFlags: d.flags = p[0]; break;
+    default: break;
+    }
+}
+
+} // namespace
+
+ResultStoreWriter::~ResultStoreWriter()
+{
+    if (isOpen()) finish();
+}
+
+bool ResultStoreWriter::open(const QString &filePath)
+{
+    if (isOpen()) finish();
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    QByteArray header(int(headerSize(ColumnCount)), '\0');
+    uchar *data = reinterpret_cast<uchar *>(header.data());
+    std::memcpy(data, kMagic, sizeof(kMagic));
+    qToLittleEndian<quint32>(kVersion, data + HeaderLayout::Version);
+    qToLittleEndian<quint32>(ColumnCount, data + HeaderLayout::ColumnCount);
+    for (int column = 0; column < ColumnCount; ++column) {
+        uchar *descriptor = data + HeaderLayout::Columns + column * 4;
+        qToLittleEndian<quint16>(quint16(column), descriptor);
+        qToLittleEndian<quint16>(kColumnWidths[column], descriptor + 2);
+    }
+
+    m_pending.clear();
+    m_pendingPaths.clear();
+    m_rowCount = 0;
+    return m_file.write(header) == header.size();
+}
+
+bool ResultStoreWriter::append(const ImageMetadata &metadata)
+{
+    if (!isOpen()) return false;
+
+    m_pending.append(metadata);
+    m_pendingPaths.append(metadata.filepath());
+    m_rowCount++;
+    return m_pending.size() < kBlockRows || writeBlock();
+}
+
+bool ResultStoreWriter::append(const QVector<ImageMetadata> &batch)
+{
+    for (const ImageMetadata &metadata : batch) {
+        if (!append(metadata)) return false;
+    }
+    return true;
+}
+
+bool ResultStoreWriter::finish()
+{
+    if (!isOpen()) return false;
+
+    bool ok = m_pending.isEmpty() || writeBlock();
+    ok = m_file.flush() && ok;
+    m_file.close();
+    return ok;
+}
+
+bool ResultStoreWriter::writeBlock()
+{
+    const int rows = m_pending.size();
+
+    // Куча: пути и списки страниц; смещения - от начала кучи блока
+    QByteArray heap;
+    QVector<quint32> pathOffsets(rows);
+    QVector<quint32> pathLengths(rows);
+    QVector<quint32> pagesOffsets(rows);
+    for (int row = 0; row < rows; ++row) {
+        const QByteArray utf8 = m_pendingPaths[row].toUtf8();
+        pathOffsets[row] = quint32(heap.size());
+        pathLengths[row] = quint32(utf8.size());
+        heap.append(utf8);
+
+        const ImageMetadata &metadata = m_pending[row];
+        pagesOffsets[row] = metadata.pageList ? quint32(heap.size()) : kNoPages;
+        if (metadata.pageList) MetadataRecord::appendPages(heap, *metadata.pageList);
+    }
+
+    qint64 size = BlockLayout::Size + aligned(heap.size());
+    for (int column = 0; column < ColumnCount; ++column) {
+        size += aligned(qint64(rows) * kColumnWidths[column]);
+    }
+
+    QByteArray block(int(size), '\0');
+    uchar *data = reinterpret_cast<uchar *>(block.data());
+    std::memcpy(data, kBlockMagic, sizeof(kBlockMagic));
+    qToLittleEndian<quint32>(quint32(rows), data + BlockLayout::RowCount);
+    qToLittleEndian<quint32>(quint32(heap.size()), data + BlockLayout::HeapSize);
+
+    // Столбец заполняется целиком, прежде чем перейти к следующему
+    uchar *column = data + BlockLayout::Size;
+    for (int id = 0; id < ColumnCount; ++id) {
+        const int width = kColumnWidths[id];
+        uchar *value = column;
+        for (int row = 0; row < rows; ++row, value += width) {
+            switch (id) {
+            case PathOffset: qToLittleEndian<quint32>(pathOffsets[row], value); break;
+            case PathLength: qToLittleEndian<quint32>(pathLengths[row], value); break;
+            case PagesOffset: qToLittleEndian<quint32>(pagesOffsets[row], value); break;
+            default: storeValue(value, id, m_pending[row]);
+            }
+        }
+        column += aligned(qint64(rows) * width);
+    }
+    std::memcpy(column, heap.constData(), size_t(heap.size()));
+
+    m_pending.clear();
+    m_pendingPaths.clear();
+    return m_file.write(block) == block.size();
+}
+
+bool ResultStoreWriter::save(const QString &filePath, const QVector<ImageMetadata> &results, QString *error)
+{
+    ResultStoreWriter writer;
+    bool ok = writer.open(filePath) && writer.append(results);
+    ok = writer.finish() && ok;
+    if (!ok && error) *error = writer.errorString();
+    return ok;
+}
+
+ResultStoreReader::~ResultStoreReader()
+{
+    close();
+}
+
+bool ResultStoreReader::open(const QString &filePath)
+{
+    close();
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    m_data = size >= HeaderLayout::Columns ? m_file.map(0, size) : nullptr;
+    if (!m_data || std::memcmp(m_data, kMagic, sizeof(kMagic)) != 0) {
+        m_error = "Файл не является файлом результатов анализа";
+        close();
+        return false;
+    }
+    if (qFromLittleEndian<quint32>(m_data + HeaderLayout::Version) > kVersion) {
+        m_error = "Файл результатов записан более новой версией программы";
+        close();
+        return false;
+    }
+
+    // Столбцы файла: известные сопоставляются по номеру, остальные пропускаются
+    const quint32 columnCount = qFromLittleEndian<quint32>(m_data + HeaderLayout::ColumnCount);
+    if (columnCount > 4096 || headerSize(int(columnCount)) > size) {
+        m_error = "Заголовок файла результатов поврежден";
+        close();
+        return false;
+    }
+    QVector<quint16> ids(static_cast<int>(columnCount));
+    QVector<quint16> widths(static_cast<int>(columnCount));
+    for (int i = 0; i < ids.size(); ++i) {
+        const uchar *descriptor = m_data + HeaderLayout::Columns + i * 4;
+        ids[i] = qFromLittleEndian<quint16>(descriptor);
+        widths[i] = qFromLittleEndian<quint16>(descriptor + 2);
+        if (ids[i] < ColumnCount && widths[i] != kColumnWidths[ids[i]]) {
+            m_error = "Заголовок файла результатов поврежден";
+            close();
+            return false;
+        }
+    }
+
+    // Блоки по порядку; неполный последний блок (запись прервана) отбрасывается
+    qint64 pos = headerSize(int(columnCount));
+    while (pos + BlockLayout::Size <= size) {
+        const uchar *data = m_data + pos;
+        if (std::memcmp(data, kBlockMagic, sizeof(kBlockMagic)) != 0) break;
+
+        Block block;
+        block.firstRow = m_rowCount;
+        block.rowCount = int(qFromLittleEndian<quint32>(data + BlockLayout::RowCount));
+        block.heapSize = qFromLittleEndian<quint32>(data + BlockLayout::HeapSize);
+        block.columns.fill(nullptr, ColumnCount);
+        if (block.rowCount <= 0 || block.rowCount > ResultStoreWriter::kBlockRows) break;
+
+        qint64 offset = BlockLayout::Size;
+        for (int i = 0; i < ids.size(); ++i) {
+            if (ids[i] < ColumnCount) block.columns[ids[i]] = data + offset;
+            offset += aligned(qint64(block.rowCount) * widths[i]);
+        }
+        block.heap = data + offset;
+        offset += aligned(block.heapSize);
+        if (pos + offset > size) break;
+
+        m_blocks.append(block);
+        m_rowCount += block.rowCount;
+        pos += offset;
+    }
+
+    return true;
+}
+
+void ResultStoreReader::close()
+{
+    if (m_data) m_file.unmap(m_data);
+    m_data = nullptr;
+    m_file.close();
+    m_blocks.clear();
+    m_rowCount = 0;
+}
+
+const ResultStoreReader::Block &ResultStoreReader::blockOf(int row) const
+{
+    auto it = std::upper_bound(m_blocks.cbegin(), m_blocks.cend(), row,
+                               [](int value, const Block &block) { return value < block.firstRow; });
+    return *(it - 1);
+}
+
+void ResultStoreReader::read(int row, ImageMetadata &metadata, QString &path) const
+{
+    const Block &block = blockOf(row);
+    const int index = row - block.firstRow;
+
+    metadata = ImageMetadata();
+    for (int column = 0; column < ColumnCount; ++column) {
+        const uchar *values = block.columns[column];
+        if (values) loadValue(values + qint64(index) * kColumnWidths[column], column, metadata);
+    }
+
+    path.clear();
+    if (block.columns[PathOffset] && block.columns[PathLength]) {
+        const quint32 offset = qFromLittleEndian<quint32>(block.columns[PathOffset] + index * 4);
+        const quint32 length = qFromLittleEndian<quint32>(block.columns[PathLength] + index * 4);
+        if (quint64(offset) + length <= block.heapSize) {
+            path = QString::fromUtf8(reinterpret_cast<const char *>(block.heap + offset), int(length));
+        }
+    }
+
+    if (block.columns[PagesOffset]) {
+        const quint32 offset = qFromLittleEndian<quint32>(block.columns[PagesOffset] + index * 4);
+        if (offset != kNoPages && offset < block.heapSize) {
+            MetadataRecord::readPages(block.heap + offset, block.heapSize - offset, metadata.pageList);
+        }
+    }
+}
+
+QVector<ImageMetadata> ResultStoreReader::readAll() const
+{
+    QVector<ImageMetadata> results(m_rowCount);
+    QString path;
+    for (int row = 0; row < m_rowCount; ++row) {
+        read(row, results[row], path);
+        results[row].pathId = PathPool::instance().intern(path);
+    }
+    return results;
+}
+
+bool ResultStoreReader::exportTo(QIODevice *device, ResultWriter::Format format) const
+{
+    if (!m_data) return false;
+
+    ResultWriter writer(device, format);
+    writer.writeHeader();
+
+    ImageMetadata metadata;
+    QString path;
+    for (int row = 0; row < m_rowCount; ++row) {
+        read(row, metadata, path);
+        writer.write(metadata, path);
+    }
+    writer.flush();
+    return true;
+}
+
+bool ResultStoreReader::load(const QString &filePath, QVector<ImageMetadata> &results, QString *error)
+{
+    ResultStoreReader reader;
+    if (!reader.open(filePath)) {
+        if (error) *error = reader.errorString();
+        return false;
+    }
+    results = reader.readAll();
+    return true;
+}
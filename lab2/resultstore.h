@@ -0,0 +1,93 @@
+#ifndef RESULTSTORE_H
+#define RESULTSTORE_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include "imagemetadata.h"
+#include "resultwriter.h"
+
+// Файл результатов анализа по столбцам. После заголовка со списком
+// столбцов (номер и ширина) идут блоки до kBlockRows строк: в блоке
+// каждый столбец - значения фиксированной ширины подряд (little-endian,
+// с выравниванием на 8 байт), затем куча блока с путями в UTF-8 и
+// списками страниц. Блоки дописываются по мере анализа, поэтому
+// оборванный файл читается до последнего целого блока.
+// Незнакомые столбцы при чтении пропускаются, отсутствующие - нули.
+class ResultStoreWriter
+{
+public:
+    static const int kBlockRows = 16384;
+
+    ResultStoreWriter() = default;
+    ~ResultStoreWriter();
+
+    bool open(const QString &filePath);
+    bool isOpen() const { return m_file.isOpen(); }
+
+    // Путь берется из PathPool; полный блок сразу записывается в файл
+    bool append(const ImageMetadata &metadata);
+    bool append(const QVector<ImageMetadata> &batch);
+
+    // Записывает неполный блок и закрывает файл
+    bool finish();
+
+    int rowCount() const { return m_rowCount; }
+    QString errorString() const { return m_file.errorString(); }
+
+    // Записать все результаты сразу
+    static bool save(const QString &filePath, const QVector<ImageMetadata> &results, QString *error = nullptr);
+
+private:
+    bool writeBlock();
+
+    QFile m_file;
+    QVector<ImageMetadata> m_pending;
+    QVector<QString> m_pendingPaths;
+    int m_rowCount = 0;
+};
+
+class ResultStoreReader
+{
+public:
+    ResultStoreReader() = default;
+    ~ResultStoreReader();
+
+    // Файл отображается в память; проверяются заголовок и границы блоков
+    bool open(const QString &filePath);
+    void close();
+
+    int rowCount() const { return m_rowCount; }
+    QString errorString() const { return m_error; }
+
+    // Строка без регистрации пути: pathId не заполняется
+    void read(int row, ImageMetadata &metadata, QString &path) const;
+
+    // Все строки с путями в PathPool - для таблицы и статистики
+    QVector<ImageMetadata> readAll() const;
+
+    // Потоковая выгрузка в CSV/JSON: строка за строкой из отображенного файла,
+    // без загрузки результатов в память
+    bool exportTo(QIODevice *device, ResultWriter::Format format) const;
+
+    static bool load(const QString &filePath, QVector<ImageMetadata> &results, QString *error = nullptr);
+
+private:
+    struct Block {
+        int firstRow = 0;
+        int rowCount = 0;
+        const uchar *heap = nullptr;
+        quint32 heapSize = 0;
+        QVector<const uchar *> columns;     // по номеру столбца, nullptr - нет в файле
+    };
+
+    const Block &blockOf(int row) const;
+
+    QFile m_file;
+    uchar *m_data = nullptr;
+    QVector<Block> m_blocks;
+    int m_rowCount = 0;
+    QString m_error;
+};
+
+#endif // RESULTSTORE_H
@@ -0,0 +1,199 @@
+#include "resultwriter.h"
+#include <QIODevice>
+
+namespace {
+
+const int kFlushThreshold = 64 * 1024;
+
+void appendJsonString(QByteArray &out, const QString &text)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out.append('"');
+    const QByteArray utf8 = text.toUtf8();
+    for (char c : utf8) {
+        switch (c) {
+        case '"': out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\t': out.append("\\t"); break;
+        default:
+            if (uchar(c) < 0x20) {
+                out.append("\\u00");
+                out.append(hex[uchar(c) >> 4]);
+                out.append(hex[uchar(c) & 0x0F]);
+            } else {
+                out.append(c);
+            }
+        }
+    }
+    out.append('"');
+}
+
+void appendCsvField(QByteArray &out, const QString &text)
+{
+    const QByteArray utf8 = text.toUtf8();
+    bool quote = utf8.contains(',') || utf8.contains('"') || utf8.contains('\n') || utf8.contains('\r');
+    if (!quote) {
+        out.append(utf8);
+        return;
+    }
+
+    out.append('"');
+    for (char c : utf8) {
+        if (c == '"') out.append('"');
+        out.append(c);
+    }
+    out.append('"');
+}
+
+void appendJsonArray(QByteArray &out, const quint8 *values, int count)
+{
+    out.append('[');
+    for (int i = 0; i < count; ++i) {
+        if (i > 0) out.append(',');
+        out.append(QByteArray::number(values[i]));
+    }
+    out.append(']');
+}
+
+// Страницы TIFF и кадры GIF: размеры, глубина, код сжатия TIFF, задержка GIF
+void appendJsonPages(QByteArray &out, const PageList &pageList)
+{
+    out.append('[');
+    for (int i = 0; i < pageList.pages.size(); ++i) {
+        const PageInfo &page = pageList.pages[i];
+        if (i > 0) out.append(',');
+        out.append("{\"width\":").append(QByteArray::number(page.width));
+        out.append(",\"height\":").append(QByteArray::number(page.height));
+        out.append(",\"depth\":").append(QByteArray::number(page.depth));
+        if (page.compressionCode) out.append(",\"compression_code\":").append(QByteArray::number(page.compressionCode));
+        if (page.delay) out.append(",\"delay_ms\":").append(QByteArray::number(page.delay * 10));
+        if (page.flags & PageInfo::Reduced) out.append(",\"reduced\":true");
+        out.append('}');
+    }
+    out.append(']');
+}
+
+// 16 шестнадцатеричных цифр с ведущими нулями: хэши сравниваются как строки
+QByteArray hashText(quint64 hash)
+{
+    return QByteArray::number(hash, 16).rightJustified(16, '0');
+}
+
+} // namespace
+
+ResultWriter::ResultWriter(QIODevice *device, Format format)
+    : m_device(device)
+    , m_format(format)
+{
+}
+
+bool ResultWriter::parseFormat(const QString &name, Format &format)
+{
+    if (name == "jsonl" || name == "json") {
+        format = JsonLines;
+        return true;
+    }
+    if (name == "csv") {
+        format = Csv;
+        return true;
+    }
+    return false;
+}
+
+void ResultWriter::writeHeader()
+{
+    if (m_format == Csv) {
+        m_buffer.append("path,format,width,height,dpi_x,dpi_y,depth,compression,palette_colors,bytes,error,"
+                        "unique_colors,grayscale,mean_r,mean_g,mean_b,phash,pages\n");
+    }
+}
+
+void ResultWriter::write(const ImageMetadata &metadata)
+{
+    write(metadata, metadata.filepath());
+}
+
+void ResultWriter::write(const ImageMetadata &metadata, const QString &path)
+{
+    if (m_format == JsonLines) {
+        m_buffer.append("{\"path\":");
+        appendJsonString(m_buffer, path);
+        m_buffer.append(",\"format\":");
+        appendJsonString(m_buffer, metadata.formatText());
+        m_buffer.append(",\"width\":").append(QByteArray::number(metadata.width));
+        m_buffer.append(",\"height\":").append(QByteArray::number(metadata.height));
+        m_buffer.append(",\"dpi_x\":").append(QByteArray::number(metadata.dpiX));
+        m_buffer.append(",\"dpi_y\":").append(QByteArray::number(metadata.dpiY));
+        m_buffer.append(",\"depth\":").append(QByteArray::number(metadata.depth));
+        m_buffer.append(",\"compression\":");
+        appendJsonString(m_buffer, ImageMetadata::compressionName(metadata.compression));
+        m_buffer.append(",\"palette_colors\":").append(QByteArray::number(metadata.paletteColors));
+        m_buffer.append(",\"bytes\":").append(QByteArray::number(metadata.bytes));
+        if (metadata.pageList) {
+            m_buffer.append(",\"pages\":").append(QByteArray::number(metadata.pageCount()));
+            m_buffer.append(",\"page_info\":");
+            appendJsonPages(m_buffer, *metadata.pageList);
+        }
+        if (metadata.hasError()) {
+            m_buffer.append(",\"error\":");
+            appendJsonString(m_buffer, metadata.errorText());
+        }
+        if (metadata.hasContent()) {
+            m_buffer.append(",\"unique_colors\":").append(QByteArray::number(metadata.uniqueColors));
+            m_buffer.append(",\"grayscale\":").append(metadata.isGrayscale() ? "true" : "false");
+            m_buffer.append(",\"min_rgb\":");
+            appendJsonArray(m_buffer, metadata.channelMin, 3);
+            m_buffer.append(",\"max_rgb\":");
+            appendJsonArray(m_buffer, metadata.channelMax, 3);
+            m_buffer.append(",\"mean_rgb\":");
+            appendJsonArray(m_buffer, metadata.channelMean, 3);
+            m_buffer.append(",\"luminance\":");
+            appendJsonArray(m_buffer, metadata.luminance, 16);
+        }
+        if (metadata.hasPerceptualHash()) {
+            m_buffer.append(",\"phash\":\"").append(hashText(metadata.perceptualHash)).append('"');
+        }
+        m_buffer.append("}\n");
+    } else {
+        appendCsvField(m_buffer, path);
+        m_buffer.append(',');
+        appendCsvField(m_buffer, metadata.formatText());
+        m_buffer.append(',').append(QByteArray::number(metadata.width));
+        m_buffer.append(',').append(QByteArray::number(metadata.height));
+        m_buffer.append(',').append(QByteArray::number(metadata.dpiX));
+        m_buffer.append(',').append(QByteArray::number(metadata.dpiY));
+        m_buffer.append(',').append(QByteArray::number(metadata.depth));
+        m_buffer.append(',');
+        appendCsvField(m_buffer, ImageMetadata::compressionName(metadata.compression));
+        m_buffer.append(',').append(QByteArray::number(metadata.paletteColors));
+        m_buffer.append(',').append(QByteArray::number(metadata.bytes));
+        m_buffer.append(',');
+        appendCsvField(m_buffer, metadata.errorText());
+        if (metadata.hasContent()) {
+            m_buffer.append(',').append(QByteArray::number(metadata.uniqueColors));
+            m_buffer.append(',').append(metadata.isGrayscale() ? "1" : "0");
+            for (int c = 0; c < 3; ++c) {
+                m_buffer.append(',').append(QByteArray::number(metadata.channelMean[c]));
+            }
+        } else {
+            m_buffer.append(",,,,,");
+        }
+        m_buffer.append(',');
+        if (metadata.hasPerceptualHash()) m_buffer.append(hashText(metadata.perceptualHash));
+        m_buffer.append(',').append(QByteArray::number(metadata.pageCount()));
+        m_buffer.append('\n');
+    }
+
+    if (m_buffer.size() >= kFlushThreshold) flush();
+}
+
+void ResultWriter::flush()
+{
+    if (!m_buffer.isEmpty()) {
+        m_device->write(m_buffer);
+        m_buffer.clear();
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef RESULTWRITER_H
+#define RESULTWRITER_H
+
+#include <QByteArray>
+#include "imagemetadata.h"
+
+class QIODevice;
+
+// Потоковая запись результатов: одна строка на файл, без накопления в памяти
+class ResultWriter
+{
+public:
+    enum Format {
+        JsonLines,
+        Csv
+    };
+
+    ResultWriter(QIODevice *device, Format format);
+
+    static bool parseFormat(const QString &name, Format &format);
+
+    void writeHeader();
+    void write(const ImageMetadata &metadata);
+    // Путь передается явно: записи из файла результатов не регистрируются в PathPool
+    void write(const ImageMetadata &metadata, const QString &path);
+    void flush();
+
+private:
+    QIODevice *m_device;
+    Format m_format;
+    QByteArray m_buffer;
+};
+
+#endif // RESULTWRITER_H
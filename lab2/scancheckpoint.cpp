@@ -0,0 +1,148 @@
+#include "scancheckpoint.h"
+#include "metadatarecord.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+// Версия в сигнатуре: журнал со старым форматом записей не читается
+const char kMagic[8] = {'I', 'M', 'G', 'C', 'K', 'P', 'T', '5'};
+
+// Перед каждой записью: размер, время изменения (мс) и inode файла
+const int kKeySize = 24;
+
+// Записи уходят на диск порциями: при аварии теряется не больше порции
+const int kFlushThreshold = 16 * 1024;
+
+} // namespace
+
+ScanCheckpoint::ScanCheckpoint(const QString &folderPath, bool recursive)
+{
+    // Имя журнала - хэш папки и режима обхода: разные режимы дают разные списки файлов
+    QByteArray key = QDir(folderPath).absolutePath().toUtf8() + (recursive ? "\n1" : "\n0");
+    QString name = QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex());
+
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    m_filePath = QDir(dir).filePath("checkpoints/" + name + ".ckpt");
+}
+
+ScanCheckpoint::~ScanCheckpoint()
+{
+    flush();
+}
+
+bool ScanCheckpoint::exists() const
+{
+    return QFileInfo(m_filePath).size() > qint64(sizeof(kMagic));
+}
+
+int ScanCheckpoint::load()
+{
+    QMutexLocker locker(&m_mutex);
+    m_previous.clear();
+
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) return 0;
+
+    const QByteArray data = file.readAll();
+    if (data.size() < int(sizeof(kMagic)) || std::memcmp(data.constData(), kMagic, sizeof(kMagic)) != 0) {
+        return 0;
+    }
+
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+    qint64 pos = sizeof(kMagic);
+    QString path;
+    Entry entry;
+    for (;;) {
+        qint64 recordPos = pos + kKeySize;
+        if (recordPos > data.size()) break;
+        if (!MetadataRecord::read(bytes, data.size(), recordPos, path, entry.metadata)) break;
+        entry.key.size = qFromLittleEndian<qint64>(bytes + pos);
+        entry.key.modified = qFromLittleEndian<qint64>(bytes + pos + 8);
+        entry.key.inode = qFromLittleEndian<quint64>(bytes + pos + 16);
+        m_previous.insert(path, entry);
+        pos = recordPos;
+    }
+
+    // Оборванный хвост отрезается, чтобы дописывать после целых записей
+    if (pos < data.size()) {
+        file.close();
+        QFile::resize(m_filePath, pos);
+    }
+    return m_previous.size();
+}
+
+bool ScanCheckpoint::take(const QString &path, ImageMetadata &metadata)
+{
+    Entry entry;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_previous.find(path);
+        if (it == m_previous.end()) return false;
+        entry = it.value();
+        m_previous.erase(it);
+    }
+
+    // Журнал мог пролежать дни: замененный или измененный файл читается заново.
+    // stat - вне мьютекса, его ждут потоки, дописывающие журнал
+    if (!(entry.key == MetadataCache::fileKey(QFileInfo(path)))) return false;
+    metadata = entry.metadata;
+    return true;
+}
+
+bool ScanCheckpoint::begin(bool resume)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!resume) m_previous.clear();
+
+    QDir().mkpath(QFileInfo(m_filePath).absolutePath());
+    m_file.setFileName(m_filePath);
+
+    bool append = resume && exists();
+    if (!m_file.open(append ? QIODevice::Append : QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    if (!append) m_file.write(kMagic, sizeof(kMagic));
+    return true;
+}
+
+void ScanCheckpoint::append(const QString &path, const MetadataCache::FileKey &key,
+                            const ImageMetadata &metadata)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_file.isOpen()) return;
+
+    uchar keyBytes[kKeySize];
+    qToLittleEndian<qint64>(key.size, keyBytes);
+    qToLittleEndian<qint64>(key.modified, keyBytes + 8);
+    qToLittleEndian<quint64>(key.inode, keyBytes + 16);
+    m_buffer.append(reinterpret_cast<const char *>(keyBytes), kKeySize);
+    MetadataRecord::append(m_buffer, path, metadata);
+    if (m_buffer.size() >= kFlushThreshold) flushLocked();
+}
+
+void ScanCheckpoint::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    flushLocked();
+}
+
+void ScanCheckpoint::flushLocked()
+{
+    if (m_buffer.isEmpty() || !m_file.isOpen()) return;
+
+    m_file.write(m_buffer);
+    m_file.flush();
+    m_buffer.clear();
+}
+
+void ScanCheckpoint::remove()
+{
+    QMutexLocker locker(&m_mutex);
+    m_buffer.clear();
+    m_previous.clear();
+    m_file.close();
+    QFile::remove(m_filePath);
+}
@@ -0,0 +1,55 @@
+#ifndef SCANCHECKPOINT_H
+#define SCANCHECKPOINT_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include "imagemetadata.h"
+#include "metadatacache.h"
+
+// Журнал уже обработанных файлов папки. Пишется по ходу сканирования;
+// при отмене остается на диске, и следующий запуск по той же папке может
+// продолжить с места остановки, не читая эти файлы заново. Запись хранит
+// размер, время изменения и inode файла, как кэш метаданных: файл, измененный
+// после прерванного запуска, анализируется заново.
+// После полного завершения удаляется.
+class ScanCheckpoint
+{
+public:
+    ScanCheckpoint(const QString &folderPath, bool recursive);
+    ~ScanCheckpoint();
+
+    bool exists() const;
+
+    // Загружает записи прошлого запуска, возвращает их число
+    int load();
+    // Запись прошлого запуска для пути, если файл с тех пор не менялся;
+    // найденная запись забирается
+    bool take(const QString &path, ImageMetadata &metadata);
+
+    // Открывает журнал: resume - дописывать к прошлому, иначе начать заново
+    bool begin(bool resume);
+    void append(const QString &path, const MetadataCache::FileKey &key, const ImageMetadata &metadata);
+    void flush();
+    void remove();
+
+private:
+    Q_DISABLE_COPY(ScanCheckpoint)
+
+    struct Entry {
+        MetadataCache::FileKey key;
+        ImageMetadata metadata;
+    };
+
+    void flushLocked();
+
+    QString m_filePath;
+    QMutex m_mutex;
+    QFile m_file;
+    QByteArray m_buffer;
+    QHash<QString, Entry> m_previous;
+};
+
+#endif // SCANCHECKPOINT_H
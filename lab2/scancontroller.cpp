@@ -0,0 +1,30 @@
+#include "scancontroller.h"
+
+void ScanController::pause()
+{
+    int expected = Running;
+    m_state.compare_exchange_strong(expected, Paused, std::memory_order_acq_rel);
+}
+
+void ScanController::resume()
+{
+    int expected = Paused;
+    if (m_state.compare_exchange_strong(expected, Running, std::memory_order_acq_rel)) {
+        QMutexLocker locker(&m_mutex);
+        m_resumed.wakeAll();
+    }
+}
+
+bool ScanController::waitIfPaused()
+{
+    State current = state();
+    if (current == Running) return true;
+
+    // Отмена не будит ожидающих (она вызывается и из обработчика сигнала),
+    // поэтому ожидание с таймаутом
+    QMutexLocker locker(&m_mutex);
+    while ((current = state()) == Paused) {
+        m_resumed.wait(&m_mutex, 100);
+    }
+    return current != Cancelled;
+}
@@ -0,0 +1,42 @@
+#ifndef SCANCONTROLLER_H
+#define SCANCONTROLLER_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+
+// Управление идущим сканированием: отмена, пауза и продолжение.
+// Состояние атомарное, проверки дешевые и допустимы во внутренних циклах.
+class ScanController
+{
+public:
+    enum State {
+        Running,
+        Paused,
+        Cancelled
+    };
+
+    // Только атомарная запись: можно вызывать из обработчика сигнала ОС
+    void cancel() { m_state.store(Cancelled, std::memory_order_release); }
+
+    void pause();
+    void resume();
+
+    // Перед новым сканированием
+    void reset() { m_state.store(Running, std::memory_order_release); }
+
+    State state() const { return State(m_state.load(std::memory_order_acquire)); }
+    bool isCancelled() const { return state() == Cancelled; }
+    bool isPaused() const { return state() == Paused; }
+
+    // Точка остановки между файлами: ждет, пока стоит пауза.
+    // false - сканирование отменено.
+    bool waitIfPaused();
+
+private:
+    std::atomic<int> m_state{Running};
+    QMutex m_mutex;
+    QWaitCondition m_resumed;
+};
+
+#endif // SCANCONTROLLER_H
@@ -0,0 +1,196 @@
+#include "scanprofiler.h"
+#include <QSaveFile>
+
+namespace {
+
+// Поколение уникально для каждого reset() любого профайлера, поэтому
+// закэшированный в потоке указатель не переживает сброс
+std::atomic<quint64> nextGeneration{1};
+
+struct ThreadSlot {
+    const void *owner = nullptr;
+    quint64 generation = 0;
+    void *data = nullptr;
+};
+
+thread_local ThreadSlot currentSlot;
+
+void appendMicroseconds(QByteArray &out, qint64 nanoseconds)
+{
+    out.append(QByteArray::number(nanoseconds / 1000.0, 'f', 3));
+}
+
+} // namespace
+
+ScanProfiler::ScanProfiler()
+{
+    reset();
+}
+
+ScanProfiler::~ScanProfiler() = default;
+
+QString ScanProfiler::stageName(Stage stage)
+{
+    switch (stage) {
+    case Listing: return "Поиск файлов";
+    case Stat: return "Атрибуты и кэш";
+    case Probe: return "Чтение заголовка";
+    case Decode: return "Декодирование";
+    case Pixels: return "Анализ пикселей";
+    case Hash: return "Перцептивный хэш";
+    case Delivery: return "Выдача результатов";
+    case TableUpdate: return "Обновление таблицы";
+    default: return QString();
+    }
+}
+
+const char *ScanProfiler::stageId(Stage stage)
+{
+    switch (stage) {
+    case Listing: return "listing";
+    case Stat: return "stat";
+    case Probe: return "probe";
+    case Decode: return "decode";
+    case Pixels: return "pixels";
+    case Hash: return "hash";
+    case Delivery: return "delivery";
+    case TableUpdate: return "table_update";
+    default: return "unknown";
+    }
+}
+
+void ScanProfiler::reset()
+{
+    QMutexLocker locker(&m_threadsMutex);
+    m_threads.clear();
+    m_generation = nextGeneration.fetch_add(1, std::memory_order_relaxed);
+    m_clock.start();
+}
+
+ScanProfiler::ThreadData *ScanProfiler::threadData()
+{
+    ThreadSlot &slot = currentSlot;
+    if (slot.owner == this && slot.generation == m_generation) {
+        return static_cast<ThreadData *>(slot.data);
+    }
+
+    // Первое событие потока: регистрируем его журнал
+    QMutexLocker locker(&m_threadsMutex);
+    std::unique_ptr<ThreadData> data(new ThreadData);
+    data->index = int(m_threads.size()) + 1;
+
+    slot.owner = this;
+    slot.generation = m_generation;
+    slot.data = data.get();
+
+    m_threads.push_back(std::move(data));
+    return m_threads.back().get();
+}
+
+void ScanProfiler::record(Stage stage, qint64 startNs)
+{
+    qint64 duration = now() - startNs;
+
+    ThreadData *data = threadData();
+    data->histograms[stage].record(duration);
+
+    const int count = data->eventCount.load(std::memory_order_relaxed);
+    if (count < kMaxEventsPerThread) {
+        std::unique_ptr<Event[]> &block = data->events[count / kEventBlockSize];
+        if (!block) block.reset(new Event[kEventBlockSize]);
+        block[count % kEventBlockSize] = Event{startNs, duration, stage};
+        data->eventCount.store(count + 1, std::memory_order_release);
+    } else {
+        data->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+ScanProfiler::StageTotals ScanProfiler::stage(Stage stage) const
+{
+    LatencyHistogram histogram;
+    {
+        QMutexLocker locker(&m_threadsMutex);
+        for (const std::unique_ptr<ThreadData> &data : m_threads) {
+            histogram.merge(data->histograms[stage]);
+        }
+    }
+
+    StageTotals totals;
+    totals.count = histogram.count();
+    totals.totalNs = histogram.total();
+    totals.p50Ns = histogram.percentile(50);
+    totals.p99Ns = histogram.percentile(99);
+    totals.maxNs = histogram.max();
+    return totals;
+}
+
+QVector<ScanProfiler::ThreadTotals> ScanProfiler::threads() const
+{
+    QMutexLocker locker(&m_threadsMutex);
+
+    QVector<ThreadTotals> result;
+    result.reserve(int(m_threads.size()));
+    for (const std::unique_ptr<ThreadData> &data : m_threads) {
+        ThreadTotals totals;
+        totals.index = data->index;
+        for (int i = 0; i < StageCount; ++i) {
+            totals.count[i] = data->histograms[i].count();
+            totals.totalNs[i] = data->histograms[i].total();
+        }
+        result.append(totals);
+    }
+    return result;
+}
+
+quint64 ScanProfiler::droppedEvents() const
+{
+    QMutexLocker locker(&m_threadsMutex);
+
+    quint64 dropped = 0;
+    for (const std::unique_ptr<ThreadData> &data : m_threads) {
+        dropped += data->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+bool ScanProfiler::writeChromeTrace(const QString &filePath) const
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+
+    QMutexLocker locker(&m_threadsMutex);
+
+    QByteArray buffer;
+    buffer.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+
+    for (const std::unique_ptr<ThreadData> &data : m_threads) {
+        QByteArray tid = QByteArray::number(data->index);
+
+        if (!first) buffer.append(",\n");
+        first = false;
+        buffer.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":").append(tid);
+        buffer.append(",\"args\":{\"name\":\"thread ").append(tid).append("\"}}");
+
+        const int eventCount = data->eventCount.load(std::memory_order_acquire);
+        for (int i = 0; i < eventCount; ++i) {
+            const Event &event = data->events[i / kEventBlockSize][i % kEventBlockSize];
+            buffer.append(",\n{\"name\":\"").append(stageId(event.stage));
+            buffer.append("\",\"cat\":\"scan\",\"ph\":\"X\",\"pid\":1,\"tid\":").append(tid);
+            buffer.append(",\"ts\":");
+            appendMicroseconds(buffer, event.start);
+            buffer.append(",\"dur\":");
+            appendMicroseconds(buffer, event.duration);
+            buffer.append('}');
+
+            if (buffer.size() >= 64 * 1024) {
+                if (file.write(buffer) != buffer.size()) return false;
+                buffer.clear();
+            }
+        }
+    }
+    buffer.append("\n]}\n");
+
+    if (file.write(buffer) != buffer.size()) return false;
+    return file.commit();
+}
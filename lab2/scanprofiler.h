@@ -0,0 +1,111 @@
+#ifndef SCANPROFILER_H
+#define SCANPROFILER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "latencyhistogram.h"
+
+// Профилирование этапов сканирования: счетчики и гистограммы по этапам,
+// счетчики по потокам и журнал событий для chrome://tracing (Perfetto).
+// Запись без общих блокировок: у каждого потока свои гистограммы и журнал,
+// гистограммы этапов складываются при чтении.
+class ScanProfiler
+{
+public:
+    enum Stage {
+        Listing,      // перечисление каталога
+        Stat,         // stat файла и поиск в кэше
+        Probe,        // открытие файла и разбор заголовка
+        Decode,       // полное декодирование через QImage
+        Pixels,       // статистика пикселей (глубокий анализ)
+        Hash,         // перцептивный хэш (поиск дубликатов)
+        Delivery,     // сборка пакета и отправка сигнала
+        TableUpdate,  // добавление пакета в модель таблицы
+        StageCount
+    };
+
+    struct StageTotals {
+        quint64 count = 0;
+        qint64 totalNs = 0;
+        qint64 p50Ns = 0;
+        qint64 p99Ns = 0;
+        qint64 maxNs = 0;
+    };
+
+    struct ThreadTotals {
+        int index = 0;
+        quint64 count[StageCount] = {};
+        qint64 totalNs[StageCount] = {};
+    };
+
+    // Замер от создания до разрушения; с nullptr ничего не делает
+    class Scope
+    {
+    public:
+        Scope(ScanProfiler *profiler, Stage stage)
+            : m_profiler(profiler), m_stage(stage), m_start(profiler ? profiler->now() : 0) {}
+        ~Scope() { if (m_profiler) m_profiler->record(m_stage, m_start); }
+
+    private:
+        ScanProfiler *m_profiler;
+        Stage m_stage;
+        qint64 m_start;
+    };
+
+    ScanProfiler();
+    ~ScanProfiler();
+
+    static QString stageName(Stage stage);
+    static const char *stageId(Stage stage);
+
+    // Только между сканированиями: журналы потоков освобождаются
+    void reset();
+
+    qint64 now() const { return m_clock.nsecsElapsed(); }
+    void record(Stage stage, qint64 startNs);
+
+    StageTotals stage(Stage stage) const;
+    QVector<ThreadTotals> threads() const;
+    quint64 droppedEvents() const;
+
+    // Журнал в формате Chrome Trace Event. Можно вызывать во время анализа
+    // (например, при наблюдении за папкой): выгружаются события, записанные
+    // к началу вызова
+    bool writeChromeTrace(const QString &filePath) const;
+
+private:
+    struct Event {
+        qint64 start;
+        qint64 duration;
+        Stage stage;
+    };
+
+    static const int kMaxEventsPerThread = 200000;
+    static const int kEventBlockSize = 4096;
+    static const int kEventBlocks = (kMaxEventsPerThread + kEventBlockSize - 1) / kEventBlockSize;
+
+    // Пишет только свой поток. Журнал хранится блоками, которые не перемещаются:
+    // выгрузка читает опубликованные eventCount события, пока поток пишет следующие
+    struct ThreadData {
+        int index = 0;
+        LatencyHistogram histograms[StageCount];
+        std::unique_ptr<Event[]> events[kEventBlocks];
+        std::atomic<int> eventCount{0};
+        std::atomic<quint64> dropped{0};
+    };
+
+    ThreadData *threadData();
+
+    QElapsedTimer m_clock;
+    quint64 m_generation = 0;
+
+    mutable QMutex m_threadsMutex;
+    std::vector<std::unique_ptr<ThreadData>> m_threads;
+};
+
+#endif // SCANPROFILER_H
@@ -0,0 +1,138 @@
+#include "scanstatistics.h"
+#include <algorithm>
+
+namespace {
+
+// Топ с запасом: удаленный из топа файл замещается следующим без пересчета
+const int kTopReserve = ScanStatistics::kTopFiles * 4;
+
+bool largerFile(const ScanStatistics::FileEntry &a, const ScanStatistics::FileEntry &b)
+{
+    return a.bytes > b.bytes;
+}
+
+} // namespace
+
+void ScanStatistics::add(const ImageMetadata &metadata)
+{
+    m_fileCount++;
+    m_totalBytes += metadata.bytes;
+    m_totalPages += metadata.pageCount();
+    if (metadata.pageCount() > 1) m_multiPageFiles++;
+
+    FormatTotals &format = m_formats[int(metadata.format)];
+    format.files++;
+    format.bytes += metadata.bytes;
+
+    if (!metadata.hasError() && metadata.pixels() > 0) {
+        quint64 pixels = metadata.pixels();
+
+        if (pixels < 100000) m_buckets[SmallImages]++;
+        else if (pixels < 1000000) m_buckets[MediumImages]++;
+        else if (pixels < 10000000) m_buckets[LargeImages]++;
+        else m_buckets[HugeImages]++;
+
+        if (pixels > quint64(m_maxWidth) * m_maxHeight) {
+            m_maxWidth = metadata.width;
+            m_maxHeight = metadata.height;
+            m_largestImage = metadata.pathId;
+        }
+    }
+
+    addTopFile({metadata.bytes, metadata.pathId});
+}
+
+void ScanStatistics::addTopFile(const FileEntry &entry)
+{
+    // Топ-K за O(log K): новый файл заменяет наименьший в куче
+    if (int(m_topFiles.size()) < kTopReserve) {
+        m_topFiles.push_back(entry);
+        std::push_heap(m_topFiles.begin(), m_topFiles.end(), largerFile);
+    } else if (entry.bytes > m_topFiles.front().bytes) {
+        std::pop_heap(m_topFiles.begin(), m_topFiles.end(), largerFile);
+        m_topFloor = qMax(m_topFloor, m_topFiles.back().bytes);
+        m_topFiles.back() = entry;
+        std::push_heap(m_topFiles.begin(), m_topFiles.end(), largerFile);
+    } else {
+        m_topFloor = qMax(m_topFloor, entry.bytes);
+    }
+}
+
+void ScanStatistics::remove(const ImageMetadata &metadata)
+{
+    m_fileCount--;
+    m_totalBytes -= metadata.bytes;
+    m_totalPages -= metadata.pageCount();
+    if (metadata.pageCount() > 1) m_multiPageFiles--;
+
+    FormatTotals &format = m_formats[int(metadata.format)];
+    format.files--;
+    format.bytes -= metadata.bytes;
+
+    if (!metadata.hasError() && metadata.pixels() > 0) {
+        quint64 pixels = metadata.pixels();
+
+        if (pixels < 100000) m_buckets[SmallImages]--;
+        else if (pixels < 1000000) m_buckets[MediumImages]--;
+        else if (pixels < 10000000) m_buckets[LargeImages]--;
+        else m_buckets[HugeImages]--;
+
+        if (metadata.pathId == m_largestImage) m_needsRebuild = true;
+    }
+
+    // Файлы кучи не меньше m_topFloor - точно лучшие из всех. Пересчет нужен,
+    // только если таких стало меньше показываемых.
+    auto entry = std::find_if(m_topFiles.begin(), m_topFiles.end(), [&metadata](const FileEntry &file) {
+        return file.pathId == metadata.pathId;
+    });
+    if (entry != m_topFiles.end()) {
+        m_topFiles.erase(entry);
+        std::make_heap(m_topFiles.begin(), m_topFiles.end(), largerFile);
+        const qint64 floor = m_topFloor;
+        auto exact = std::count_if(m_topFiles.begin(), m_topFiles.end(), [floor](const FileEntry &file) {
+            return file.bytes >= floor;
+        });
+        if (m_topFloor >= 0 && exact < kTopFiles) m_needsRebuild = true;
+    }
+}
+
+void ScanStatistics::merge(const ScanStatistics &other)
+{
+    m_fileCount += other.m_fileCount;
+    m_totalBytes += other.m_totalBytes;
+    m_totalPages += other.m_totalPages;
+    m_multiPageFiles += other.m_multiPageFiles;
+
+    for (int i = 0; i < int(ImageFormat::Count); ++i) {
+        m_formats[i].files += other.m_formats[i].files;
+        m_formats[i].bytes += other.m_formats[i].bytes;
+    }
+    for (int i = 0; i < BucketCount; ++i) {
+        m_buckets[i] += other.m_buckets[i];
+    }
+
+    if (quint64(other.m_maxWidth) * other.m_maxHeight > quint64(m_maxWidth) * m_maxHeight) {
+        m_maxWidth = other.m_maxWidth;
+        m_maxHeight = other.m_maxHeight;
+        m_largestImage = other.m_largestImage;
+    }
+
+    m_topFloor = qMax(m_topFloor, other.m_topFloor);
+    for (const FileEntry &entry : other.m_topFiles) {
+        addTopFile(entry);
+    }
+    m_needsRebuild = m_needsRebuild || other.m_needsRebuild;
+}
+
+void ScanStatistics::clear()
+{
+    *this = ScanStatistics();
+}
+
+QVector<ScanStatistics::FileEntry> ScanStatistics::largestFiles() const
+{
+    QVector<FileEntry> files(m_topFiles.begin(), m_topFiles.end());
+    std::sort(files.begin(), files.end(), largerFile);
+    if (files.size() > kTopFiles) files.resize(kTopFiles);
+    return files;
+}
@@ -0,0 +1,84 @@
+#ifndef SCANSTATISTICS_H
+#define SCANSTATISTICS_H
+
+#include <QVector>
+#include <vector>
+#include "imagemetadata.h"
+
+// Накопитель статистики: каждый результат учитывается один раз,
+// без повторного обхода всех файлов. Счетчики можно и уменьшать
+// (файл удален или изменен). Топ хранится с запасом, и удаление из него
+// пересчета не требует, пока в запасе остается kTopFiles файлов; удаление
+// самого большого изображения требует пересчета по всем записям.
+class ScanStatistics
+{
+public:
+    static const int kTopFiles = 5;
+
+    enum SizeBucket {
+        SmallImages,    // < 100K пикселей
+        MediumImages,   // 100K-1M
+        LargeImages,    // 1M-10M
+        HugeImages,     // > 10M
+        BucketCount
+    };
+
+    struct FormatTotals {
+        int files = 0;
+        qint64 bytes = 0;
+    };
+
+    struct FileEntry {
+        qint64 bytes = 0;
+        quint32 pathId = 0;
+    };
+
+    void add(const ImageMetadata &metadata);
+    void remove(const ImageMetadata &metadata);
+    void clear();
+
+    // Прибавляет статистику другой части сканирования (например, процесса
+    // анализа): счетчики складываются, максимумы и топ выбираются из обеих
+    void merge(const ScanStatistics &other);
+
+    // После удаления самого большого изображения или исчерпания запаса топа
+    bool needsRebuild() const { return m_needsRebuild; }
+
+    int fileCount() const { return m_fileCount; }
+    qint64 totalBytes() const { return m_totalBytes; }
+    const FormatTotals &format(ImageFormat format) const { return m_formats[int(format)]; }
+    int bucketCount(SizeBucket bucket) const { return m_buckets[bucket]; }
+
+    // Страницы TIFF и кадры GIF; у одностраничного файла одна страница
+    qint64 totalPages() const { return m_totalPages; }
+    int multiPageFiles() const { return m_multiPageFiles; }
+
+    quint32 maxWidth() const { return m_maxWidth; }
+    quint32 maxHeight() const { return m_maxHeight; }
+    quint32 largestImage() const { return m_largestImage; }
+
+    // Самые большие файлы по убыванию размера
+    QVector<FileEntry> largestFiles() const;
+
+private:
+    void addTopFile(const FileEntry &entry);
+
+    int m_fileCount = 0;
+    qint64 m_totalBytes = 0;
+    FormatTotals m_formats[int(ImageFormat::Count)];
+    int m_buckets[BucketCount] = {};
+    qint64 m_totalPages = 0;
+    int m_multiPageFiles = 0;
+
+    quint32 m_maxWidth = 0;
+    quint32 m_maxHeight = 0;
+    quint32 m_largestImage = 0;    // номер пути в PathPool
+    bool m_needsRebuild = false;
+
+    // Куча с минимумом в вершине: вытесняется наименьший из лучших.
+    // Хранит больше kTopFiles файлов - запас на удаления.
+    std::vector<FileEntry> m_topFiles;
+    qint64 m_topFloor = -1;        // наибольший из не попавших в кучу, -1 - таких нет
+};
+
+#endif // SCANSTATISTICS_H
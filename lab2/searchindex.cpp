@@ -0,0 +1,448 @@
+#include "searchindex.h"
+#include <QtAlgorithms>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+namespace {
+
+// Проход по столбцу: результат сравнения каждого значения собирается в
+// слово по 64 строки и накладывается на маску. Цикл без ветвлений
+// компилятор векторизует.
+template <typename T, typename Compare>
+void filterColumn(const QVector<T> &column, quint64 operand, Compare compare, QVector<quint64> &words)
+{
+    const T *values = column.constData();
+    const int count = column.size();
+
+    for (int w = 0; w < words.size(); ++w) {
+        if (!words[w]) continue;
+
+        const int base = w * 64;
+        const int n = qMin(64, count - base);
+        quint64 bits = 0;
+        for (int i = 0; i < n; ++i) {
+            bits |= quint64(compare(quint64(values[base + i]), operand)) << i;
+        }
+        words[w] &= bits;
+    }
+}
+
+template <typename T>
+void filterColumn(const QVector<T> &column, FilterQuery::Op op, quint64 operand, QVector<quint64> &words)
+{
+    switch (op) {
+    case FilterQuery::Less: filterColumn(column, operand, std::less<quint64>(), words); break;
+    case FilterQuery::LessEqual: filterColumn(column, operand, std::less_equal<quint64>(), words); break;
+    case FilterQuery::Greater: filterColumn(column, operand, std::greater<quint64>(), words); break;
+    case FilterQuery::GreaterEqual: filterColumn(column, operand, std::greater_equal<quint64>(), words); break;
+    case FilterQuery::Equal: filterColumn(column, operand, std::equal_to<quint64>(), words); break;
+    case FilterQuery::NotEqual: filterColumn(column, operand, std::not_equal_to<quint64>(), words); break;
+    }
+}
+
+void andBitmap(QVector<quint64> &words, const QVector<quint64> &mask)
+{
+    for (int i = 0; i < words.size(); ++i) {
+        words[i] &= i < mask.size() ? mask[i] : 0;
+    }
+}
+
+void orBitmap(QVector<quint64> &words, const QVector<quint64> &source)
+{
+    for (int i = 0; i < source.size() && i < words.size(); ++i) {
+        words[i] |= source[i];
+    }
+}
+
+bool testBit(const QVector<quint64> &words, int row)
+{
+    return (words[row >> 6] >> (row & 63)) & 1;
+}
+
+void setBit(QVector<quint64> &words, int row)
+{
+    words[row >> 6] |= quint64(1) << (row & 63);
+}
+
+} // namespace
+
+void RowBitmap::set(int row)
+{
+    int word = row >> 6;
+    if (word >= m_words.size()) m_words.resize(word + 1);
+    m_words[word] |= quint64(1) << (row & 63);
+}
+
+void RowBitmap::reset(int row)
+{
+    int word = row >> 6;
+    if (word < m_words.size()) m_words[word] &= ~(quint64(1) << (row & 63));
+}
+
+bool RowBitmap::test(int row) const
+{
+    int word = row >> 6;
+    return word < m_words.size() && (m_words[word] >> (row & 63)) & 1;
+}
+
+quint64 SearchIndex::trigram(const QChar *chars)
+{
+    return (quint64(chars[0].unicode()) << 32) | (quint64(chars[1].unicode()) << 16) | chars[2].unicode();
+}
+
+void SearchIndex::setColumns(int row, const ImageMetadata &metadata)
+{
+    m_names[row] = metadata.filename().toLower();
+    m_formats[row] = metadata.format;
+    m_compressions[row] = metadata.hasError() ? Compression::Unknown : metadata.compression;
+    m_widths[row] = metadata.width;
+    m_heights[row] = metadata.height;
+    m_pixels[row] = metadata.pixels();
+    m_dpi[row] = metadata.dpiX;
+    m_bytes[row] = quint64(qMax<qint64>(metadata.bytes, 0));
+    m_depths[row] = metadata.depth;
+    // После глубокого анализа - настоящее число цветов, иначе размер палитры
+    m_colors[row] = metadata.hasContent() ? metadata.uniqueColors : metadata.paletteColors;
+    m_pages[row] = quint32(metadata.pageCount());
+}
+
+void SearchIndex::indexRow(int row)
+{
+    m_formatRows[int(m_formats[row])].set(row);
+    m_depthRows[m_depths[row]].set(row);
+    if (m_compressions[row] != Compression::Unknown) m_compressionRows[int(m_compressions[row])].set(row);
+}
+
+void SearchIndex::unindexRow(int row)
+{
+    m_formatRows[int(m_formats[row])].reset(row);
+    m_depthRows[m_depths[row]].reset(row);
+    m_compressionRows[int(m_compressions[row])].reset(row);
+}
+
+void SearchIndex::indexName(int row)
+{
+    // Списки строк отсортированы; при дописывании вставка идет в конец
+    const QString &name = m_names[row];
+    for (int i = 0; i + 3 <= name.size(); ++i) {
+        QVector<int> &rows = m_trigrams[trigram(name.constData() + i)];
+        if (rows.isEmpty() || rows.last() < row) {
+            rows.append(row);
+            continue;
+        }
+        auto it = std::lower_bound(rows.begin(), rows.end(), row);
+        if (*it != row) rows.insert(it, row);
+    }
+}
+
+void SearchIndex::unindexName(int row)
+{
+    const QString &name = m_names[row];
+    for (int i = 0; i + 3 <= name.size(); ++i) {
+        auto list = m_trigrams.find(trigram(name.constData() + i));
+        if (list == m_trigrams.end()) continue;
+
+        QVector<int> &rows = list.value();
+        auto it = std::lower_bound(rows.begin(), rows.end(), row);
+        if (it != rows.end() && *it == row) rows.erase(it);
+        if (rows.isEmpty()) m_trigrams.erase(list);
+    }
+}
+
+void SearchIndex::append(const QVector<ImageMetadata> &batch)
+{
+    QWriteLocker locker(&m_lock);
+
+    int first = m_names.size();
+    int count = first + batch.size();
+    m_names.resize(count);
+    m_formats.resize(count);
+    m_compressions.resize(count);
+    m_widths.resize(count);
+    m_heights.resize(count);
+    m_pixels.resize(count);
+    m_dpi.resize(count);
+    m_bytes.resize(count);
+    m_depths.resize(count);
+    m_colors.resize(count);
+    m_pages.resize(count);
+
+    for (int i = 0; i < batch.size(); ++i) {
+        setColumns(first + i, batch.at(i));
+        indexName(first + i);
+        indexRow(first + i);
+    }
+}
+
+void SearchIndex::update(int row, const ImageMetadata &metadata)
+{
+    QWriteLocker locker(&m_lock);
+
+    // Новое поколение: прежние результаты поиска для этой строки неверны
+    m_generation++;
+    unindexRow(row);
+    const bool renamed = m_names[row] != metadata.filename().toLower();
+    if (renamed) unindexName(row);
+    setColumns(row, metadata);
+    if (renamed) indexName(row);
+    indexRow(row);
+}
+
+void SearchIndex::remove(int row)
+{
+    QWriteLocker locker(&m_lock);
+
+    m_generation++;
+    const int last = m_names.size() - 1;
+    unindexRow(row);
+    unindexName(row);
+    if (row != last) {
+        unindexRow(last);
+        unindexName(last);
+    }
+
+    auto take = [row, last](auto &column) {
+        column[row] = column[last];
+        column.removeLast();
+    };
+    take(m_names);
+    take(m_formats);
+    take(m_compressions);
+    take(m_widths);
+    take(m_heights);
+    take(m_pixels);
+    take(m_dpi);
+    take(m_bytes);
+    take(m_depths);
+    take(m_colors);
+    take(m_pages);
+
+    if (row != last) {
+        indexName(row);
+        indexRow(row);
+    }
+}
+
+void SearchIndex::clear()
+{
+    QWriteLocker locker(&m_lock);
+
+    m_generation++;
+    m_names.clear();
+    m_formats.clear();
+    m_compressions.clear();
+    m_widths.clear();
+    m_heights.clear();
+    m_pixels.clear();
+    m_dpi.clear();
+    m_bytes.clear();
+    m_depths.clear();
+    m_colors.clear();
+    m_pages.clear();
+    m_trigrams.clear();
+    for (RowBitmap &bitmap : m_formatRows) bitmap.clear();
+    for (RowBitmap &bitmap : m_compressionRows) bitmap.clear();
+    m_depthRows.clear();
+}
+
+int SearchIndex::rowCount() const
+{
+    QReadLocker locker(&m_lock);
+    return m_names.size();
+}
+
+quint64 SearchIndex::generation() const
+{
+    QReadLocker locker(&m_lock);
+    return m_generation;
+}
+
+bool SearchIndex::wordMatches(int row, const QString &word) const
+{
+    if (m_names[row].contains(word)) return true;
+    if (ImageMetadata::formatName(m_formats[row]).contains(word, Qt::CaseInsensitive)) return true;
+
+    // У строк с ошибкой сжатие не показывается и не ищется
+    Compression compression = m_compressions[row];
+    return compression != Compression::Unknown &&
+           ImageMetadata::compressionName(compression).contains(word, Qt::CaseInsensitive);
+}
+
+bool SearchIndex::conditionMatches(int row, const FilterQuery::Condition &condition) const
+{
+    quint64 value = 0;
+    switch (condition.field) {
+    case FilterQuery::Width: value = m_widths[row]; break;
+    case FilterQuery::Height: value = m_heights[row]; break;
+    case FilterQuery::Pixels: value = m_pixels[row]; break;
+    case FilterQuery::Dpi: value = m_dpi[row]; break;
+    case FilterQuery::FileSize: value = m_bytes[row]; break;
+    case FilterQuery::Depth: value = m_depths[row]; break;
+    case FilterQuery::Colors: value = m_colors[row]; break;
+    case FilterQuery::Pages: value = m_pages[row]; break;
+    }
+    return FilterQuery::compare(value, condition.op, condition.value);
+}
+
+bool SearchIndex::matches(int row, const FilterQuery &query) const
+{
+    QReadLocker locker(&m_lock);
+    if (row >= m_names.size()) return false;
+
+    for (quint32 mask : query.formatMasks()) {
+        if (!(mask & (1u << int(m_formats[row])))) return false;
+    }
+    for (quint32 mask : query.compressionMasks()) {
+        if (!(mask & (1u << int(m_compressions[row])))) return false;
+    }
+    for (const FilterQuery::Condition &condition : query.conditions()) {
+        if (!conditionMatches(row, condition)) return false;
+    }
+    for (const QString &word : query.words()) {
+        if (!wordMatches(row, word)) return false;
+    }
+    return true;
+}
+
+QVector<int> SearchIndex::trigramCandidates(const QString &needle) const
+{
+    // Пересечение списков строк по всем триграммам запроса, начиная с самого короткого
+    QVector<const QVector<int> *> lists;
+    for (int i = 0; i + 3 <= needle.size(); ++i) {
+        auto it = m_trigrams.constFind(trigram(needle.constData() + i));
+        if (it == m_trigrams.constEnd()) return QVector<int>();
+        lists.append(&it.value());
+    }
+    std::sort(lists.begin(), lists.end(), [](const QVector<int> *a, const QVector<int> *b) {
+        return a->size() < b->size();
+    });
+
+    QVector<int> candidates = *lists.first();
+    QVector<int> next;
+    for (int i = 1; i < lists.size() && !candidates.isEmpty(); ++i) {
+        next.clear();
+        std::set_intersection(candidates.cbegin(), candidates.cend(),
+                              lists[i]->cbegin(), lists[i]->cend(), std::back_inserter(next));
+        candidates.swap(next);
+    }
+    return candidates;
+}
+
+void SearchIndex::applyCondition(const FilterQuery::Condition &condition, QVector<quint64> &words) const
+{
+    switch (condition.field) {
+    case FilterQuery::Width: filterColumn(m_widths, condition.op, condition.value, words); break;
+    case FilterQuery::Height: filterColumn(m_heights, condition.op, condition.value, words); break;
+    case FilterQuery::Pixels: filterColumn(m_pixels, condition.op, condition.value, words); break;
+    case FilterQuery::Dpi: filterColumn(m_dpi, condition.op, condition.value, words); break;
+    case FilterQuery::FileSize: filterColumn(m_bytes, condition.op, condition.value, words); break;
+    case FilterQuery::Colors: filterColumn(m_colors, condition.op, condition.value, words); break;
+    case FilterQuery::Pages: filterColumn(m_pages, condition.op, condition.value, words); break;
+    case FilterQuery::Depth:
+        // Равенство глубины - готовая битовая карта
+        if (condition.op == FilterQuery::Equal && condition.value < 256) {
+            andBitmap(words, m_depthRows.value(int(condition.value)).words());
+        } else {
+            filterColumn(m_depths, condition.op, condition.value, words);
+        }
+        break;
+    }
+}
+
+void SearchIndex::applyWord(const QString &word, QVector<quint64> &words) const
+{
+    // Совпадения по формату и сжатию - объединение битовых карт
+    QVector<quint64> matched(words.size(), 0);
+    for (int i = 0; i < int(ImageFormat::Count); ++i) {
+        if (ImageMetadata::formatName(ImageFormat(i)).contains(word, Qt::CaseInsensitive)) {
+            orBitmap(matched, m_formatRows[i].words());
+        }
+    }
+    for (int i = 1; i < kCompressionCount; ++i) {
+        if (ImageMetadata::compressionName(Compression(i)).contains(word, Qt::CaseInsensitive)) {
+            orBitmap(matched, m_compressionRows[i].words());
+        }
+    }
+
+    // Совпадения по имени среди еще не отсеянных строк. Триграммы дают
+    // надмножество, окончательная проверка - по подстроке.
+    if (word.size() >= 3) {
+        for (int row : trigramCandidates(word)) {
+            if (testBit(words, row) && m_names[row].contains(word)) setBit(matched, row);
+        }
+    } else {
+        for (int w = 0; w < words.size(); ++w) {
+            quint64 bits = words[w] & ~matched[w];
+            while (bits) {
+                int row = w * 64 + qCountTrailingZeroBits(bits);
+                if (m_names[row].contains(word)) setBit(matched, row);
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    andBitmap(words, matched);
+}
+
+SearchIndex::Result SearchIndex::search(const FilterQuery &query) const
+{
+    return search(query, Result());
+}
+
+SearchIndex::Result SearchIndex::search(const FilterQuery &query, const Result &previous) const
+{
+    QReadLocker locker(&m_lock);
+
+    const int count = m_names.size();
+
+    Result result;
+    result.query = query;
+    result.rowCount = count;
+    result.generation = m_generation;
+
+    // Маска кандидатов: все строки либо результат предыдущего запроса,
+    // если текущий только дописывает его
+    QVector<quint64> words((count + 63) / 64, 0);
+    bool narrowing = query.isPlainText() && previous.query.isPlainText() && !previous.query.isEmpty() &&
+                     previous.generation == m_generation && previous.rowCount <= count &&
+                     query.text().contains(previous.query.text(), Qt::CaseInsensitive);
+    if (narrowing) {
+        for (int row : previous.rows) setBit(words, row);
+        for (int row = previous.rowCount; row < count; ++row) setBit(words, row);
+    } else {
+        for (int w = 0; w < words.size(); ++w) words[w] = ~quint64(0);
+        if (count % 64) words.last() = (quint64(1) << (count % 64)) - 1;
+    }
+
+    // Сначала дешевые условия по битовым картам и столбцам, затем слова
+    for (quint32 mask : query.formatMasks()) {
+        QVector<quint64> allowed(words.size(), 0);
+        for (int i = 0; i < int(ImageFormat::Count); ++i) {
+            if (mask & (1u << i)) orBitmap(allowed, m_formatRows[i].words());
+        }
+        andBitmap(words, allowed);
+    }
+    for (quint32 mask : query.compressionMasks()) {
+        QVector<quint64> allowed(words.size(), 0);
+        for (int i = 1; i < kCompressionCount; ++i) {
+            if (mask & (1u << i)) orBitmap(allowed, m_compressionRows[i].words());
+        }
+        andBitmap(words, allowed);
+    }
+    for (const FilterQuery::Condition &condition : query.conditions()) {
+        applyCondition(condition, words);
+    }
+    for (const QString &word : query.words()) {
+        applyWord(word, words);
+    }
+
+    for (int w = 0; w < words.size(); ++w) {
+        quint64 bits = words[w];
+        while (bits) {
+            result.rows.append(w * 64 + qCountTrailingZeroBits(bits));
+            bits &= bits - 1;
+        }
+    }
+    return result;
+}
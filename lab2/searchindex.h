@@ -0,0 +1,94 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QHash>
+#include <QReadWriteLock>
+#include <QString>
+#include <QVector>
+#include "imagemetadata.h"
+#include "filterquery.h"
+
+// Битовая карта строк таблицы
+class RowBitmap
+{
+public:
+    void set(int row);
+    void reset(int row);
+    bool test(int row) const;
+    void clear() { m_words.clear(); }
+
+    const QVector<quint64> &words() const { return m_words; }
+
+private:
+    QVector<quint64> m_words;
+};
+
+// Поисковый индекс результатов: числовые поля хранятся по столбцам,
+// плюс триграммы имен файлов и битовые карты по формату, сжатию и
+// глубине цвета. Пополняется по мере поступления результатов и меняется
+// по строке при изменениях в папке, запросы можно выполнять из других потоков.
+// Номера строк совпадают со строками модели.
+class SearchIndex
+{
+public:
+    static const int kCompressionCount = int(Compression::Other) + 1;
+
+    // Отсортированные номера подходящих строк среди первых rowCount
+    struct Result {
+        FilterQuery query;
+        int rowCount = 0;
+        quint64 generation = 0;
+        QVector<int> rows;
+    };
+
+    void append(const QVector<ImageMetadata> &batch);
+    // Новые данные того же файла
+    void update(int row, const ImageMetadata &metadata);
+    // На место удаленной строки переносится последняя, как в модели
+    void remove(int row);
+    void clear();
+    int rowCount() const;
+    quint64 generation() const;
+
+    // Проверка одной строки, например добавленной после поиска
+    bool matches(int row, const FilterQuery &query) const;
+
+    // Если запрос из одних слов продолжает предыдущий, проверяются только его строки
+    Result search(const FilterQuery &query) const;
+    Result search(const FilterQuery &query, const Result &previous) const;
+
+private:
+    static quint64 trigram(const QChar *chars);
+    void setColumns(int row, const ImageMetadata &metadata);
+    void indexRow(int row);
+    void unindexRow(int row);
+    void indexName(int row);
+    void unindexName(int row);
+    QVector<int> trigramCandidates(const QString &needle) const;
+    bool wordMatches(int row, const QString &word) const;
+    bool conditionMatches(int row, const FilterQuery::Condition &condition) const;
+    void applyCondition(const FilterQuery::Condition &condition, QVector<quint64> &words) const;
+    void applyWord(const QString &word, QVector<quint64> &words) const;
+
+    mutable QReadWriteLock m_lock;
+    quint64 m_generation = 1;
+
+    QVector<QString> m_names;           // имена в нижнем регистре
+    QVector<ImageFormat> m_formats;
+    QVector<Compression> m_compressions;
+    QVector<quint32> m_widths;
+    QVector<quint32> m_heights;
+    QVector<quint64> m_pixels;
+    QVector<quint32> m_dpi;
+    QVector<quint64> m_bytes;
+    QVector<quint8> m_depths;
+    QVector<quint32> m_colors;
+    QVector<quint32> m_pages;
+    QHash<quint64, QVector<int>> m_trigrams;
+
+    RowBitmap m_formatRows[int(ImageFormat::Count)];
+    RowBitmap m_compressionRows[kCompressionCount];
+    QHash<int, RowBitmap> m_depthRows;
+};
+
+#endif // SEARCHINDEX_H
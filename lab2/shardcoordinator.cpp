@@ -0,0 +1,605 @@
+#include "shardcoordinator.h"
+#include "metadatacache.h"
+#include "metadatarecord.h"
+#include "pathpool.h"
+#include "scancontroller.h"
+#include "boundedqueue.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QEvent>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QQueue>
+#include <QThread>
+#include <QTimer>
+#include <QtEndian>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#ifdef Q_OS_WIN
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+// Кадр обмена: тип (1 байт), длина данных (32 бита), данные.
+// Координатор -> процесс: TaskFrame. Процесс -> координатор: остальные.
+enum FrameType : char {
+    TaskFrame = 'T',        // номер задания, безопасный режим (1 байт), число путей, пути
+    BeginFrame = 'B',       // номер задания, номер файла: разбор начат (только в безопасном режиме)
+    RecordFrame = 'R',      // номер задания, номер файла, MetadataRecord
+    DoneFrame = 'D'         // номер задания: все записи отправлены
+};
+
+struct FrameLayout {
+    enum { Type = 0, Length = 1, Size = 5 };
+};
+
+// Больше - значит поток данных поврежден
+const quint32 kMaxFrameLength = 64 * 1024 * 1024;
+
+// Подряд неудачных запусков процесса без единой записи, после которых он не перезапускается
+const int kMaxShardFailures = 3;
+
+// Период проверки отмены, паузы и обновления прогресса
+const int kTickIntervalMs = 50;
+
+int beginFrame(QByteArray &out, char type)
+{
+    int offset = out.size();
+    out.resize(offset + FrameLayout::Size);
+    out[offset + FrameLayout::Type] = type;
+    return offset;
+}
+
+void endFrame(QByteArray &out, int offset)
+{
+    quint32 length = quint32(out.size() - offset - FrameLayout::Size);
+    qToLittleEndian<quint32>(length, reinterpret_cast<uchar *>(out.data()) + offset + FrameLayout::Length);
+}
+
+void appendUInt32(QByteArray &out, quint32 value)
+{
+    uchar bytes[4];
+    qToLittleEndian<quint32>(value, bytes);
+    out.append(reinterpret_cast<const char *>(bytes), 4);
+}
+
+// Читает ровно size байт; false - конец потока
+bool readExact(QFile &in, char *data, qint64 size)
+{
+    while (size > 0) {
+        qint64 bytesRead = in.read(data, size);
+        if (bytesRead <= 0) return false;
+        data += bytesRead;
+        size -= bytesRead;
+    }
+    return true;
+}
+
+struct Task {
+    quint32 id = 0;
+    bool safe = false;              // по одному файлу, с кадром перед каждым
+    QStringList paths;
+    QVector<bool> done;
+    int begun = -1;                 // последний начатый файл в безопасном режиме
+};
+
+struct Shard {
+    QProcess *process = nullptr;
+    QByteArray buffer;
+    std::unique_ptr<Task> task;     // выданное задание, nullptr - процесс свободен
+    int failures = 0;
+    bool closing = false;           // заданий больше нет, stdin закрыт
+    bool stopped = false;           // процесс завершился и больше не запускается
+};
+
+} // namespace
+
+ShardCoordinator::ShardCoordinator(QObject *parent) : QObject(parent)
+{
+}
+
+QString ShardCoordinator::defaultWorkerProgram()
+{
+#ifdef Q_OS_WIN
+    const QString name = "imageanalyzer-cli.exe";
+#else
+    const QString name = "imageanalyzer-cli";
+#endif
+    QString program = QDir(QCoreApplication::applicationDirPath()).filePath(name);
+    return QFileInfo(program).isExecutable() ? program : QString();
+}
+
+ScanStatistics ShardCoordinator::statistics() const
+{
+    QMutexLocker locker(&m_mutex);
+    ScanStatistics total;
+    for (const ScanStatistics &statistics : m_shardStatistics) {
+        total.merge(statistics);
+    }
+    return total;
+}
+
+int ShardCoordinator::shardCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_shardStatistics.size();
+}
+
+int ShardCoordinator::restarts() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_restarts;
+}
+
+int ShardCoordinator::crashedFiles() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_crashedFiles;
+}
+
+QString ShardCoordinator::errorString() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_error;
+}
+
+bool ShardCoordinator::analyzeFolder(const QString &folderPath, ScanController *controller,
+                                     const ScanOptions &options, int shardCount)
+{
+    Q_ASSERT(m_results);
+    Q_ASSERT(controller);
+    shardCount = qMax(1, shardCount);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_shardStatistics = QVector<ScanStatistics>(shardCount);
+        m_restarts = 0;
+        m_crashedFiles = 0;
+        m_error.clear();
+    }
+
+    // Потоки делятся между процессами, если их число не задано
+    const int jobs = options.threadCount > 0 ? options.threadCount
+                                             : qMax(1, QThread::idealThreadCount() / shardCount);
+    QStringList arguments{"--worker", "--jobs", QString::number(jobs)};
+    if (options.deepAnalysis) arguments << "--deep";
+    if (options.perceptualHash) arguments << "--phash";
+
+    QDirIterator::IteratorFlags flags = options.recursive ? QDirIterator::Subdirectories
+                                                          : QDirIterator::NoIteratorFlags;
+    QDirIterator it(folderPath, ImageAnalyzer::nameFilters(), QDir::Files | QDir::NoDotAndDotDot, flags);
+    bool listingDone = false;
+    int found = 0;
+    int processed = 0;
+    quint32 nextTaskId = 0;
+    QQueue<Task *> retries;     // необработанные остатки заданий упавших процессов
+
+    std::vector<Shard> shards(shardCount);    // Shard владеет заданием и не копируется
+    QEventLoop loop;
+
+    auto notifyConsumer = [&]() {
+        if (m_results->markSignaled()) emit resultsAvailable();
+    };
+
+    auto deliver = [&](int shardIndex, ImageMetadata &&metadata) {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_shardStatistics[shardIndex].add(metadata);
+        }
+        processed++;
+        if (!m_results->tryPush(std::move(metadata))) {
+            notifyConsumer();
+            Backoff backoff;
+            while (!m_results->tryPush(std::move(metadata)) && !controller->isCancelled()) {
+                backoff.wait();
+            }
+        }
+    };
+
+    auto reportProgress = [&]() {
+        int progress = found > 0 ? (processed * 100) / found : 0;
+        int running = 0;
+        for (const Shard &shard : shards) {
+            if (!shard.stopped) running++;
+        }
+        QString status = QString("Обработка: %1/%2 файлов, процессов: %3")
+                             .arg(processed).arg(found).arg(running);
+        if (!listingDone) status += " (поиск продолжается)";
+        emit progressUpdated(progress, status);
+    };
+
+    // Следующее задание: сначала остатки упавших, затем новые пути из обхода
+    auto takeTask = [&]() -> Task * {
+        if (!retries.isEmpty()) return retries.dequeue();
+        if (listingDone || controller->isPaused()) return nullptr;
+
+        Task *task = new Task;
+        task->id = nextTaskId++;
+        while (task->paths.size() < kTaskFiles && it.hasNext()) {
+            task->paths.append(it.next());
+        }
+        if (!it.hasNext()) listingDone = true;
+        if (task->paths.isEmpty()) {
+            delete task;
+            return nullptr;
+        }
+        found += task->paths.size();
+        task->done.fill(false, task->paths.size());
+        return task;
+    };
+
+    std::function<void(int)> startShard;
+
+    auto allStopped = [&]() {
+        for (const Shard &shard : shards) {
+            if (!shard.stopped) return false;
+        }
+        return true;
+    };
+
+    auto dispatch = [&](int shardIndex) {
+        Shard &shard = shards[shardIndex];
+        if (shard.stopped || shard.closing || shard.task || controller->isCancelled()) return;
+        // Завершившийся процесс ждет обработки finished: задание ему не выдается
+        if (!shard.process || shard.process->state() != QProcess::Running) return;
+
+        Task *task = takeTask();
+        if (!task) {
+            // Работы не осталось и не появится: процесс завершится по концу stdin
+            if (listingDone && retries.isEmpty()) {
+                shard.closing = true;
+                shard.process->closeWriteChannel();
+            }
+            return;
+        }
+        shard.task.reset(task);
+
+        QByteArray frame;
+        int offset = beginFrame(frame, TaskFrame);
+        appendUInt32(frame, task->id);
+        frame.append(char(task->safe ? 1 : 0));
+        appendUInt32(frame, quint32(task->paths.size()));
+        for (const QString &path : task->paths) {
+            const QByteArray utf8 = path.toUtf8();
+            appendUInt32(frame, quint32(utf8.size()));
+            frame.append(utf8);
+        }
+        endFrame(frame, offset);
+        shard.process->write(frame);
+    };
+
+    auto dispatchAll = [&]() {
+        for (int i = 0; i < shardCount; ++i) dispatch(i);
+    };
+
+    auto readFrames = [&](int shardIndex) {
+        Shard &shard = shards[shardIndex];
+        shard.buffer.append(shard.process->readAllStandardOutput());
+
+        const uchar *data = reinterpret_cast<const uchar *>(shard.buffer.constData());
+        qint64 size = shard.buffer.size();
+        qint64 pos = 0;
+        bool taskDone = false;
+        while (pos + FrameLayout::Size <= size) {
+            const char type = char(data[pos + FrameLayout::Type]);
+            const quint32 length = qFromLittleEndian<quint32>(data + pos + FrameLayout::Length);
+            if (length > kMaxFrameLength) {
+                // Поток поврежден: процесс перезапускается как упавший
+                shard.process->kill();
+                return;
+            }
+            if (pos + FrameLayout::Size + length > size) break;
+
+            const uchar *payload = data + pos + FrameLayout::Size;
+            pos += FrameLayout::Size + length;
+            if (length < 4 || !shard.task || qFromLittleEndian<quint32>(payload) != shard.task->id) continue;
+
+            Task &task = *shard.task;
+            if (type == BeginFrame && length >= 8) {
+                task.begun = int(qFromLittleEndian<quint32>(payload + 4));
+            } else if (type == RecordFrame && length >= 8) {
+                const int index = int(qFromLittleEndian<quint32>(payload + 4));
+                qint64 recordPos = 8;
+                QString path;
+                ImageMetadata metadata;
+                if (index < 0 || index >= task.paths.size() || task.done.at(index) ||
+                    !MetadataRecord::read(payload, length, recordPos, path, metadata)) {
+                    continue;
+                }
+                task.done[index] = true;
+                shard.failures = 0;
+                metadata.pathId = PathPool::instance().intern(task.paths.at(index));
+                deliver(shardIndex, std::move(metadata));
+            } else if (type == DoneFrame) {
+                taskDone = true;
+            }
+        }
+        shard.buffer.remove(0, int(pos));
+        notifyConsumer();
+
+        if (taskDone) {
+            shard.task.reset();
+            dispatch(shardIndex);
+        }
+    };
+
+    // Запись для файла, который процессы не разобрали
+    auto deliverFailed = [&](int shardIndex, const QString &path, ImageError error) {
+        QFileInfo fileInfo(path);
+        ImageMetadata metadata;
+        metadata.pathId = PathPool::instance().intern(path);
+        metadata.bytes = fileInfo.size();
+        metadata.format = ImageMetadata::formatFromSuffix(fileInfo.suffix());
+        metadata.error = error;
+        deliver(shardIndex, std::move(metadata));
+    };
+
+    // Процесс завершился, не дойдя до конца заданий: остаток задания
+    // разбирается по одному файлу, файл, на котором упал разбор по одному, пропускается
+    auto recoverTask = [&](int shardIndex) {
+        Shard &shard = shards[shardIndex];
+        if (!shard.task) return;
+
+        std::unique_ptr<Task> task(shard.task.release());
+        if (task->safe && task->begun >= 0 && !task->done.at(task->begun)) {
+            task->done[task->begun] = true;
+            shard.failures = 0;
+            {
+                QMutexLocker locker(&m_mutex);
+                m_crashedFiles++;
+            }
+            deliverFailed(shardIndex, task->paths.at(task->begun), ImageError::Crashed);
+            notifyConsumer();
+        }
+
+        Task *rest = new Task;
+        rest->id = nextTaskId++;
+        rest->safe = true;
+        for (int i = 0; i < task->paths.size(); ++i) {
+            if (!task->done.at(i)) rest->paths.append(task->paths.at(i));
+        }
+        if (rest->paths.isEmpty()) {
+            delete rest;
+            return;
+        }
+        rest->done.fill(false, rest->paths.size());
+        retries.enqueue(rest);
+    };
+
+    auto shardFinished = [&](int shardIndex) {
+        Shard &shard = shards[shardIndex];
+        // Остаток вывода мог прийти вместе с завершением
+        readFrames(shardIndex);
+        shard.process->deleteLater();
+        shard.process = nullptr;
+
+        const bool expected = shard.closing && !shard.task;
+        if (controller->isCancelled() || (expected && retries.isEmpty())) {
+            shard.stopped = true;
+        } else if (expected) {
+            // Остатки упавших процессов появились после закрытия stdin:
+            // процесс запускается снова и забирает их
+            startShard(shardIndex);
+        } else {
+            recoverTask(shardIndex);
+            {
+                QMutexLocker locker(&m_mutex);
+                m_restarts++;
+            }
+            if (++shard.failures > kMaxShardFailures) {
+                shard.stopped = true;
+                QMutexLocker locker(&m_mutex);
+                m_error = "Процесс анализа завершается без результата";
+            } else {
+                startShard(shardIndex);
+            }
+        }
+
+        if (allStopped()) {
+            loop.quit();
+        } else if (!retries.isEmpty()) {
+            // Остаток задания может взять любой свободный процесс
+            dispatchAll();
+        }
+    };
+
+    startShard = [&](int shardIndex) {
+        Shard &shard = shards[shardIndex];
+        shard.buffer.clear();
+        shard.closing = false;
+
+        QProcess *process = new QProcess;
+        process->setProgram(m_program);
+        process->setArguments(arguments);
+        process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        shard.process = process;
+
+        QObject::connect(process, &QProcess::readyReadStandardOutput, process,
+                         [&readFrames, shardIndex]() { readFrames(shardIndex); });
+        QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), process,
+                         [&shardFinished, shardIndex]() { shardFinished(shardIndex); });
+
+        process->start();
+        if (!process->waitForStarted()) {
+            QMutexLocker locker(&m_mutex);
+            m_error = QString("Не удалось запустить процесс анализа %1: %2").arg(m_program, process->errorString());
+            locker.unlock();
+
+            recoverTask(shardIndex);
+            shard.stopped = true;
+            delete process;
+            shard.process = nullptr;
+            return;
+        }
+        dispatch(shardIndex);
+    };
+
+    for (int i = 0; i < shardCount; ++i) {
+        startShard(i);
+    }
+
+    // Отмена, пауза и прогресс проверяются по таймеру в цикле событий этого потока
+    QTimer tick;
+    tick.setInterval(kTickIntervalMs);
+    QObject::connect(&tick, &QTimer::timeout, [&]() {
+        if (controller->isCancelled()) {
+            for (Shard &shard : shards) {
+                if (shard.process) shard.process->kill();
+            }
+        } else {
+            // После паузы и перезапусков свободным процессам выдаются задания
+            dispatchAll();
+        }
+        reportProgress();
+    });
+
+    bool started = !allStopped();
+    if (started) {
+        tick.start();
+        loop.exec();
+        tick.stop();
+    }
+
+    // Процессов не осталось, а файлы остались: каждый выдается с ошибкой,
+    // чтобы ни один не пропал из результатов молча
+    if (started && !controller->isCancelled()) {
+        int skipped = 0;
+        for (Task *task : retries) {
+            for (int i = 0; i < task->paths.size() && !controller->isCancelled(); ++i) {
+                if (task->done.at(i)) continue;
+                deliverFailed(0, task->paths.at(i), ImageError::NotAnalyzed);
+                skipped++;
+            }
+        }
+        while (!listingDone && it.hasNext() && !controller->isCancelled()) {
+            deliverFailed(0, it.next(), ImageError::NotAnalyzed);
+            found++;
+            skipped++;
+        }
+        if (skipped > 0) {
+            QMutexLocker locker(&m_mutex);
+            const QString message = QString("Не разобрано файлов: %1").arg(skipped);
+            m_error = m_error.isEmpty() ? message : m_error + ". " + message;
+        }
+    }
+
+    for (Task *task : retries) {
+        delete task;
+    }
+    // Обработчики процессов ссылаются на локальные переменные: процессы
+    // удаляются до выхода из функции
+    for (Shard &shard : shards) {
+        delete shard.process;
+        shard.process = nullptr;
+    }
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+
+    m_results->close();
+    notifyConsumer();
+    reportProgress();
+
+    emit finished();
+    return started;
+}
+
+int ShardWorker::run(const ScanOptions &options, bool useCache)
+{
+#ifdef Q_OS_WIN
+    // Кадры двоичные: без преобразования переводов строк
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    QFile in;
+    QFile out;
+    if (!in.open(stdin, QIODevice::ReadOnly) || !out.open(stdout, QIODevice::WriteOnly)) return 1;
+
+    // Записи уходят координатору сразу, пути после этого не нужны
+    PathPool::instance().setStreaming(true);
+    MetadataCache cache;
+    ImageAnalyzer analyzer;
+    analyzer.setAnalysisMode(options);
+    if (useCache) {
+        cache.load();
+        analyzer.setCache(&cache);
+    }
+
+    QByteArray output;
+    auto appendRecord = [&output](quint32 taskId, int index, const QString &path, const ImageMetadata &metadata) {
+        int offset = beginFrame(output, RecordFrame);
+        appendUInt32(output, taskId);
+        appendUInt32(output, quint32(index));
+        MetadataRecord::append(output, path, metadata);
+        endFrame(output, offset);
+        PathPool::instance().release(metadata.pathId);
+    };
+    auto flush = [&output, &out]() {
+        out.write(output);
+        out.flush();
+        output.clear();
+    };
+
+    char header[FrameLayout::Size];
+    QByteArray payload;
+    while (readExact(in, header, FrameLayout::Size)) {
+        const quint32 length = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(header) + FrameLayout::Length);
+        if (header[FrameLayout::Type] != TaskFrame || length < 9 || length > kMaxFrameLength) return 1;
+
+        payload.resize(int(length));
+        if (!readExact(in, payload.data(), length)) return 1;
+
+        const uchar *data = reinterpret_cast<const uchar *>(payload.constData());
+        const quint32 taskId = qFromLittleEndian<quint32>(data);
+        const bool safe = data[4] != 0;
+        const quint32 count = qFromLittleEndian<quint32>(data + 5);
+
+        QStringList paths;
+        qint64 pos = 9;
+        for (quint32 i = 0; i < count; ++i) {
+            if (pos + 4 > length) return 1;
+            const quint32 pathLength = qFromLittleEndian<quint32>(data + pos);
+            pos += 4;
+            if (pos + pathLength > length) return 1;
+            paths.append(QString::fromUtf8(reinterpret_cast<const char *>(data + pos), int(pathLength)));
+            pos += pathLength;
+        }
+
+        if (safe) {
+            // Каждый файл объявляется до разбора: если процесс упадет,
+            // координатор узнает, на каком файле
+            for (int i = 0; i < paths.size(); ++i) {
+                int offset = beginFrame(output, BeginFrame);
+                appendUInt32(output, taskId);
+                appendUInt32(output, quint32(i));
+                endFrame(output, offset);
+                flush();
+
+                const QVector<ImageMetadata> results = analyzer.analyzeFiles(QStringList{paths.at(i)}, 1);
+                appendRecord(taskId, i, paths.at(i), results.first());
+                flush();
+            }
+        } else {
+            // Запись уходит, как только файл разобран: при падении процесса
+            // координатор получает все готовые записи и повторяет только остальные
+            QMutex outputMutex;
+            analyzer.analyzeFiles(paths, options.threadCount, [&](int index, ImageMetadata &&metadata) {
+                QMutexLocker locker(&outputMutex);
+                appendRecord(taskId, index, paths.at(index), metadata);
+                flush();
+            });
+        }
+
+        int offset = beginFrame(output, DoneFrame);
+        appendUInt32(output, taskId);
+        endFrame(output, offset);
+        flush();
+    }
+    return 0;
+}
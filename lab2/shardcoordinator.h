@@ -0,0 +1,77 @@
+#ifndef SHARDCOORDINATOR_H
+#define SHARDCOORDINATOR_H
+
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include "imageanalyzer.h"
+#include "scanstatistics.h"
+
+// Анализ папки несколькими процессами. Координатор обходит папку и раздает
+// пути заданиями по kTaskFiles файлов (подряд из обхода, то есть почти всегда
+// из одной папки) процессам консольной версии, запущенным с --worker.
+// Записи возвращаются по каналу stdout в формате MetadataRecord.
+// Статистику координатор считает по записям каждого процесса отдельно
+// и складывает; процессы анализа ее не ведут.
+// Если процесс аварийно завершился (например, упал декодер на поврежденном
+// файле), он перезапускается, а необработанные файлы задания разбираются
+// по одному: файл, на котором процесс падает снова, получает ошибку
+// ImageError::Crashed и пропускается. Если перестали запускаться все
+// процессы, оставшиеся файлы выдаются с ошибкой ImageError::NotAnalyzed,
+// а причина - в errorString().
+class ShardCoordinator : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int kTaskFiles = 256;
+
+    explicit ShardCoordinator(QObject *parent = nullptr);
+
+    // Консольная версия рядом с исполняемым файлом; пустая строка - не найдена
+    static QString defaultWorkerProgram();
+    void setWorkerProgram(const QString &program) { m_program = program; }
+
+    // Буфер результатов обязателен, по окончании анализа закрывается
+    void setResultRing(ResultRing *results) { m_results = results; }
+
+    // Блокирует вызывающий поток до окончания анализа, как ImageAnalyzer::analyzeFolder.
+    // Результаты выдаются по мере готовности, без сохранения порядка обхода.
+    // false - процессы анализа не запускаются, причина в errorString()
+    bool analyzeFolder(const QString &folderPath, ScanController *controller,
+                       const ScanOptions &options, int shardCount);
+
+    // Сумма статистики всех процессов; можно вызывать во время анализа
+    ScanStatistics statistics() const;
+    int shardCount() const;
+    int restarts() const;
+    int crashedFiles() const;
+    QString errorString() const;
+
+signals:
+    void progressUpdated(int value, const QString &status);
+    // В буфере появились результаты; повторно - только после clearSignaled()
+    void resultsAvailable();
+    void finished();
+
+private:
+    QString m_program;
+    ResultRing *m_results = nullptr;
+
+    mutable QMutex m_mutex;
+    QVector<ScanStatistics> m_shardStatistics;
+    int m_restarts = 0;
+    int m_crashedFiles = 0;
+    QString m_error;
+};
+
+// Сторона процесса анализа: задания читаются из stdin, записи пишутся в stdout.
+// Кэш метаданных только читается: процессы не перезаписывают файл друг друга.
+class ShardWorker
+{
+public:
+    static int run(const ScanOptions &options, bool useCache);
+};
+
+#endif // SHARDCOORDINATOR_H
@@ -0,0 +1,102 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <QVector>
+#include <QtGlobal>
+#include <atomic>
+#include <memory>
+
+// Кольцевой буфер одного производителя и одного потребителя без блокировок.
+// Кроме данных хранит признак закрытия (производитель закончил) и флаг
+// уведомления, чтобы потребителю уходил один сигнал на серию записей.
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(int capacity)
+    {
+        size_t size = 2;
+        while (size < size_t(qMax(capacity, 2))) size <<= 1;
+
+        m_mask = size - 1;
+        m_items.reset(new T[size]);
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    // Только со стороны производителя
+    bool tryPush(T &&value)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) > m_mask) return false;
+
+        m_items[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    void close() { m_closed.store(true, std::memory_order_release); }
+
+    // true, если потребитель еще не уведомлен и сигнал нужно отправить
+    bool markSignaled() { return !m_signaled.exchange(true, std::memory_order_acq_rel); }
+
+    // Только со стороны потребителя
+    bool tryPop(T &value)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) return false;
+
+        value = std::move(m_items[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    int popBatch(QVector<T> &batch, int maxCount)
+    {
+        int count = 0;
+        T value;
+        while (count < maxCount && tryPop(value)) {
+            batch.append(std::move(value));
+            count++;
+        }
+        return count;
+    }
+
+    // Сбрасывается перед чтением: записи, пришедшие после, вызовут новый сигнал
+    void clearSignaled() { m_signaled.store(false, std::memory_order_release); }
+
+    // Производитель закончил и все прочитано
+    bool isFinished() const
+    {
+        return m_closed.load(std::memory_order_acquire) && size() == 0;
+    }
+
+    // Между сканированиями, когда производителя нет
+    void reset()
+    {
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+        m_closed.store(false, std::memory_order_relaxed);
+        m_signaled.store(false, std::memory_order_relaxed);
+    }
+
+    int size() const
+    {
+        // Начало читается первым: конец за это время может только вырасти
+        size_t head = m_head.load(std::memory_order_acquire);
+        return int(m_tail.load(std::memory_order_acquire) - head);
+    }
+
+    int capacity() const { return int(m_mask + 1); }
+
+private:
+    std::unique_ptr<T[]> m_items;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+    std::atomic<bool> m_closed{false};
+    std::atomic<bool> m_signaled{false};
+};
+
+#endif // SPSCRING_H
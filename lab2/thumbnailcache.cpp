@@ -0,0 +1,263 @@
+#include "thumbnailcache.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageIOHandler>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QPair>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QRunnable>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+#include <functional>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// Запросов в очереди: примерно две высоты окна таблицы
+const int kMaxQueue = 96;
+
+// Значков в памяти, КБ (значок 48x48 - около 9 КБ)
+const int kIconCacheKb = 64 * 1024;
+
+// Миниатюры на диске, сверх лимита удаляются давно не открывавшиеся
+const qint64 kMaxDiskBytes = 256 * 1024 * 1024;
+
+// Время использования на диске обновляется не чаще раза в сутки: для очистки
+// при запуске точнее не нужно, а запись на каждое попадание стоила бы дорого
+const qint64 kTouchIntervalMs = 24 * 60 * 60 * 1000;
+
+// Без уменьшенного декодирования (не JPEG) большие изображения
+// декодируются целиком; крупнее этого миниатюра не строится
+const qint64 kMaxFullDecodePixels = 64 * 1024 * 1024;
+
+class Task : public QRunnable
+{
+public:
+    explicit Task(const std::function<void()> &function) : m_function(function) {}
+    void run() override { m_function(); }
+
+private:
+    std::function<void()> m_function;
+};
+
+// Ключ миниатюры: размер, время изменения, устройство и inode. Файл не читается,
+// а правка любого байта меняет время изменения, в отличие от выборки содержимого
+QByteArray fileKey(const QString &filePath)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(filePath).constData(), &st) != 0 || !S_ISREG(st.st_mode)) return QByteArray();
+#ifdef Q_OS_DARWIN
+    const qint64 modifiedNs = qint64(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    const qint64 modifiedNs = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    const qint64 fields[4] = {qint64(st.st_size), modifiedNs, qint64(st.st_dev), qint64(st.st_ino)};
+    hash.addData(reinterpret_cast<const char *>(fields), sizeof(fields));
+#else
+    // Без inode файл различается по пути
+    const QFileInfo info(filePath);
+    if (!info.isFile()) return QByteArray();
+    hash.addData(QByteArray::number(info.size()) + ' ' +
+                 QByteArray::number(info.lastModified().toMSecsSinceEpoch()) + ' ' + filePath.toUtf8());
+#endif
+    return hash.result().toHex();
+}
+
+} // namespace
+
+ThumbnailCache::ThumbnailCache(const QString &directory, QObject *parent)
+    : QObject(parent)
+    , m_directory(directory)
+{
+    // Миниатюры не должны отнимать диск и процессор у анализа
+    m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 4, 2));
+    m_icons.setMaxCost(kIconCacheKb);
+
+    QDir().mkpath(m_directory);
+    m_pool.start(new Task([this]() { pruneDisk(); }));
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_queue.clear();
+    }
+    m_pool.waitForDone();
+}
+
+QString ThumbnailCache::defaultDirectory()
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return QDir(dir).filePath("thumbnails");
+}
+
+QPixmap ThumbnailCache::icon(const QString &filePath)
+{
+    if (QPixmap *cached = m_icons.object(filePath)) return *cached;
+    if (!m_failed.contains(filePath)) enqueue(filePath, false);
+    return QPixmap();
+}
+
+void ThumbnailCache::requestPreview(const QString &filePath)
+{
+    if (m_failed.contains(filePath)) {
+        m_previewPath.clear();
+        emit previewReady(filePath, QPixmap());
+        return;
+    }
+    m_previewPath = filePath;
+    enqueue(filePath, true);
+}
+
+void ThumbnailCache::enqueue(const QString &filePath, bool urgent)
+{
+    if (m_pending.contains(filePath) && !urgent) return;
+    m_pending.insert(filePath);
+
+    QString dropped;
+    bool startWorker = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_queue.removeOne(filePath);
+        m_queue.prepend(filePath);
+        if (m_queue.size() > kMaxQueue) dropped = m_queue.takeLast();
+        if (m_workers < m_pool.maxThreadCount()) {
+            m_workers++;
+            startWorker = true;
+        }
+    }
+
+    // Вытесненный запрос повторится, когда строка снова станет видна
+    if (!dropped.isEmpty()) m_pending.remove(dropped);
+    if (startWorker) m_pool.start(new Task([this]() { work(); }));
+}
+
+void ThumbnailCache::work()
+{
+    for (;;) {
+        QString filePath;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_stopping || m_queue.isEmpty()) {
+                m_workers--;
+                return;
+            }
+            filePath = m_queue.takeFirst();
+        }
+
+        const QImage preview = load(filePath);
+        const QImage icon = preview.isNull()
+                                ? QImage()
+                                : preview.scaled(kIconSide, kIconSide, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        QMetaObject::invokeMethod(this, [this, filePath, preview, icon]() {
+            deliver(filePath, preview, icon);
+        }, Qt::QueuedConnection);
+    }
+}
+
+QImage ThumbnailCache::load(const QString &filePath) const
+{
+    const QByteArray key = fileKey(filePath);
+    if (key.isEmpty()) return QImage();
+
+    // Подкаталоги по первым двум цифрам ключа: в одном каталоге не скапливаются сотни тысяч файлов
+    const QString dir = QDir(m_directory).filePath(QString::fromLatin1(key.left(2)));
+    const QString cachedPath = QDir(dir).filePath(QString::fromLatin1(key));
+
+    QImage thumbnail(cachedPath);
+    if (!thumbnail.isNull()) {
+        // Время изменения - время последнего использования, по нему чистится диск
+        const QDateTime now = QDateTime::currentDateTime();
+        if (QFileInfo(cachedPath).lastModified().msecsTo(now) > kTouchIntervalMs) {
+            QFile cached(cachedPath);
+            if (cached.open(QIODevice::ReadWrite)) cached.setFileTime(now, QFileDevice::FileModificationTime);
+        }
+        return thumbnail;
+    }
+
+    QImageReader reader(filePath);
+    reader.setAutoTransform(true);
+    const QSize size = reader.size();
+    if (size.isValid() && (size.width() > kPreviewSide || size.height() > kPreviewSide)) {
+        if (!reader.supportsOption(QImageIOHandler::ScaledSize) &&
+            qint64(size.width()) * size.height() > kMaxFullDecodePixels) {
+            return QImage();
+        }
+        // JPEG при этом декодируется сразу в 1/2-1/8 размера
+        reader.setScaledSize(size.scaled(kPreviewSide, kPreviewSide, Qt::KeepAspectRatio));
+    }
+
+    thumbnail = reader.read();
+    if (thumbnail.isNull()) return QImage();
+    if (thumbnail.width() > kPreviewSide || thumbnail.height() > kPreviewSide) {
+        thumbnail = thumbnail.scaled(kPreviewSide, kPreviewSide, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+
+    QDir().mkpath(dir);
+    QSaveFile file(cachedPath);
+    if (file.open(QIODevice::WriteOnly)) {
+        QImageWriter writer(&file, thumbnail.hasAlphaChannel() ? "png" : "jpg");
+        writer.setQuality(85);
+        if (writer.write(thumbnail)) file.commit();
+    }
+    return thumbnail;
+}
+
+void ThumbnailCache::deliver(const QString &filePath, const QImage &preview, const QImage &icon)
+{
+    m_pending.remove(filePath);
+
+    if (preview.isNull()) {
+        m_failed.insert(filePath);
+        if (filePath == m_previewPath) {
+            m_previewPath.clear();
+            emit previewReady(filePath, QPixmap());
+        }
+        return;
+    }
+
+    QPixmap *pixmap = new QPixmap(QPixmap::fromImage(icon));
+    m_icons.insert(filePath, pixmap, qMax(1, icon.width() * icon.height() * 4 / 1024));
+    emit iconReady(filePath);
+
+    if (filePath == m_previewPath) {
+        m_previewPath.clear();
+        emit previewReady(filePath, QPixmap::fromImage(preview));
+    }
+}
+
+void ThumbnailCache::pruneDisk()
+{
+    // Сверх лимита удаляются миниатюры, которые дольше всего не открывались
+    QVector<QPair<qint64, QString>> files;
+    qint64 total = 0;
+    QDirIterator it(m_directory, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        files.append(qMakePair(info.lastModified().toMSecsSinceEpoch(), info.filePath()));
+        total += info.size();
+    }
+    if (total <= kMaxDiskBytes) return;
+
+    std::sort(files.begin(), files.end());
+    for (const QPair<qint64, QString> &file : files) {
+        if (total <= kMaxDiskBytes * 3 / 4) break;
+        total -= QFileInfo(file.second).size();
+        QFile::remove(file.second);
+    }
+}
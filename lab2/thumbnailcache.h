@@ -0,0 +1,68 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+
+// Миниатюры изображений: память (LRU) -> диск -> уменьшенное декодирование.
+// На диске миниатюра лежит под ключом из размера, времени изменения (нс),
+// устройства и inode файла, как в кэше метаданных: любая запись в файл
+// дает новый ключ, переименованный файл миниатюру не пересчитывает.
+// Чтение и декодирование - в фоновых потоках; в потоке интерфейса только
+// поиск в памяти.
+class ThumbnailCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int kPreviewSide = 256;    // миниатюра на диске и в панели деталей
+    static const int kIconSide = 48;        // значок в таблице
+
+    explicit ThumbnailCache(const QString &directory = defaultDirectory(), QObject *parent = nullptr);
+    ~ThumbnailCache();
+
+    static QString defaultDirectory();
+
+    // Значок из памяти; если его нет, файл ставится в очередь и позже
+    // приходит iconReady. Очередь короткая и обрабатывается с конца:
+    // запросы строк, пролистанных мимо, вытесняются новыми.
+    QPixmap icon(const QString &filePath);
+
+    // Миниатюра для панели деталей приходит через previewReady
+    // (пустая, если файл не читается)
+    void requestPreview(const QString &filePath);
+
+signals:
+    void iconReady(const QString &filePath);
+    void previewReady(const QString &filePath, const QPixmap &preview);
+
+private:
+    void enqueue(const QString &filePath, bool urgent);
+    void work();
+    QImage load(const QString &filePath) const;
+    void deliver(const QString &filePath, const QImage &preview, const QImage &icon);
+    void pruneDisk();
+
+    QString m_directory;
+    QThreadPool m_pool;
+
+    // Только поток интерфейса
+    QCache<QString, QPixmap> m_icons;
+    QSet<QString> m_pending;        // в очереди или читаются
+    QSet<QString> m_failed;         // не читаются: повторно не запрашиваются
+    QString m_previewPath;
+
+    QMutex m_mutex;
+    QList<QString> m_queue;         // новые запросы в начале
+    int m_workers = 0;
+    bool m_stopping = false;
+};
+
+#endif // THUMBNAILCACHE_H